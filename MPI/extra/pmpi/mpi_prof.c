@@ -0,0 +1,780 @@
+/* ------------------------------------------------------------------------
+ * Code:   mpi_prof.c
+ * Lab:    MPI profiling interface (PMPI)
+ *         Interposition library that shows where the tasks of any of the
+ *         lab programs spend their time inside MPI.  Every wrapped call is
+ *         timed and accounted per (call, communicator, peer): number of
+ *         calls, bytes, total time and a log2 histogram of the latency.
+ *         At MPI_Finalize the tables of all tasks are gathered by task 0
+ *         and written as one report, one section per task.
+ *
+ * Build:  mpicc -O2 -fPIC -shared -o libmpiprof.so mpi_prof.c
+ * Usage:  mpirun -np 2 -x LD_PRELOAD=`pwd`/libmpiprof.so ../../lab02/ex1/a.out
+ *         MPIPROF_FILE sets the report file (default mpi_prof.txt, "-" for
+ *         standard output).
+ *
+ * Notes:  - the peer is the rank in the communicator: destination or
+ *           source of point-to-point calls (the actual source for
+ *           MPI_ANY_SOURCE receives), root of rooted collectives, -1 for
+ *           calls without a peer (barrier, allreduce).
+ *         - waits and tests are charged to the communicator and peer of
+ *           the request, remembered at MPI_Isend/MPI_Irecv.  The calls on
+ *           arrays of requests count one call per request they complete
+ *           (per request of the array when a test completes none) and
+ *           split their time evenly among them.  Requests made elsewhere
+ *           (persistent, collective) are charged to WORLD with peer -1.
+ *         - calls that do not return MPI_SUCCESS are not accounted.
+ *         - the first NCOMM communicators get their own rows, later ones
+ *           share the "other" rows.  A freed communicator keeps its rows;
+ *           a new one that reuses its handle gets new ones.
+ *         - bytes are the ones described by the call arguments: sent for
+ *           sends, posted for receives, send buffer for collectives.
+ *         - the timer is the time stamp counter on x86, converted to
+ *           nanoseconds at MPI_Finalize against MPI_Wtime, so a wrapped
+ *           call costs two rdtsc and a table lookup.  Elsewhere
+ *           clock_gettime(CLOCK_MONOTONIC) is used.
+ *         - the tables are not locked: calls must be made by one thread
+ *           at a time (MPI_THREAD_FUNNELED or SERIALIZED).
+ * ------------------------------------------------------------------------ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "mpi.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#define NBUCKET  48           /* log2 latency buckets, in timer ticks      */
+#define NCOMM    32           /* communicators told apart                  */
+#define COMM_OTHER NCOMM      /* slot shared by the communicators after it */
+#define NSLOT    4096         /* (call, comm, peer) entries, power of 2    */
+#define NREQ     4096         /* pending requests tracked, power of 2      */
+#define NOPEER   (-1)
+
+enum { C_SEND, C_SSEND, C_RSEND, C_BSEND, C_ISEND, C_RECV, C_IRECV,
+       C_SENDRECV, C_PROBE, C_WAIT, C_WAITALL, C_WAITANY, C_WAITSOME,
+       C_TEST, C_TESTALL, C_TESTANY, C_TESTSOME, C_BARRIER, C_BCAST, C_REDUCE, C_ALLREDUCE, C_SCATTER, C_SCATTERV,
+       C_GATHER, C_GATHERV, C_ALLGATHER, C_ALLTOALL, NCALL };
+
+static const char *call_name[NCALL] = {
+  "MPI_Send", "MPI_Ssend", "MPI_Rsend", "MPI_Bsend", "MPI_Isend",
+  "MPI_Recv", "MPI_Irecv", "MPI_Sendrecv", "MPI_Probe", "MPI_Wait",
+  "MPI_Waitall", "MPI_Waitany", "MPI_Waitsome", "MPI_Test", "MPI_Testall",
+  "MPI_Testany", "MPI_Testsome", "MPI_Barrier", "MPI_Bcast",
+  "MPI_Reduce", "MPI_Allreduce", "MPI_Scatter", "MPI_Scatterv",
+  "MPI_Gather", "MPI_Gatherv", "MPI_Allgather", "MPI_Alltoall" };
+
+typedef struct {
+  int       used;
+  int       call, comm, peer;
+  long long count;
+  long long bytes;
+  unsigned long long ticks;
+  long long hist[NBUCKET];
+} prof_entry;
+
+static prof_entry table[NSLOT];
+static int        overflow;             /* entries lost, table full */
+
+static MPI_Comm   comm_handle[NCOMM];
+static int        comm_size[NCOMM];
+static int        comm_live[NCOMM];     /* 0 once MPI_Comm_free'd      */
+static int        ncomm;
+static int        last_comm;            /* slot of the previous lookup */
+
+typedef struct {
+  int         used;
+  MPI_Request req;
+  int         comm, peer;               /* comm slot, peer of the call */
+} req_entry;
+
+static req_entry  reqs[NREQ];
+static int        req_overflow;         /* requests not tracked        */
+
+static MPI_Request *req_copy;           /* scratch for the array waits */
+static MPI_Status  *st_copy;
+static int          ncopy;
+
+static unsigned long long tick0, tick1; /* timer at init and finalize  */
+static double     wtime0, wtime1;
+
+/* -------------------------------------------------------------------
+ * timer
+ * ------------------------------------------------------------------- */
+static inline unsigned long long now ( void )
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  struct timespec ts;
+  clock_gettime( CLOCK_MONOTONIC, &ts );
+  return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+static inline int bucket ( unsigned long long t )
+{
+  int b;
+  if ( t == 0 ) return 0;
+  b = 64 - __builtin_clzll( t );
+  return b < NBUCKET ? b : NBUCKET - 1;
+}
+
+/* -------------------------------------------------------------------
+ * accounting
+ * ------------------------------------------------------------------- */
+static inline int comm_find ( MPI_Comm comm )
+{
+  int i;
+  if ( ncomm > 0 && comm_live[last_comm] && comm_handle[last_comm] == comm )
+    return last_comm;
+  for ( i = 0; i < ncomm; i++ )
+    if ( comm_live[i] && comm_handle[i] == comm )
+      return last_comm = i;
+  return -1;
+}
+
+static inline int comm_slot ( MPI_Comm comm )
+{
+  int i = comm_find( comm );
+  if ( i >= 0 )
+    return i;
+  if ( ncomm == NCOMM )
+    return COMM_OTHER;
+  comm_handle[ncomm] = comm;
+  comm_live[ncomm] = 1;
+  PMPI_Comm_size( comm, &comm_size[ncomm] );
+  return last_comm = ncomm++;
+}
+
+static inline void account_slot ( int call, int c, int peer, long long bytes,
+                                  unsigned long long t )
+{
+  unsigned int h = ((unsigned int)call * 2654435761u)
+                 ^ ((unsigned int)c * 40503u) ^ (unsigned int)(peer + 1);
+  unsigned int i, n;
+  prof_entry *e;
+
+  for ( n = 0, i = h & (NSLOT-1); n < NSLOT; n++, i = (i+1) & (NSLOT-1) ) {
+    e = &table[i];
+    if ( !e->used ) {
+      e->used = 1; e->call = call; e->comm = c; e->peer = peer;
+      break;
+    }
+    if ( e->call == call && e->comm == c && e->peer == peer )
+      break;
+  }
+  if ( n == NSLOT ) { overflow++; return; }
+
+  e->count++;
+  e->bytes += bytes;
+  e->ticks += t;
+  e->hist[bucket( t )]++;
+}
+
+static inline void account ( int call, MPI_Comm comm, int peer, long long bytes,
+                             unsigned long long t )
+{
+  account_slot( call, comm_slot( comm ), peer, bytes, t );
+}
+
+/* -------------------------------------------------------------------
+ * pending requests: open addressing on the handle, linear probing
+ * ------------------------------------------------------------------- */
+static inline unsigned int req_hash ( MPI_Request req )
+{
+  unsigned long long k = 0;
+  memcpy( &k, &req, sizeof(req) < sizeof(k) ? sizeof(req) : sizeof(k) );
+  return (unsigned int)((k * 0x9e3779b97f4a7c15ULL) >> 40) & (NREQ-1);
+}
+
+static int req_find ( MPI_Request req )
+{
+  unsigned int i, n;
+  for ( n = 0, i = req_hash( req ); n < NREQ; n++, i = (i+1) & (NREQ-1) ) {
+    if ( !reqs[i].used ) return -1;
+    if ( reqs[i].req == req ) return (int)i;
+  }
+  return -1;
+}
+
+static void req_add ( MPI_Request req, MPI_Comm comm, int peer )
+{
+  unsigned int i, n;
+  if ( req == MPI_REQUEST_NULL ) return;
+  for ( n = 0, i = req_hash( req ); n < NREQ; n++, i = (i+1) & (NREQ-1) )
+    if ( !reqs[i].used || reqs[i].req == req ) {
+      reqs[i].used = 1; reqs[i].req = req;
+      reqs[i].comm = comm_slot( comm ); reqs[i].peer = peer;
+      return;
+    }
+  req_overflow++;
+}
+
+/* remove entry i, moving back the entries of its probe chain */
+static void req_del ( int i )
+{
+  unsigned int j = (unsigned int)i, k;
+  for ( ;; ) {
+    reqs[i].used = 0;
+    for ( ;; ) {
+      j = (j+1) & (NREQ-1);
+      if ( !reqs[j].used ) return;
+      k = req_hash( reqs[j].req );
+      /* j stays if its home k lies cyclically in (i, j] */
+      if ( i <= (int)j ? (i < (int)k && k <= j) : (i < (int)k || k <= j) )
+        continue;
+      break;
+    }
+    reqs[i] = reqs[j];
+    i = (int)j;
+  }
+}
+
+/* charge a completed request, removing it; unknown ones go to WORLD */
+static void account_req ( int call, int i, const MPI_Status *st,
+                          unsigned long long t )
+{
+  int peer;
+  if ( i < 0 ) {
+    account( call, MPI_COMM_WORLD, NOPEER, 0, t );
+    return;
+  }
+  peer = reqs[i].peer;
+  if ( peer == MPI_ANY_SOURCE && st != NULL )
+    peer = st->MPI_SOURCE;
+  account_slot( call, reqs[i].comm, peer, 0, t );
+}
+
+/*
+ * charge the n requests req_copy[idx[j]] (req_copy[j] without idx) of
+ * an array call, with status st[j] if st is given; they are removed
+ * when done.  The time is split among the tracked ones.
+ */
+static void account_reqs ( int call, int n, const int idx[],
+                           const MPI_Status st[], int done,
+                           unsigned long long t )
+{
+  int j, i, m = 0;
+  for ( j = 0; j < n; j++ )
+    if ( req_find( req_copy[idx ? idx[j] : j] ) >= 0 ) m++;
+  if ( m == 0 ) {
+    account_req( call, -1, NULL, t );
+    return;
+  }
+  for ( j = 0; j < n; j++ )
+    if ( (i = req_find( req_copy[idx ? idx[j] : j] )) >= 0 ) {
+      account_req( call, i, st ? &st[j] : NULL, t / m );
+      if ( done ) req_del( i );
+    }
+}
+
+/*
+ * copy an array of request handles, and get room for their statuses;
+ * -1 if out of memory, the call is then not accounted
+ */
+static int copy_reqs ( int count, const MPI_Request requests[] )
+{
+  void *p;
+  if ( count > ncopy ) {
+    if ( (p = realloc( req_copy, count * sizeof(MPI_Request) )) == NULL )
+      return -1;
+    req_copy = p;
+    if ( (p = realloc( st_copy, count * sizeof(MPI_Status) )) == NULL )
+      return -1;
+    st_copy = p;
+    ncopy = count;
+  }
+  if ( count > 0 )
+    memcpy( req_copy, requests, count * sizeof(MPI_Request) );
+  return 0;
+}
+
+static inline long long nbytes ( int count, MPI_Datatype type )
+{
+  int size;
+  if ( count <= 0 ) return 0;
+  PMPI_Type_size( type, &size );
+  return (long long)count * size;
+}
+
+/* time a PMPI call and account it */
+#define PROF(call, comm, peer, bytes, pmpi_call)                         \
+  do {                                                                   \
+    unsigned long long t_ = now();                                       \
+    rc = pmpi_call;                                                      \
+    t_ = now() - t_;                                                     \
+    account( call, comm, peer, bytes, t_ );                              \
+  } while (0)
+
+/* -------------------------------------------------------------------
+ * report
+ * ------------------------------------------------------------------- */
+static char *format_report ( int rank, double ns_per_tick, int *len )
+{
+  size_t cap = 4096, pos = 0;
+  char *buf = malloc( cap );
+  char  cname[32];
+  int   i, b;
+  prof_entry *e;
+
+#define OUT(...)                                                         \
+  do {                                                                   \
+    int n_;                                                              \
+    while ( (n_ = snprintf( buf + pos, cap - pos, __VA_ARGS__ )) < 0     \
+            || (size_t)n_ >= cap - pos )                                 \
+      buf = realloc( buf, cap *= 2 );                                    \
+    pos += n_;                                                           \
+  } while (0)
+
+  OUT( "== task %d  (%.1f s in run, %d table overflows, %d untracked"
+       " requests)\n", rank, wtime1 - wtime0, overflow, req_overflow );
+  OUT( "%-13s %-10s %5s %10s %14s %12s %10s  latency histogram"
+       " (ns lower bound:count)\n",
+       "call", "comm", "peer", "calls", "bytes", "total us", "avg ns" );
+  for ( i = 0; i < NSLOT; i++ ) {
+    e = &table[i];
+    if ( !e->used ) continue;
+    if ( e->comm == COMM_OTHER )
+      strcpy( cname, "other" );
+    else if ( comm_handle[e->comm] == MPI_COMM_WORLD )
+      strcpy( cname, "WORLD" );
+    else
+      snprintf( cname, sizeof(cname), "#%d(%d)", e->comm, comm_size[e->comm] );
+    OUT( "%-13s %-10s %5d %10lld %14lld %12.1f %10.0f ",
+         call_name[e->call], cname, e->peer, e->count, e->bytes,
+         e->ticks * ns_per_tick / 1000.0,
+         e->ticks * ns_per_tick / e->count );
+    for ( b = 0; b < NBUCKET; b++ )
+      if ( e->hist[b] )
+        OUT( " %.0f:%lld", b ? (double)(1ULL << (b-1)) * ns_per_tick : 0.0,
+             e->hist[b] );
+    OUT( "\n" );
+  }
+#undef OUT
+  *len = (int)pos + 1;
+  return buf;
+}
+
+static void write_report ( void )
+{
+  int   rank, ntasks, len, i, *lens = NULL, *displs = NULL;
+  char *mine, *all = NULL;
+  const char *fname;
+  FILE *fp;
+  double ns_per_tick;
+
+  PMPI_Comm_rank( MPI_COMM_WORLD, &rank );
+  PMPI_Comm_size( MPI_COMM_WORLD, &ntasks );
+
+  ns_per_tick = tick1 > tick0 ? (wtime1 - wtime0) * 1e9 / (tick1 - tick0)
+                              : 1.0;
+  mine = format_report( rank, ns_per_tick, &len );
+
+  if ( rank == 0 ) {
+    lens = malloc( ntasks * sizeof(int) );
+    displs = malloc( ntasks * sizeof(int) );
+  }
+  PMPI_Gather( &len, 1, MPI_INT, lens, 1, MPI_INT, 0, MPI_COMM_WORLD );
+  if ( rank == 0 ) {
+    for ( i = 0, displs[0] = 0; i < ntasks - 1; i++ )
+      displs[i+1] = displs[i] + lens[i];
+    all = malloc( displs[ntasks-1] + lens[ntasks-1] );
+  }
+  PMPI_Gatherv( mine, len, MPI_CHAR, all, lens, displs, MPI_CHAR, 0,
+                MPI_COMM_WORLD );
+
+  if ( rank == 0 ) {
+    fname = getenv( "MPIPROF_FILE" );
+    if ( fname == NULL ) fname = "mpi_prof.txt";
+    fp = strcmp( fname, "-" ) ? fopen( fname, "w" ) : stdout;
+    if ( fp == NULL ) {
+      perror( fname );
+    } else {
+      fprintf( fp, "MPI profile of %d tasks\n", ntasks );
+      for ( i = 0; i < ntasks; i++ )
+        fputs( all + displs[i], fp );
+      if ( fp != stdout ) fclose( fp );
+    }
+    free( all ); free( lens ); free( displs );
+  }
+  free( mine );
+}
+
+/* -------------------------------------------------------------------
+ * init and finalize
+ * ------------------------------------------------------------------- */
+int MPI_Init ( int *argc, char ***argv )
+{
+  int rc = PMPI_Init( argc, argv );
+  wtime0 = PMPI_Wtime();
+  tick0 = now();
+  return rc;
+}
+
+int MPI_Init_thread ( int *argc, char ***argv, int required, int *provided )
+{
+  int rc = PMPI_Init_thread( argc, argv, required, provided );
+  wtime0 = PMPI_Wtime();
+  tick0 = now();
+  return rc;
+}
+
+int MPI_Finalize ( void )
+{
+  tick1 = now();
+  wtime1 = PMPI_Wtime();
+  write_report();
+  return PMPI_Finalize();
+}
+
+/* -------------------------------------------------------------------
+ * point-to-point
+ * ------------------------------------------------------------------- */
+int MPI_Send ( const void *buf, int count, MPI_Datatype type, int dest,
+               int tag, MPI_Comm comm )
+{
+  int rc;
+  PROF( C_SEND, comm, dest, nbytes( count, type ),
+        PMPI_Send( buf, count, type, dest, tag, comm ) );
+  return rc;
+}
+
+int MPI_Ssend ( const void *buf, int count, MPI_Datatype type, int dest,
+                int tag, MPI_Comm comm )
+{
+  int rc;
+  PROF( C_SSEND, comm, dest, nbytes( count, type ),
+        PMPI_Ssend( buf, count, type, dest, tag, comm ) );
+  return rc;
+}
+
+int MPI_Rsend ( const void *buf, int count, MPI_Datatype type, int dest,
+                int tag, MPI_Comm comm )
+{
+  int rc;
+  PROF( C_RSEND, comm, dest, nbytes( count, type ),
+        PMPI_Rsend( buf, count, type, dest, tag, comm ) );
+  return rc;
+}
+
+int MPI_Bsend ( const void *buf, int count, MPI_Datatype type, int dest,
+                int tag, MPI_Comm comm )
+{
+  int rc;
+  PROF( C_BSEND, comm, dest, nbytes( count, type ),
+        PMPI_Bsend( buf, count, type, dest, tag, comm ) );
+  return rc;
+}
+
+int MPI_Isend ( const void *buf, int count, MPI_Datatype type, int dest,
+                int tag, MPI_Comm comm, MPI_Request *request )
+{
+  int rc;
+  PROF( C_ISEND, comm, dest, nbytes( count, type ),
+        PMPI_Isend( buf, count, type, dest, tag, comm, request ) );
+  if ( rc == MPI_SUCCESS ) req_add( *request, comm, dest );
+  return rc;
+}
+
+int MPI_Recv ( void *buf, int count, MPI_Datatype type, int source,
+               int tag, MPI_Comm comm, MPI_Status *status )
+{
+  int rc;
+  MPI_Status st;
+  unsigned long long t = now();
+  if ( status == MPI_STATUS_IGNORE ) status = &st;
+  rc = PMPI_Recv( buf, count, type, source, tag, comm, status );
+  t = now() - t;
+  if ( rc == MPI_SUCCESS )
+    account( C_RECV, comm, source == MPI_ANY_SOURCE ? status->MPI_SOURCE
+                                                    : source,
+             nbytes( count, type ), t );
+  return rc;
+}
+
+int MPI_Irecv ( void *buf, int count, MPI_Datatype type, int source,
+                int tag, MPI_Comm comm, MPI_Request *request )
+{
+  int rc;
+  PROF( C_IRECV, comm, source, nbytes( count, type ),
+        PMPI_Irecv( buf, count, type, source, tag, comm, request ) );
+  if ( rc == MPI_SUCCESS ) req_add( *request, comm, source );
+  return rc;
+}
+
+int MPI_Sendrecv ( const void *sendbuf, int sendcount, MPI_Datatype sendtype,
+                   int dest, int sendtag, void *recvbuf, int recvcount,
+                   MPI_Datatype recvtype, int source, int recvtag,
+                   MPI_Comm comm, MPI_Status *status )
+{
+  int rc;
+  PROF( C_SENDRECV, comm, dest, nbytes( sendcount, sendtype ),
+        PMPI_Sendrecv( sendbuf, sendcount, sendtype, dest, sendtag,
+                       recvbuf, recvcount, recvtype, source, recvtag,
+                       comm, status ) );
+  return rc;
+}
+
+int MPI_Probe ( int source, int tag, MPI_Comm comm, MPI_Status *status )
+{
+  int rc;
+  PROF( C_PROBE, comm, source, 0,
+        PMPI_Probe( source, tag, comm, status ) );
+  return rc;
+}
+
+int MPI_Wait ( MPI_Request *request, MPI_Status *status )
+{
+  int rc, i = req_find( *request );
+  MPI_Status st;
+  unsigned long long t = now();
+  if ( status == MPI_STATUS_IGNORE ) status = &st;
+  rc = PMPI_Wait( request, status );
+  t = now() - t;
+  if ( rc != MPI_SUCCESS ) return rc;
+  account_req( C_WAIT, i, status, t );
+  if ( i >= 0 ) req_del( i );
+  return rc;
+}
+
+int MPI_Waitall ( int count, MPI_Request requests[], MPI_Status statuses[] )
+{
+  int rc;
+  unsigned long long t;
+  if ( copy_reqs( count, requests ) )
+    return PMPI_Waitall( count, requests, statuses );
+  if ( statuses == MPI_STATUSES_IGNORE ) statuses = st_copy;
+  t = now();
+  rc = PMPI_Waitall( count, requests, statuses );
+  t = now() - t;
+  if ( rc == MPI_SUCCESS )
+    account_reqs( C_WAITALL, count, NULL, statuses, 1, t );
+  return rc;
+}
+
+int MPI_Waitany ( int count, MPI_Request requests[], int *index,
+                  MPI_Status *status )
+{
+  int rc;
+  MPI_Status st;
+  unsigned long long t;
+  if ( copy_reqs( count, requests ) )
+    return PMPI_Waitany( count, requests, index, status );
+  if ( status == MPI_STATUS_IGNORE ) status = &st;
+  t = now();
+  rc = PMPI_Waitany( count, requests, index, status );
+  t = now() - t;
+  if ( rc == MPI_SUCCESS )
+    account_reqs( C_WAITANY, *index != MPI_UNDEFINED, index, status, 1, t );
+  return rc;
+}
+
+int MPI_Waitsome ( int incount, MPI_Request requests[], int *outcount,
+                   int indices[], MPI_Status statuses[] )
+{
+  int rc;
+  unsigned long long t;
+  if ( copy_reqs( incount, requests ) )
+    return PMPI_Waitsome( incount, requests, outcount, indices, statuses );
+  if ( statuses == MPI_STATUSES_IGNORE ) statuses = st_copy;
+  t = now();
+  rc = PMPI_Waitsome( incount, requests, outcount, indices, statuses );
+  t = now() - t;
+  if ( rc == MPI_SUCCESS )
+    account_reqs( C_WAITSOME, *outcount != MPI_UNDEFINED ? *outcount : 0,
+                  indices, statuses, 1, t );
+  return rc;
+}
+
+int MPI_Test ( MPI_Request *request, int *flag, MPI_Status *status )
+{
+  int rc, i = req_find( *request );
+  MPI_Status st;
+  unsigned long long t = now();
+  if ( status == MPI_STATUS_IGNORE ) status = &st;
+  rc = PMPI_Test( request, flag, status );
+  t = now() - t;
+  if ( rc != MPI_SUCCESS ) return rc;
+  account_req( C_TEST, i, *flag ? status : NULL, t );
+  if ( *flag && i >= 0 ) req_del( i );
+  return rc;
+}
+
+int MPI_Testall ( int count, MPI_Request requests[], int *flag,
+                  MPI_Status statuses[] )
+{
+  int rc;
+  unsigned long long t;
+  if ( copy_reqs( count, requests ) )
+    return PMPI_Testall( count, requests, flag, statuses );
+  if ( statuses == MPI_STATUSES_IGNORE ) statuses = st_copy;
+  t = now();
+  rc = PMPI_Testall( count, requests, flag, statuses );
+  t = now() - t;
+  if ( rc == MPI_SUCCESS )
+    account_reqs( C_TESTALL, count, NULL, *flag ? statuses : NULL, *flag, t );
+  return rc;
+}
+
+int MPI_Testany ( int count, MPI_Request requests[], int *index, int *flag,
+                  MPI_Status *status )
+{
+  int rc;
+  MPI_Status st;
+  unsigned long long t;
+  if ( copy_reqs( count, requests ) )
+    return PMPI_Testany( count, requests, index, flag, status );
+  if ( status == MPI_STATUS_IGNORE ) status = &st;
+  t = now();
+  rc = PMPI_Testany( count, requests, index, flag, status );
+  t = now() - t;
+  if ( rc != MPI_SUCCESS ) return rc;
+  if ( *flag )
+    account_reqs( C_TESTANY, *index != MPI_UNDEFINED, index, status, 1, t );
+  else
+    account_reqs( C_TESTANY, count, NULL, NULL, 0, t );
+  return rc;
+}
+
+int MPI_Testsome ( int incount, MPI_Request requests[], int *outcount,
+                   int indices[], MPI_Status statuses[] )
+{
+  int rc;
+  unsigned long long t;
+  if ( copy_reqs( incount, requests ) )
+    return PMPI_Testsome( incount, requests, outcount, indices, statuses );
+  if ( statuses == MPI_STATUSES_IGNORE ) statuses = st_copy;
+  t = now();
+  rc = PMPI_Testsome( incount, requests, outcount, indices, statuses );
+  t = now() - t;
+  if ( rc != MPI_SUCCESS ) return rc;
+  if ( *outcount > 0 )
+    account_reqs( C_TESTSOME, *outcount, indices, statuses, 1, t );
+  else
+    account_reqs( C_TESTSOME, incount, NULL, NULL, 0, t );
+  return rc;
+}
+
+int MPI_Request_free ( MPI_Request *request )
+{
+  int i = req_find( *request );
+  if ( i >= 0 ) req_del( i );
+  return PMPI_Request_free( request );
+}
+
+/* -------------------------------------------------------------------
+ * communicators
+ * ------------------------------------------------------------------- */
+int MPI_Comm_free ( MPI_Comm *comm )
+{
+  int i = comm_find( *comm );
+  if ( i >= 0 ) comm_live[i] = 0;     /* keep the rows, drop the handle */
+  return PMPI_Comm_free( comm );
+}
+
+/* -------------------------------------------------------------------
+ * collectives
+ * ------------------------------------------------------------------- */
+int MPI_Barrier ( MPI_Comm comm )
+{
+  int rc;
+  PROF( C_BARRIER, comm, NOPEER, 0, PMPI_Barrier( comm ) );
+  return rc;
+}
+
+int MPI_Bcast ( void *buf, int count, MPI_Datatype type, int root,
+                MPI_Comm comm )
+{
+  int rc;
+  PROF( C_BCAST, comm, root, nbytes( count, type ),
+        PMPI_Bcast( buf, count, type, root, comm ) );
+  return rc;
+}
+
+int MPI_Reduce ( const void *sendbuf, void *recvbuf, int count,
+                 MPI_Datatype type, MPI_Op op, int root, MPI_Comm comm )
+{
+  int rc;
+  PROF( C_REDUCE, comm, root, nbytes( count, type ),
+        PMPI_Reduce( sendbuf, recvbuf, count, type, op, root, comm ) );
+  return rc;
+}
+
+int MPI_Allreduce ( const void *sendbuf, void *recvbuf, int count,
+                    MPI_Datatype type, MPI_Op op, MPI_Comm comm )
+{
+  int rc;
+  PROF( C_ALLREDUCE, comm, NOPEER, nbytes( count, type ),
+        PMPI_Allreduce( sendbuf, recvbuf, count, type, op, comm ) );
+  return rc;
+}
+
+int MPI_Scatter ( const void *sendbuf, int sendcount, MPI_Datatype sendtype,
+                  void *recvbuf, int recvcount, MPI_Datatype recvtype,
+                  int root, MPI_Comm comm )
+{
+  int rc;
+  PROF( C_SCATTER, comm, root, nbytes( recvcount, recvtype ),
+        PMPI_Scatter( sendbuf, sendcount, sendtype, recvbuf, recvcount,
+                      recvtype, root, comm ) );
+  return rc;
+}
+
+int MPI_Scatterv ( const void *sendbuf, const int sendcounts[],
+                   const int displs[], MPI_Datatype sendtype, void *recvbuf,
+                   int recvcount, MPI_Datatype recvtype, int root,
+                   MPI_Comm comm )
+{
+  int rc;
+  PROF( C_SCATTERV, comm, root, nbytes( recvcount, recvtype ),
+        PMPI_Scatterv( sendbuf, sendcounts, displs, sendtype, recvbuf,
+                       recvcount, recvtype, root, comm ) );
+  return rc;
+}
+
+int MPI_Gather ( const void *sendbuf, int sendcount, MPI_Datatype sendtype,
+                 void *recvbuf, int recvcount, MPI_Datatype recvtype,
+                 int root, MPI_Comm comm )
+{
+  int rc;
+  PROF( C_GATHER, comm, root, nbytes( sendcount, sendtype ),
+        PMPI_Gather( sendbuf, sendcount, sendtype, recvbuf, recvcount,
+                     recvtype, root, comm ) );
+  return rc;
+}
+
+int MPI_Gatherv ( const void *sendbuf, int sendcount, MPI_Datatype sendtype,
+                  void *recvbuf, const int recvcounts[], const int displs[],
+                  MPI_Datatype recvtype, int root, MPI_Comm comm )
+{
+  int rc;
+  PROF( C_GATHERV, comm, root, nbytes( sendcount, sendtype ),
+        PMPI_Gatherv( sendbuf, sendcount, sendtype, recvbuf, recvcounts,
+                      displs, recvtype, root, comm ) );
+  return rc;
+}
+
+int MPI_Allgather ( const void *sendbuf, int sendcount, MPI_Datatype sendtype,
+                    void *recvbuf, int recvcount, MPI_Datatype recvtype,
+                    MPI_Comm comm )
+{
+  int rc;
+  PROF( C_ALLGATHER, comm, NOPEER, nbytes( sendcount, sendtype ),
+        PMPI_Allgather( sendbuf, sendcount, sendtype, recvbuf, recvcount,
+                        recvtype, comm ) );
+  return rc;
+}
+
+int MPI_Alltoall ( const void *sendbuf, int sendcount, MPI_Datatype sendtype,
+                   void *recvbuf, int recvcount, MPI_Datatype recvtype,
+                   MPI_Comm comm )
+{
+  int rc;
+  PROF( C_ALLTOALL, comm, NOPEER, nbytes( sendcount, sendtype ),
+        PMPI_Alltoall( sendbuf, sendcount, sendtype, recvbuf, recvcount,
+                       recvtype, comm ) );
+  return rc;
+}
@@ -0,0 +1,60 @@
+#!/bin/sh
+# -----------------------------------------------------------------------
+# compara_hibrido.sh
+#   Compares the flat MPI layout (one task per core) with the hybrid
+#   MPI+OpenMP layout (one task per socket, one thread per core) of the
+#   dartboard pi (ex4) and prime (ex3) examples, on the same number of
+#   cores.
+#
+#   Usage: ./compara_hibrido.sh [cores] [sockets]
+#     cores   - total number of cores to use (default: all of this node)
+#     sockets - number of sockets, i.e. hybrid MPI tasks (default: lscpu)
+#
+#   The flat prime example needs an even number of tasks dividing 2500000.
+#
+#   MPIRUN may be set to add launcher options, e.g. under PBS:
+#     MPIRUN="mpirun -rmk pbs" ./compara_hibrido.sh 48 24
+# -----------------------------------------------------------------------
+cd `dirname $0`
+
+CORES=${1:-`nproc`}
+SOCKETS=${2:-`lscpu | awk -F: '/^Socket\(s\)/ {gsub(/ /,"",$2); print $2}'`}
+SOCKETS=${SOCKETS:-1}
+MPIRUN=${MPIRUN:-mpirun}
+MPICC=${MPICC:-mpicc}
+
+if [ $SOCKETS -gt $CORES ]; then SOCKETS=$CORES; fi
+THREADS=`expr $CORES / $SOCKETS`
+
+echo "-----------------------------------------"
+echo "Hostname: " `hostname`
+echo "Cores: $CORES  flat: $CORES tasks x 1 thread" \
+     " hybrid: $SOCKETS tasks x $THREADS threads"
+
+$MPICC -O2 -o ex4/pi_flat ex4/solucao.c ex4/dboard.c || exit 1
+$MPICC -O2 -fopenmp -o ex4/pi_hibrido ex4/pi_hibrido.c ex4/dboard_omp.c || exit 1
+$MPICC -O2 -o ex3/prime_flat ex3/solucao.c -lm || exit 1
+$MPICC -O2 -fopenmp -o ex3/prime_hibrido ex3/mpi_prime_hibrido.c -lm || exit 1
+
+# wallclock time of a whole run, launch included, in seconds
+run() {
+  t0=`date +%s.%N`
+  "$@" > /dev/null
+  t1=`date +%s.%N`
+  awk "BEGIN { printf \"%.3f\", $t1 - $t0 }"
+}
+
+FLAT="$MPIRUN -np $CORES --bind-to core"
+HYBRID="$MPIRUN -np $SOCKETS --map-by ppr:1:socket:pe=$THREADS --bind-to core \
+        -x OMP_NUM_THREADS=$THREADS -x OMP_PROC_BIND=close -x OMP_PLACES=cores"
+
+echo "program      layout   tasks threads  seconds"
+printf "pi           flat     %5d %7d  %s\n" $CORES 1 \
+       `run $FLAT ex4/pi_flat`
+printf "pi           hybrid   %5d %7d  %s\n" $SOCKETS $THREADS \
+       `run $HYBRID ex4/pi_hibrido`
+printf "prime        flat     %5d %7d  %s\n" $CORES 1 \
+       `run $FLAT ex3/prime_flat`
+printf "prime        hybrid   %5d %7d  %s\n" $SOCKETS $THREADS \
+       `run $HYBRID ex3/prime_hibrido`
+echo "-----------------------------------------"
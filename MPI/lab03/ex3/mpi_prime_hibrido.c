@@ -0,0 +1,109 @@
+/******************************************************************************
+* FILE: mpi_prime_hibrido.c
+* DESCRIPTION:
+*   Hybrid MPI+OpenMP version of mpi_prime.c (see solucao.c).  The intended
+*   layout is one MPI task per socket with a team of OpenMP threads on the
+*   cores of the socket.  Tasks still take every nth odd number, with the
+*   stride computed from the number of tasks; inside a task the candidates
+*   are shared by the threads with a dynamic schedule, since the numbers in
+*   the higher range require more work.  The thread counters are combined
+*   with OpenMP reductions, so the two MPI_Reduce calls only see one value
+*   per task.
+*   Only the master thread calls MPI, outside the parallel region, so
+*   MPI_THREAD_FUNNELED is requested.
+*   Unlike solucao.c, any number of tasks can be used.
+* AUTHOR: based on mpi_prime.c by Blaise Barney
+******************************************************************************/
+#include "mpi.h"
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#define LIMIT     2500000     /* Increase this to find more primes */
+#define FIRST     0           /* Rank of first task */
+#define CHUNK     256         /* Candidates taken at a time by a thread */
+
+int isprime(int n) {
+int i,squareroot;
+if (n>10) {
+   squareroot = (int) sqrt(n);
+   for (i=3; i<=squareroot; i=i+2)
+      if ((n%i)==0)
+         return 0;
+   return 1;
+   }
+/* Assume first four primes are counted elsewhere. Forget everything else */
+else
+   return 0;
+}
+
+
+int main (int argc, char *argv[])
+{
+int   ntasks,               /* total number of tasks in partitiion */
+      rank,                 /* task identifier */
+      provided,             /* thread support level granted by MPI */
+      nthreads,             /* number of OpenMP threads of each task */
+      k,                    /* loop variable - candidate index */
+      ncand,                /* number of candidates of this task */
+      n,                    /* candidate number */
+      pc,                   /* prime counter */
+      pcsum,                /* number of primes found by all tasks */
+      foundone,             /* most recent prime found */
+      maxprime,             /* largest prime found */
+      mystart,              /* where to start calculating */
+      stride;               /* calculate every nth number */
+
+double start_time,end_time;
+
+MPI_Init_thread(&argc,&argv,MPI_THREAD_FUNNELED,&provided);
+MPI_Comm_rank(MPI_COMM_WORLD,&rank);
+MPI_Comm_size(MPI_COMM_WORLD,&ntasks);
+if (provided < MPI_THREAD_FUNNELED) {
+   if (rank == FIRST)
+      printf("MPI library does not support MPI_THREAD_FUNNELED. Quitting.\n");
+   MPI_Finalize();
+   exit(1);
+   }
+nthreads = omp_get_max_threads();
+
+start_time = MPI_Wtime();   /* Initialize start time */
+mystart = (rank*2)+1;       /* Find my starting point - must be odd number */
+stride = ntasks*2;          /* Determine stride, skipping even numbers */
+ncand = (mystart <= LIMIT) ? (LIMIT-mystart)/stride + 1 : 0;
+pc=0;                       /* Initialize prime counter */
+foundone = 0;               /* Initialize */
+
+if (rank == FIRST) {
+   printf("Using %d tasks x %d threads to scan %d numbers\n",
+          ntasks,nthreads,LIMIT);
+   pc = 4;                  /* Assume first four primes are counted here */
+   }
+
+/******************** all threads of all tasks do this part *****************/
+/* The loop runs over candidate indexes so that the iterations can be
+ * scheduled; n is recomputed from the index */
+#pragma omp parallel for private(k,n) schedule(dynamic,CHUNK) \
+                         reduction(+:pc) reduction(max:foundone)
+for (k=0; k<ncand; k++) {
+   n = mystart + k*stride;
+   if (isprime(n)) {
+      pc++;
+      if (n > foundone)
+         foundone = n;
+      }
+   }
+
+MPI_Reduce(&pc,&pcsum,1,MPI_INT,MPI_SUM,FIRST,MPI_COMM_WORLD);
+MPI_Reduce(&foundone,&maxprime,1,MPI_INT,MPI_MAX,FIRST,MPI_COMM_WORLD);
+
+if (rank == FIRST) {
+   end_time=MPI_Wtime();
+   printf("Done. Largest prime is %d Total primes %d\n",maxprime,pcsum);
+   printf("Wallclock time elapsed: %.2lf seconds\n",end_time-start_time);
+   }
+
+MPI_Finalize();
+return 0;
+}
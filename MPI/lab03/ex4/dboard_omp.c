@@ -0,0 +1,68 @@
+/******************************************************************************
+* FILE: dboard_omp.c
+* DESCRIPTION:
+*   Used in the hybrid pi calculation example (pi_hibrido.c).
+*   Same dartboard algorithm as dboard.c, but the darts are thrown by a
+*   team of OpenMP threads.  random() keeps one hidden state for the whole
+*   process and is serialized by the C library, so each thread keeps its
+*   own erand48() state instead, derived from the task seed and the thread
+*   number.  The thread scores are combined with an OpenMP reduction.
+*   darts is the number of throws per thread, so a task throws
+*   darts * omp_get_max_threads() darts in total.
+* AUTHOR: based on dboard.c
+******************************************************************************/
+/*
+Explanation of constants and variables used in this function:
+  darts       = number of throws at dartboard by each thread
+  seed        = seed of the calling task, mixed with the thread number;
+                the caller must change it between calls, the generators
+                are restarted from it every time
+  score       = number of darts that hit circle (all threads)
+  total       = number of darts thrown (all threads)
+  xsubi       = private random number state of each thread
+  x_coord     = x coordinate, between -1 and 1
+  y_coord     = y coordinate, between -1 and 1
+  pi          = computed value of pi
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+#define sqr(x)	((x)*(x))
+
+double dboard_omp(int darts, unsigned int seed)
+  {
+  double x_coord, y_coord, pi;
+  long score, total;
+  int n, tid;
+  unsigned short xsubi[3];
+
+  score = 0;
+  total = 0;
+
+  /* "throw darts at board" - every thread with its own generator */
+#pragma omp parallel private(n,tid,xsubi,x_coord,y_coord) \
+                     reduction(+:score,total)
+    {
+    tid = omp_get_thread_num();
+    xsubi[0] = (unsigned short)(seed & 0xffff);
+    xsubi[1] = (unsigned short)(seed >> 16);
+    xsubi[2] = (unsigned short)(tid + 1);
+
+    for (n = 1; n <= darts; n++)  {
+      /* generate random numbers for x and y coordinates */
+      x_coord = (2.0 * erand48(xsubi)) - 1.0;
+      y_coord = (2.0 * erand48(xsubi)) - 1.0;
+
+      /* if dart lands in circle, increment score */
+      if ((sqr(x_coord) + sqr(y_coord)) <= 1.0)
+           score++;
+      }
+    total += darts;
+    }
+
+  /* calculate pi */
+  pi = 4.0 * (double)score/(double)total;
+  return(pi);
+  }
@@ -0,0 +1,96 @@
+/**********************************************************************
+ * FILE: pi_hibrido.c
+ * OTHER FILES: dboard_omp.c
+ * DESCRIPTION:
+ *   MPI+OpenMP pi Calculation Example - C Version
+ *   Hybrid version of the dartboard pi calculation in solucao.c.  The
+ *   intended layout is one MPI task per socket, each task running a team
+ *   of OpenMP threads on the cores of its socket.  The threads of a task
+ *   are combined with an OpenMP reduction inside dboard_omp(), so each
+ *   round needs one MPI_Reduce contribution per socket instead of one
+ *   per core.
+ *   Only the master thread calls MPI, and always outside the parallel
+ *   region, so MPI_THREAD_FUNNELED is requested.
+ *   Every thread throws DARTS darts per round (the same as a task of the
+ *   flat version), so flat and hybrid runs on the same number of cores
+ *   throw the same number of darts.  See ../compara_hibrido.sh.
+ * USAGE: pi_hibrido [darts_per_thread]
+ * AUTHOR: based on mpi_pi_reduce.c by Blaise Barney
+**********************************************************************/
+#include "mpi.h"
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+double dboard_omp (int darts, unsigned int seed);
+#define DARTS 50000     /* number of throws at dartboard by each thread */
+#define ROUNDS 10       /* number of times "darts" is iterated */
+#define MASTER 0        /* task ID of master task */
+
+int main (int argc, char *argv[])
+{
+double	homepi,         /* value of pi calculated by current task */
+	pisum,	        /* sum of tasks' pi values */
+	pi,	        /* average of pi after "darts" is thrown */
+	avepi,	        /* average pi value for all iterations */
+	start_time,     /* wallclock time of the rounds */
+	end_time;
+int	taskid,	        /* task ID - also used as seed number */
+	numtasks,       /* number of tasks */
+	nthreads,       /* number of OpenMP threads of each task */
+	provided,       /* thread support level granted by MPI */
+	darts,          /* number of throws by each thread per round */
+	rc,             /* return code */
+	i;
+
+/* Obtain number of tasks and task ID */
+MPI_Init_thread(&argc,&argv,MPI_THREAD_FUNNELED,&provided);
+MPI_Comm_size(MPI_COMM_WORLD,&numtasks);
+MPI_Comm_rank(MPI_COMM_WORLD,&taskid);
+if (provided < MPI_THREAD_FUNNELED) {
+   if (taskid == MASTER)
+      printf("MPI library does not support MPI_THREAD_FUNNELED. Quitting.\n");
+   MPI_Finalize();
+   exit(1);
+   }
+
+darts = DARTS;
+if (argc >= 2) darts = atoi(argv[1]);
+nthreads = omp_get_max_threads();
+printf ("MPI task %d has started with %d threads...\n", taskid, nthreads);
+if (taskid == MASTER)
+   printf ("Using %d tasks x %d threads to compute pi (3.1415926535)\n",
+           numtasks,nthreads);
+
+MPI_Barrier(MPI_COMM_WORLD);
+start_time = MPI_Wtime();
+
+avepi = 0;
+for (i = 0; i < ROUNDS; i++) {
+   /* All threads of all tasks calculate pi using dartboard algorithm.
+    * The seed changes with the task and the round, dboard_omp() mixes
+    * in the thread number. */
+   homepi = dboard_omp(darts, (unsigned int)(taskid * ROUNDS + i + 1));
+
+   /* One contribution per task: the threads were already reduced */
+   rc = MPI_Reduce(&homepi, &pisum, 1, MPI_DOUBLE, MPI_SUM,
+                      MASTER, MPI_COMM_WORLD);
+   if (rc != MPI_SUCCESS)
+      printf("%d: failure on mpc_reduce\n", taskid);
+
+   /* Master computes average for this iteration and all iterations */
+   if (taskid == MASTER) {
+      pi = pisum/numtasks;
+      avepi = ((avepi * i) + pi)/(i + 1);
+      printf("   After %10ld throws, average value of pi = %10.8f\n",
+                (long)darts * nthreads * numtasks * (i + 1),avepi);
+   }
+}
+
+end_time = MPI_Wtime();
+if (taskid == MASTER)
+   printf("Wallclock time elapsed: %.4lf seconds\n",end_time-start_time);
+
+MPI_Finalize();
+return 0;
+}
@@ -0,0 +1,274 @@
+/******************************************************************************
+* FILE: hostoff.c
+* DESCRIPTION:
+*   Persistent host team of hostoff.h.  The threads are created once and
+*   pinned, one per cpu of the chosen NUMA node (read from sysfs).  A
+*   launch publishes the function and its argument and increments a
+*   generation counter; the threads spin on the counter, run the function
+*   and count themselves done.  Waiting threads yield the cpu after SPINS
+*   tries, or at once when the team shares a cpu with the caller (a node
+*   with a single cpu), so an idle team does not starve the caller.
+*   Counters that are written by different threads live in their own cache
+*   line.
+* BUILD:  gcc -O2 -pthread -c hostoff.c
+******************************************************************************/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include "hostoff.h"
+
+#define SPINS     4096
+#define MAXCPU    1024
+#define CACHELINE 64
+
+typedef struct {
+  atomic_long v;
+  char pad[CACHELINE - sizeof(atomic_long)];
+} __attribute__((aligned(CACHELINE))) line_t;
+
+struct hostoff_team_s {
+  line_t      generation;       /* incremented by every launch */
+  line_t      done;             /* threads done with the current region */
+  line_t      arrived;          /* hostoff_barrier() counter */
+  line_t      sense;            /* hostoff_barrier() release */
+  hostoff_fn  fn;
+  void       *arg;
+  int         nthreads, node, stop, pending, spins;
+  int        *cpus;
+  pthread_t  *threads;
+  hostoff_stats_t stats;
+};
+
+typedef struct {
+  hostoff_team_t *team;
+  int             tid;
+} worker_arg_t;
+
+static inline void cpu_relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#endif
+}
+
+static inline void spin_while(atomic_long *f, long v, int spins)
+{
+  int k = 0;
+  while (atomic_load_explicit(f, memory_order_acquire) == v) {
+    if (++k < spins)
+      cpu_relax();
+    else {
+      sched_yield();
+      k = 0;
+    }
+  }
+}
+
+/* cpus of a NUMA node from sysfs, e.g. "0-3,8-11"; returns their number */
+static int node_cpus(int node, int *cpus)
+{
+  char path[64], buf[4096], *p = buf;
+  FILE *f;
+  int n = 0, a, b, i;
+  cpu_set_t set;
+
+  snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+  if ((f = fopen(path, "r")) != NULL) {
+    if (fgets(buf, sizeof(buf), f) != NULL)
+      while (*p >= '0' && *p <= '9' && n < MAXCPU) {
+        a = b = strtol(p, &p, 10);
+        if (*p == '-') b = strtol(p + 1, &p, 10);
+        for (i = a; i <= b && n < MAXCPU; i++)
+          cpus[n++] = i;
+        if (*p == ',') p++;
+      }
+    fclose(f);
+  }
+  if (n == 0 && sched_getaffinity(0, sizeof(set), &set) == 0)
+    for (i = 0; i < CPU_SETSIZE && n < MAXCPU; i++)
+      if (CPU_ISSET(i, &set))
+        cpus[n++] = i;
+  return n;
+}
+
+/* the highest node with cpus that is not the node of the caller */
+static int pick_node(void)
+{
+  int cpus[MAXCPU], node, here = sched_getcpu(), i, n;
+  char path[64];
+
+  for (node = MAXCPU - 1; node > 0; node--) {
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d", node);
+    if (access(path, F_OK) != 0 || (n = node_cpus(node, cpus)) == 0)
+      continue;
+    for (i = 0; i < n && cpus[i] != here; i++)
+      ;
+    if (i == n)
+      return node;
+  }
+  return 0;
+}
+
+static void *worker(void *p)
+{
+  worker_arg_t *w = p;
+  hostoff_team_t *t = w->team;
+  int tid = w->tid;
+  long gen = 0;
+
+  free(w);
+  for (;;) {
+    spin_while(&t->generation.v, gen, t->spins);
+    gen++;
+    if (t->stop)
+      return NULL;
+    t->fn(t->arg, tid, t->nthreads);
+    atomic_fetch_add_explicit(&t->done.v, 1, memory_order_release);
+  }
+}
+
+hostoff_team_t *hostoff_create(int nthreads, int node)
+{
+  const char *env = getenv("HOSTOFF_NODE");
+  int cpus[MAXCPU], ncpus, i, here = sched_getcpu(), shared = 0;
+  hostoff_team_t *t;
+  pthread_attr_t attr;
+  cpu_set_t set;
+
+  if (env != NULL) node = atoi(env);
+  if (node < 0) node = pick_node();
+  ncpus = node_cpus(node, cpus);
+  if (ncpus == 0) {
+    fprintf(stderr, "hostoff_create: no cpus for node %d\n", node);
+    return NULL;
+  }
+  /* leave the cpu of the caller out of the team, if there are others */
+  for (i = 0; i < ncpus && cpus[i] != here; i++)
+    ;
+  if (i < ncpus && ncpus > 1)
+    cpus[i] = cpus[--ncpus];
+  if (nthreads <= 0) nthreads = ncpus;
+  for (i = 0; i < (nthreads < ncpus ? nthreads : ncpus); i++)
+    shared |= cpus[i] == here;
+
+  t = aligned_alloc(CACHELINE,
+                    (sizeof(*t) + CACHELINE - 1) / CACHELINE * CACHELINE);
+  if (t == NULL) return NULL;
+  memset(t, 0, sizeof(*t));
+  t->nthreads = nthreads;
+  t->node = node;
+  t->spins = shared || nthreads > ncpus ? 1 : SPINS;
+  t->cpus = malloc(nthreads * sizeof(int));
+  t->threads = malloc(nthreads * sizeof(pthread_t));
+  if (t->cpus == NULL || t->threads == NULL) {
+    free(t->cpus); free(t->threads); free(t);
+    return NULL;
+  }
+
+  pthread_attr_init(&attr);
+  for (i = 0; i < nthreads; i++) {
+    worker_arg_t *w = malloc(sizeof(*w));
+    t->cpus[i] = cpus[i % ncpus];
+    CPU_ZERO(&set);
+    CPU_SET(t->cpus[i], &set);
+    pthread_attr_setaffinity_np(&attr, sizeof(set), &set);
+    if (w != NULL) {
+      w->team = t;
+      w->tid = i;
+    }
+    if (w == NULL || pthread_create(&t->threads[i], &attr, worker, w) != 0) {
+      fprintf(stderr, "hostoff_create: cannot start thread %d\n", i);
+      free(w);
+      pthread_attr_destroy(&attr);
+      /* only the threads already started are stopped and joined */
+      t->nthreads = i;
+      hostoff_destroy(t);
+      return NULL;
+    }
+  }
+  pthread_attr_destroy(&attr);
+  return t;
+}
+
+void hostoff_destroy(hostoff_team_t *t)
+{
+  int i;
+  if (t == NULL) return;
+  hostoff_wait(t);
+  t->stop = 1;
+  atomic_fetch_add_explicit(&t->generation.v, 1, memory_order_release);
+  for (i = 0; i < t->nthreads; i++)
+    pthread_join(t->threads[i], NULL);
+  free(t->cpus);
+  free(t->threads);
+  free(t);
+}
+
+void hostoff_launch(hostoff_team_t *t, hostoff_fn fn, void *arg)
+{
+  hostoff_wait(t);
+  t->fn = fn;
+  t->arg = arg;
+  t->pending = 1;
+  t->stats.launches++;
+  atomic_store_explicit(&t->done.v, 0, memory_order_relaxed);
+  atomic_fetch_add_explicit(&t->generation.v, 1, memory_order_release);
+}
+
+void hostoff_wait(hostoff_team_t *t)
+{
+  int k = 0;
+  if (!t->pending) return;
+  while (atomic_load_explicit(&t->done.v, memory_order_acquire) < t->nthreads) {
+    if (++k < t->spins)
+      cpu_relax();
+    else {
+      sched_yield();
+      k = 0;
+    }
+  }
+  t->pending = 0;
+}
+
+void hostoff_run(hostoff_team_t *t, hostoff_fn fn, void *arg)
+{
+  hostoff_launch(t, fn, arg);
+  hostoff_wait(t);
+}
+
+void *hostoff_map(hostoff_team_t *t, void *host, size_t bytes)
+{
+  t->stats.maps++;
+  t->stats.bytes += bytes;
+  return host;
+}
+
+/* counter barrier; "sense" counts the barriers passed by the team, the
+ * last thread to arrive increments it and releases the others */
+void hostoff_barrier(hostoff_team_t *t)
+{
+  long sense = atomic_load_explicit(&t->sense.v, memory_order_acquire);
+
+  if (atomic_fetch_add_explicit(&t->arrived.v, 1, memory_order_acq_rel)
+      == t->nthreads - 1) {
+    atomic_store_explicit(&t->arrived.v, 0, memory_order_relaxed);
+    atomic_store_explicit(&t->sense.v, sense + 1, memory_order_release);
+  } else
+    spin_while(&t->sense.v, sense, t->spins);
+}
+
+void hostoff_range(long n, int tid, int nthreads, long *lo, long *hi)
+{
+  long q = n / nthreads, r = n % nthreads;
+  *lo = tid * q + (tid < r ? tid : r);
+  *hi = *lo + q + (tid < r);
+}
+
+int hostoff_nthreads(const hostoff_team_t *t) { return t->nthreads; }
+int hostoff_node(const hostoff_team_t *t) { return t->node; }
+hostoff_stats_t hostoff_stats(const hostoff_team_t *t) { return t->stats; }
@@ -0,0 +1,56 @@
+/******************************************************************************
+* FILE: hostoff.h
+* DESCRIPTION:
+*   Host "offload device" for nodes without a GPU (implementation in
+*   hostoff.c).  On such nodes "#pragma omp target" in teste01.c falls
+*   back to the host: every target region starts a new parallel region
+*   on the cpus of the calling thread.  A hostoff team is instead a
+*   persistent set of threads pinned to the cpus of one NUMA node
+*   (by default a node other than the one of the caller), that waits
+*   for regions to run, as a device would:
+*
+*     hostoff_team_t *dev = hostoff_create(0, -1);
+*     double *y = hostoff_map(dev, y_host, n * sizeof(double));
+*     hostoff_run(dev, kernel, &args);    // kernel(&args, tid, nthreads)
+*     hostoff_destroy(dev);
+*
+*   The "map" of a buffer does not copy it: the device is the same memory,
+*   so hostoff_map() returns the host pointer and only counts the bytes
+*   that a copy would have moved.
+*   hostoff_launch() starts a region and returns (as "target nowait"),
+*   hostoff_wait() waits for it; hostoff_run() does both.  Inside a region
+*   hostoff_barrier() synchronizes the team and hostoff_range() gives each
+*   thread its block of a loop.
+*   The environment variable HOSTOFF_NODE overrides the node given to
+*   hostoff_create().
+******************************************************************************/
+#ifndef HOSTOFF_H
+#define HOSTOFF_H
+
+#include <stddef.h>
+
+typedef void (*hostoff_fn)(void *arg, int tid, int nthreads);
+typedef struct hostoff_team_s hostoff_team_t;
+
+typedef struct {
+  long   launches;            /* regions run */
+  long   maps;                /* hostoff_map() calls */
+  size_t bytes;               /* bytes that were not copied */
+} hostoff_stats_t;
+
+/* nthreads <= 0: one thread per cpu of the node; node < 0: choose one;
+   NULL if the node has no cpus or the threads cannot be started */
+extern hostoff_team_t *hostoff_create(int nthreads, int node);
+extern void            hostoff_destroy(hostoff_team_t *t);
+extern void            hostoff_launch(hostoff_team_t *t, hostoff_fn fn, void *arg);
+extern void            hostoff_wait(hostoff_team_t *t);
+extern void            hostoff_run(hostoff_team_t *t, hostoff_fn fn, void *arg);
+extern void           *hostoff_map(hostoff_team_t *t, void *host, size_t bytes);
+extern void            hostoff_barrier(hostoff_team_t *t);
+extern void            hostoff_range(long n, int tid, int nthreads,
+                                     long *lo, long *hi);
+extern int             hostoff_nthreads(const hostoff_team_t *t);
+extern int             hostoff_node(const hostoff_team_t *t);
+extern hostoff_stats_t hostoff_stats(const hostoff_team_t *t);
+
+#endif /* HOSTOFF_H */
@@ -0,0 +1,135 @@
+/******************************************************************************
+* FILE: offload_bench.c
+* OTHER FILES: hostoff.c hostoff.h
+* DESCRIPTION:
+*   Launch overhead of a region and time of a saxpy kernel run as:
+*     target   - "#pragma omp target teams distribute parallel for" with
+*                map clauses (on a node without a GPU the runtime runs
+*                it on the host, as it does teste01.c);
+*     parallel - "#pragma omp parallel for" on the host;
+*     hostoff  - the persistent pinned team of hostoff.c, with the arrays
+*                "mapped" by aliasing.
+*   The "empty" region, where only thread 0 touches a variable (a target
+*   parallel region, as in teste01.c), gives the cost of a launch alone;
+*   the saxpy of n elements shows what is left of it with real work.
+* USAGE:  offload_bench [n] [launches]
+* BUILD:  gcc -O2 -fopenmp -pthread -o offload_bench offload_bench.c hostoff.c
+******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+#include "hostoff.h"
+
+typedef struct {
+  long   n;
+  float  a;
+  float *x, *y;
+} saxpy_arg;
+
+static volatile int sink;       /* keeps the empty regions from vanishing */
+
+static void empty_kernel(void *arg, int tid, int nthreads)
+{
+  (void)arg; (void)nthreads;
+  if (tid == 0) sink++;
+}
+
+static void saxpy_kernel(void *p, int tid, int nthreads)
+{
+  saxpy_arg *s = p;
+  long i, lo, hi;
+  hostoff_range(s->n, tid, nthreads, &lo, &hi);
+  for (i = lo; i < hi; i++)
+    s->y[i] = s->a * s->x[i] + s->y[i];
+}
+
+int main(int argc, char *argv[])
+{
+  long n = 1 << 20, i;
+  int reps = 2000, r;
+  float *x, *y, a = 0.5f;
+  double t, check;
+  hostoff_team_t *dev;
+  hostoff_stats_t st;
+  saxpy_arg s;
+
+  if (argc >= 2) n = atol(argv[1]);
+  if (argc >= 3) reps = atoi(argv[2]);
+  x = malloc(n * sizeof(float));
+  y = malloc(n * sizeof(float));
+  for (i = 0; i < n; i++) {
+    x[i] = 1.0f;
+    y[i] = 0.0f;
+  }
+
+  dev = hostoff_create(0, -1);
+  if (dev == NULL) return 1;
+  printf("devices: %d, host team: %d threads on node %d, host threads: %d\n",
+         omp_get_num_devices(), hostoff_nthreads(dev), hostoff_node(dev),
+         omp_get_max_threads());
+  printf("%d launches, saxpy of %ld elements, microseconds per region\n\n",
+         reps, n);
+  printf("%-10s %10s %10s\n", "mode", "empty", "saxpy");
+
+  /* target */
+  printf("%-10s", "target");
+  t = omp_get_wtime();
+  for (r = 0; r < reps; r++) {
+    #pragma omp target parallel
+    { if (omp_get_thread_num() == 0) sink++; }
+  }
+  printf(" %10.2f", (omp_get_wtime() - t) / reps * 1e6);
+  t = omp_get_wtime();
+  for (r = 0; r < reps; r++) {
+    #pragma omp target teams distribute parallel for map(to: x[0:n]) map(tofrom: y[0:n])
+    for (i = 0; i < n; i++)
+      y[i] = a * x[i] + y[i];
+  }
+  printf(" %10.2f\n", (omp_get_wtime() - t) / reps * 1e6);
+
+  /* parallel */
+  printf("%-10s", "parallel");
+  t = omp_get_wtime();
+  for (r = 0; r < reps; r++) {
+    #pragma omp parallel
+    { if (omp_get_thread_num() == 0) sink++; }
+  }
+  printf(" %10.2f", (omp_get_wtime() - t) / reps * 1e6);
+  t = omp_get_wtime();
+  for (r = 0; r < reps; r++) {
+    #pragma omp parallel for
+    for (i = 0; i < n; i++)
+      y[i] = a * x[i] + y[i];
+  }
+  printf(" %10.2f\n", (omp_get_wtime() - t) / reps * 1e6);
+
+  /* hostoff */
+  printf("%-10s", "hostoff");
+  t = omp_get_wtime();
+  for (r = 0; r < reps; r++)
+    hostoff_run(dev, empty_kernel, NULL);
+  printf(" %10.2f", (omp_get_wtime() - t) / reps * 1e6);
+  s.n = n;
+  s.a = a;
+  t = omp_get_wtime();
+  for (r = 0; r < reps; r++) {
+    s.x = hostoff_map(dev, x, n * sizeof(float));
+    s.y = hostoff_map(dev, y, n * sizeof(float));
+    hostoff_run(dev, saxpy_kernel, &s);
+  }
+  printf(" %10.2f\n", (omp_get_wtime() - t) / reps * 1e6);
+
+  st = hostoff_stats(dev);
+  printf("\nhostoff: %ld regions, %ld maps, %.1f MB not copied\n",
+         st.launches, st.maps, st.bytes / 1e6);
+
+  /* each saxpy added a to every y[i] */
+  check = 0;
+  for (i = 0; i < n; i++)
+    check += y[i] - 3.0 * reps * a;
+  printf("check (should be 0): %g\n", check);
+
+  hostoff_destroy(dev);
+  free(x); free(y);
+  return check != 0;
+}
@@ -91,10 +91,13 @@ endif
 # CONFIG_PFMLIB_DEBUG: enable debugging output support
 # CONFIG_PFMLIB_NOPYTHON: do not generate the python support, incompatible
 # with PFMLIB_SHARED=n
+# CONFIG_PFMLIB_EVENT_HASH: generate the event name hashes at build time, the
+# generator runs on the build host, say n when cross-compiling
 #
 CONFIG_PFMLIB_SHARED?=y
 CONFIG_PFMLIB_DEBUG?=y
 CONFIG_PFMLIB_NOPYTHON?=y
+CONFIG_PFMLIB_EVENT_HASH?=y
 
 #
 # Cell Broadband Engine is reported as PPC but needs special handling.
@@ -30,10 +30,14 @@
 #include <stdlib.h>
 #include <stdarg.h>
 #include <string.h>
+#include <unistd.h>
 #include <perfmon/err.h>
 
 #include <perfmon/pfmlib.h>
 
+static int json;	/* JSON output */
+static int nchecked;	/* events printed so far */
+
 int
 pmu_is_present(pfm_pmu_t p)
 {
@@ -45,28 +49,46 @@ pmu_is_present(pfm_pmu_t p)
 	return ret == PFM_SUCCESS ? pinfo.is_present : 0;
 }
 
-int
-main(int argc, const char **argv)
+static void
+json_str(const char *s)
+{
+	putchar('"');
+	for (; s && *s; s++) {
+		if (*s == '"' || *s == '\\')
+			printf("\\%c", *s);
+		else if ((unsigned char)*s < 0x20)
+			printf("\\u%04x", *s);
+		else
+			putchar(*s);
+	}
+	putchar('"');
+}
+
+static void
+show_pmus(void)
 {
 	pfm_pmu_info_t pinfo;
-	pfm_pmu_encode_arg_t e;
-	const char *arg[3];
-	const char **p;
-	char *fqstr;
-	pfm_event_info_t info;
-	int i, j, ret;
+	int i, ret, n = 0;
 	int total_supported_events = 0;
 	int total_available_events = 0;
 
-	/*
-	 * Initialize pfm library (required before we can use it)
-	 */
-	ret = pfm_initialize();
-	if (ret != PFM_SUCCESS)
-		errx(1, "cannot initialize library: %s\n", pfm_strerror(ret));
-
 	memset(&pinfo, 0, sizeof(pinfo));
-	memset(&info, 0, sizeof(info));
+
+	if (json) {
+		printf("{\"pmus\": [");
+		for(i=0; i < PFM_PMU_MAX; i++) {
+			ret = pfm_get_pmu_info(i, &pinfo);
+			if (ret != PFM_SUCCESS)
+				continue;
+			printf("%s\n{\"id\": %d, \"name\": ", n++ ? "," : "", i);
+			json_str(pinfo.name);
+			printf(", \"desc\": ");
+			json_str(pinfo.desc);
+			printf(", \"present\": %s, \"nevents\": %d}", pinfo.is_present ? "true" : "false", pinfo.nevents);
+		}
+		printf("\n],\n\"events\": [");
+		return;
+	}
 
 	printf("Supported PMU models:\n");
 	for(i=0; i < PFM_PMU_MAX; i++) {
@@ -90,71 +112,203 @@ main(int argc, const char **argv)
 	}
 
 	printf("Total events: %d available, %d supported\n", total_available_events, total_supported_events);
+}
+
+/*
+ * encode and print one event, e keeps the codes array across calls
+ */
+static void
+check_event(const char *str, pfm_pmu_encode_arg_t *e)
+{
+	pfm_pmu_info_t pinfo;
+	pfm_event_info_t info;
+	char *fqstr;
+	int j, ret;
+
+	memset(&pinfo, 0, sizeof(pinfo));
+	memset(&info, 0, sizeof(info));
+
+	/*
+	 * extract raw event encoding
+	 *
+	 * For perf_event encoding, use
+	 * #include <perfmon/pfmlib_perf_event.h>
+	 * and the function:
+	 * pfm_get_perf_event_encoding()
+	 */
+	for (;;) {
+		fqstr = NULL;
+		e->fstr = &fqstr;
+		ret = pfm_get_os_event_encoding(str, PFM_PLM0|PFM_PLM3, PFM_OS_NONE, e);
+		if (ret != PFM_ERR_TOOSMALL)
+			break;
+		/*
+		 * codes is too small for this event
+		 * free and let the library resize
+		 */
+		free(e->codes);
+		e->codes = NULL;
+		e->count = 0;
+		free(fqstr);
+	}
+	if (ret != PFM_SUCCESS) {
+		if (ret == PFM_ERR_NOTFOUND && strstr(str, "::"))
+			errx(1, "%s: try setting LIBPFM_ENCODE_INACTIVE=1", pfm_strerror(ret));
+		errx(1, "cannot encode event %s: %s", str, pfm_strerror(ret));
+	}
+	ret = pfm_get_event_info(e->idx, PFM_OS_NONE, &info);
+	if (ret != PFM_SUCCESS)
+		errx(1, "cannot get event info: %s", pfm_strerror(ret));
+
+	ret = pfm_get_pmu_info(info.pmu, &pinfo);
+	if (ret != PFM_SUCCESS)
+		errx(1, "cannot get PMU info: %s", pfm_strerror(ret));
+
+	if (json) {
+		printf("%s\n{\"requested\": ", nchecked ? "," : "");
+		json_str(str);
+		printf(", \"actual\": ");
+		json_str(fqstr);
+		printf(", \"pmu\": ");
+		json_str(pinfo.name);
+		printf(", \"idx\": %d, \"codes\": [", e->idx);
+		for(j=0; j < e->count; j++)
+			printf("%s\"0x%"PRIx64"\"", j ? ", " : "", e->codes[j]);
+		printf("]}");
+	} else {
+		printf("Requested Event: %s\n", str);
+		printf("Actual    Event: %s\n", fqstr);
+		printf("PMU            : %s\n", pinfo.desc);
+		printf("IDX            : %d\n", e->idx);
+		printf("Codes          :");
+		for(j=0; j < e->count; j++)
+			printf(" 0x%"PRIx64, e->codes[j]);
+		putchar('\n');
+	}
+	nchecked++;
+
+	free(fqstr);
+}
+
+/*
+ * all valid unit mask combinations of the events matching regex
+ */
+static void
+check_all(const char *regex, int max_umasks, pfm_pmu_encode_arg_t *e)
+{
+	pfm_event_iter_arg_t arg;
+	pfm_event_iter_info_t info;
+	pfm_event_iter_t *iter;
+	int ret, n = nchecked;
+
+	memset(&arg, 0, sizeof(arg));
+	memset(&info, 0, sizeof(info));
+
+	arg.size = sizeof(arg);
+	info.size = sizeof(info);
+
+	arg.pattern = regex;
+	arg.max_umasks = max_umasks;
+	arg.flags = PFM_ITER_COMBOS;
+
+	/* with a pmu prefix, include undetected PMU models */
+	if (strstr(regex, "::"))
+		arg.flags |= PFM_ITER_INACTIVE;
+
+	ret = pfm_event_iter_create(&arg, &iter);
+	if (ret == PFM_ERR_NOTSUPP)
+		errx(1, "%s: try setting LIBPFM_ENCODE_INACTIVE=1", pfm_strerror(ret));
+	if (ret != PFM_SUCCESS)
+		errx(1, "cannot enumerate events %s: %s", regex, pfm_strerror(ret));
+
+	while ((ret = pfm_event_iter_next(iter, &info)) == PFM_SUCCESS)
+		check_event(info.str, e);
+
+	if (ret != PFM_ERR_NOTFOUND)
+		errx(1, "cannot enumerate events %s: %s", regex, pfm_strerror(ret));
+
+	pfm_event_iter_destroy(iter);
+
+	if (n == nchecked)
+		errx(1, "no event matches %s%s", regex,
+		     strstr(regex, "::") ? ", try setting LIBPFM_ENCODE_INACTIVE=1" : "");
+}
+
+static void
+usage(void)
+{
+	printf("check_events [-h] [-j] [-a regex] [-l n] [event ...]\n"
+		"-h\t\tget help\n"
+		"-j\t\tJSON output\n"
+		"-a regex\tcheck all valid unit mask combinations of the matching events\n"
+		"-l n\t\tmaximum number of unit masks per combination with -a, 0 for no limit (default: 2)\n"
+		"\t\tevents with more than 18 unit masks are combined at most 4 at a time\n");
+}
+
+int
+main(int argc, char **argv)
+{
+	pfm_pmu_encode_arg_t e;
+	const char *arg[3];
+	const char **p;
+	char *all = NULL;
+	int c, ret, max_umasks = 2;
+
+	while ((c = getopt(argc, argv, "hja:l:")) != -1) {
+		switch (c) {
+		case 'j':
+			json = 1;
+			break;
+		case 'a':
+			all = optarg;
+			break;
+		case 'l':
+			max_umasks = atoi(optarg);
+			break;
+		case 'h':
+			usage();
+			exit(0);
+		default:
+			usage();
+			exit(1);
+		}
+	}
+
+	/*
+	 * Initialize pfm library (required before we can use it)
+	 */
+	ret = pfm_initialize();
+	if (ret != PFM_SUCCESS)
+		errx(1, "cannot initialize library: %s\n", pfm_strerror(ret));
+
+	show_pmus();
 
 	/*
 	 * be nice to user!
 	 */
-	if (argc < 2  && pmu_is_present(PFM_PMU_PERF_EVENT)) {
+	if (optind == argc && !all && pmu_is_present(PFM_PMU_PERF_EVENT)) {
 		arg[0] = "PERF_COUNT_HW_CPU_CYCLES";
 		arg[1] = "PERF_COUNT_HW_INSTRUCTIONS";
 		arg[2] = NULL;
 		p = arg;
 	} else {
-		p = argv+1;
+		p = (const char **)argv + optind;
 	}
 
-	if (!*p)
+	if (!*p && !all)
 		errx(1, "you must pass at least one event");
 
 	memset(&e, 0, sizeof(e));
 	while(*p) {
-		/*
-		 * extract raw event encoding
-		 *
-		 * For perf_event encoding, use
-		 * #include <perfmon/pfmlib_perf_event.h>
-		 * and the function:
-		 * pfm_get_perf_event_encoding()
-		 */
-		fqstr = NULL;
-		e.fstr = &fqstr;
-		ret = pfm_get_os_event_encoding(*p, PFM_PLM0|PFM_PLM3, PFM_OS_NONE, &e);
-		if (ret != PFM_SUCCESS) {
-			/*
-			 * codes is too small for this event
-			 * free and let the library resize
-			 */
-			if (ret == PFM_ERR_TOOSMALL) {
-				free(e.codes);
-				e.codes = NULL;
-				e.count = 0;
-				free(fqstr);
-				continue;
-			}
-			if (ret == PFM_ERR_NOTFOUND && strstr(*p, "::"))
-				errx(1, "%s: try setting LIBPFM_ENCODE_INACTIVE=1", pfm_strerror(ret));
-			errx(1, "cannot encode event %s: %s", *p, pfm_strerror(ret));
-		}
-		ret = pfm_get_event_info(e.idx, PFM_OS_NONE, &info);
-		if (ret != PFM_SUCCESS)
-			errx(1, "cannot get event info: %s", pfm_strerror(ret));
-
-		ret = pfm_get_pmu_info(info.pmu, &pinfo);
-		if (ret != PFM_SUCCESS)
-			errx(1, "cannot get PMU info: %s", pfm_strerror(ret));
-
-		printf("Requested Event: %s\n", *p);
-		printf("Actual    Event: %s\n", fqstr);
-		printf("PMU            : %s\n", pinfo.desc);
-		printf("IDX            : %d\n", e.idx);
-		printf("Codes          :");
-		for(j=0; j < e.count; j++)
-			printf(" 0x%"PRIx64, e.codes[j]);
-		putchar('\n');
-
-		free(fqstr);
+		check_event(*p, &e);
 		p++;
 	}
+	if (all)
+		check_all(all, max_umasks, &e);
+
+	if (json)
+		printf("\n]}\n");
+
 	if (e.codes)
 		free(e.codes);
 	return 0;
@@ -37,8 +37,7 @@
 
 #include <perfmon/pfmlib.h>
 
-#define MAXBUF		1024
-#define COMBO_MAX	18
+#define COMBO_MAX	4
 
 static struct {
 	int compact;
@@ -47,6 +46,7 @@ static struct {
 	int combo;
 	int combo_lim;
 	int desc;
+	int json;
 	char *csv_sep;
 	pfm_event_info_t efilter;
 	pfm_event_attr_info_t ufilter;
@@ -59,7 +59,7 @@ typedef struct {
 	int idx;
 } code_info_t;
 
-static void show_event_info_compact(pfm_event_info_t *info);
+static int json_first = 1;
 
 static const char *srcs[PFM_ATTR_CTRL_MAX]={
 	[PFM_ATTR_CTRL_UNKNOWN] = "???",
@@ -103,37 +103,47 @@ event_has_pname(char *s)
 	return (p = strchr(s, ':')) && *(p+1) == ':';
 }
 
-static int
-print_codes(char *buf, int plm, int max_encoding)
+static void
+json_str(const char *s)
 {
-	uint64_t *codes = NULL;
-	int j, ret, count = 0;
-
-	ret = pfm_get_event_encoding(buf, PFM_PLM0|PFM_PLM3, NULL, NULL, &codes, &count);
-	if (ret != PFM_SUCCESS) {
-		if (ret == PFM_ERR_NOTFOUND)
-			errx(1, "encoding failed, try setting env variable LIBPFM_ENCODE_INACTIVE=1");
-		return -1;
-	}
-	for(j = 0; j < max_encoding; j++) {
-		if (j < count)
-			printf("0x%"PRIx64, codes[j]);
-		printf("%s", options.csv_sep);
+	putchar('"');
+	for (; s && *s; s++) {
+		if (*s == '"' || *s == '\\')
+			printf("\\%c", *s);
+		else if ((unsigned char)*s < 0x20)
+			printf("\\u%04x", *s);
+		else
+			putchar(*s);
 	}
-	free(codes);
-	return 0;
+	putchar('"');
+}
+
+/*
+ * separator before each element of a JSON array
+ */
+static void
+json_next(void)
+{
+	if (!json_first)
+		putchar(',');
+	json_first = 0;
+	putchar('\n');
 }
 
 static int
-check_valid(char *buf, int plm)
+get_codes(const char *buf, uint64_t **codes, int *count)
 {
-	uint64_t *codes = NULL;
-	int ret, count = 0;
+	int ret;
 
-	ret = pfm_get_event_encoding(buf, PFM_PLM0|PFM_PLM3, NULL, NULL, &codes, &count);
-	if (ret != PFM_SUCCESS)
+	*codes = NULL;
+	*count = 0;
+
+	ret = pfm_get_event_encoding(buf, PFM_PLM0|PFM_PLM3, NULL, NULL, codes, count);
+	if (ret != PFM_SUCCESS) {
+		if (ret == PFM_ERR_NOTFOUND)
+			errx(1, "encoding failed, try setting env variable LIBPFM_ENCODE_INACTIVE=1");
 		return -1;
-	free(codes);
+	}
 	return 0;
 }
 
@@ -187,122 +197,134 @@ match_efilters(pfm_event_info_t *info)
 	return n ? 0 : 1;
 }
 
+/*
+ * one line (or JSON object) per event string: pmu::event[:umask...]
+ */
 static void
-show_event_info_combo(pfm_event_info_t *info)
+show_entry(const pfm_event_iter_info_t *e)
 {
-	pfm_event_attr_info_t *ainfo;
+	pfm_event_attr_info_t ainfo;
+	pfm_event_info_t info;
 	pfm_pmu_info_t pinfo;
-	char buf[MAXBUF];
-	size_t len;
-	int numasks = 0;
-	int i, j, ret;
-	uint64_t total, m, u;
+	uint64_t *codes = NULL;
+	int i, ret, count = 0;
 
+	memset(&info, 0, sizeof(info));
 	memset(&pinfo, 0, sizeof(pinfo));
+	memset(&ainfo, 0, sizeof(ainfo));
 
+	info.size = sizeof(info);
 	pinfo.size = sizeof(pinfo);
+	ainfo.size = sizeof(ainfo);
 
-	ret = pfm_get_pmu_info(info->pmu, &pinfo);
+	ret = pfm_get_event_info(e->idx, options.os, &info);
 	if (ret != PFM_SUCCESS)
-		errx(1, "cannot get PMU info");
-
-	ainfo = calloc(info->nattrs, sizeof(*ainfo));
-	if (!ainfo)
-		err(1, "event %s : ", info->name);
-
-	/*
-	 * extract attribute information and count number
-	 * of umasks
-	 *
-	 * we cannot just drop non umasks because we need
-	 * to keep attributes in order for the enumeration
-	 * of 2^n
-	 */
-	pfm_for_each_event_attr(i, info) {
-		ainfo[i].size = sizeof(*ainfo);
+		errx(1, "cannot get event info: %s", pfm_strerror(ret));
 
-		ret = pfm_get_event_attr_info(info->idx, i, options.os, &ainfo[i]);
+	ret = pfm_get_pmu_info(info.pmu, &pinfo);
+	if (ret != PFM_SUCCESS)
+		errx(1, "cannot get pmu info: %s", pfm_strerror(ret));
+
+	if (e->numasks == 0 && !match_efilters(&info))
+		return;
+
+	if (e->numasks == 1) {
+		ret = pfm_get_event_attr_info(e->idx, e->umasks[0], options.os, &ainfo);
 		if (ret != PFM_SUCCESS)
 			errx(1, "cannot get attribute info: %s", pfm_strerror(ret));
-
-		if (ainfo[i].type == PFM_ATTR_UMASK)
-			numasks++;
+		if (!match_ufilters(&ainfo))
+			return;
 	}
-	if (numasks > options.combo_lim) {
-		warnx("event %s has too many umasks to print all combinations, dropping to simple enumeration", info->name);
-		free(ainfo);
-		show_event_info_compact(info);
+
+	if (options.encode && get_codes(e->str, &codes, &count))
 		return;
-	}
 
-	if (numasks) {
-		if (info->nattrs > (int)((sizeof(total)<<3))) {
-			warnx("too many umasks, cannot show all combinations for event %s", info->name);
-			goto end;
+	if (options.json) {
+		json_next();
+		printf("{\"name\": ");
+		json_str(e->str);
+		printf(", \"pmu\": ");
+		json_str(pinfo.name);
+		printf(", \"event\": ");
+		json_str(info.name);
+		printf(", \"idx\": %d, \"umasks\": [", e->idx);
+		for (i = 0; i < e->numasks; i++) {
+			ret = pfm_get_event_attr_info(e->idx, e->umasks[i], options.os, &ainfo);
+			if (ret != PFM_SUCCESS)
+				errx(1, "cannot get attribute info: %s", pfm_strerror(ret));
+			printf("%s", i ? ", " : "");
+			json_str(ainfo.name);
 		}
-		total = 1ULL << info->nattrs;
-
-		for (u = 1; u < total; u++) {
-			len = sizeof(buf);
-			len -= snprintf(buf, len, "%s::%s", pinfo.name, info->name);
-			if (len <= 0) {
-				warnx("event name too long%s", info->name);
-				goto end;
-			}
-			for(m = u, j = 0; m; m >>=1, j++) {
-				if (m & 0x1ULL) {
-					/* we have hit a non umasks attribute, skip */
-					if (ainfo[j].type != PFM_ATTR_UMASK)
-						break;
-
-					if (len < (1 + strlen(ainfo[j].name))) {
-						warnx("umasks combination too long for event %s", buf);
-						break;
-					}
-					strncat(buf, ":", len-1);buf[len-1] = '\0'; len--;
-					strncat(buf, ainfo[j].name, len-1);buf[len-1] = '\0';
-					len -= strlen(ainfo[j].name);
-				}
-			}
-			/* if found a valid umask combination, check encoding */
-			if (m == 0) {
-				if (options.encode)
-					ret = print_codes(buf, PFM_PLM0|PFM_PLM3, pinfo.max_encoding);
-				else
-					ret = check_valid(buf, PFM_PLM0|PFM_PLM3);
-				if (!ret)
-					printf("%s\n", buf);
+		putchar(']');
+		if (options.encode) {
+			printf(", \"codes\": [");
+			for (i = 0; i < count; i++)
+				printf("%s\"0x%"PRIx64"\"", i ? ", " : "", codes[i]);
+			putchar(']');
+		}
+		if (options.desc) {
+			printf(", \"desc\": ");
+			json_str(info.desc);
+			printf(", \"umask_desc\": [");
+			for (i = 0; i < e->numasks; i++) {
+				pfm_get_event_attr_info(e->idx, e->umasks[i], options.os, &ainfo);
+				printf("%s", i ? ", " : "");
+				json_str(ainfo.desc);
 			}
+			putchar(']');
 		}
-	} else {
-		snprintf(buf, sizeof(buf)-1, "%s::%s", pinfo.name, info->name);
-		buf[sizeof(buf)-1] = '\0';
+		putchar('}');
+		free(codes);
+		return;
+	}
 
-		ret = options.encode ? print_codes(buf, PFM_PLM0|PFM_PLM3, pinfo.max_encoding) : 0;
-		if (!ret)
-			printf("%s\n", buf);
+	if (options.encode) {
+		for (i = 0; i < pinfo.max_encoding; i++) {
+			if (i < count)
+				printf("0x%"PRIx64, codes[i]);
+			printf("%s", options.csv_sep);
+		}
 	}
-end:
-	free(ainfo);
+	printf("%s", e->str);
+
+	if (options.desc) {
+		printf("%s\"%s.", options.csv_sep, info.desc);
+		for (i = 0; i < e->numasks; i++) {
+			if (pfm_get_event_attr_info(e->idx, e->umasks[i], options.os, &ainfo) == PFM_SUCCESS)
+				printf(" %s.", ainfo.desc);
+		}
+		putchar('"');
+	}
+	putchar('\n');
+
+	free(codes);
 }
 
+/*
+ * one entry per unit mask, or the event if it has none
+ */
 static void
-show_event_info_compact(pfm_event_info_t *info)
+show_event_umasks(pfm_event_info_t *info, const char *pname)
 {
 	pfm_event_attr_info_t ainfo;
-	pfm_pmu_info_t pinfo;
-	char buf[MAXBUF];
-	int i, ret, um = 0;
+	pfm_event_iter_info_t e;
+	char *buf;
+	size_t len;
+	int i, ret;
 
 	memset(&ainfo, 0, sizeof(ainfo));
-	memset(&pinfo, 0, sizeof(pinfo));
+	memset(&e, 0, sizeof(e));
 
-	pinfo.size = sizeof(pinfo);
 	ainfo.size = sizeof(ainfo);
 
-	ret = pfm_get_pmu_info(info->pmu, &pinfo);
-	if (ret != PFM_SUCCESS)
-		errx(1, "cannot get pmu info: %s", pfm_strerror(ret));
+	buf = malloc(strlen(pname) + 2 + strlen(info->name) + 1);
+	if (!buf)
+		err(1, "cannot allocate memory");
+
+	len = sprintf(buf, "%s::%s", pname, info->name);
+
+	e.str = buf;
+	e.idx = info->idx;
 
 	pfm_for_each_event_attr(i, info) {
 		ret = pfm_get_event_attr_info(info->idx, i, options.os, &ainfo);
@@ -312,44 +334,21 @@ show_event_info_compact(pfm_event_info_t *info)
 		if (ainfo.type != PFM_ATTR_UMASK)
 			continue;
 
-		if (!match_ufilters(&ainfo))
-			continue;
-
-		snprintf(buf, sizeof(buf)-1, "%s::%s:%s", pinfo.name, info->name, ainfo.name);
-		buf[sizeof(buf)-1] = '\0';
+		buf = realloc(buf, len + 1 + strlen(ainfo.name) + 1);
+		if (!buf)
+			err(1, "cannot allocate memory");
+		sprintf(buf + len, ":%s", ainfo.name);
 
-		ret = 0;
-		if (options.encode) {
-			ret = print_codes(buf, PFM_PLM0|PFM_PLM3, pinfo.max_encoding);
-		}
-		if (!ret) {
-			printf("%s", buf);
-			if (options.desc) {
-				printf("%s", options.csv_sep);
-				printf("\"%s. %s.\"", info->desc, ainfo.desc);
-			}
-			putchar('\n');
-		}
-		um++;
+		e.str = buf;
+		e.umasks = &i;
+		e.numasks = 1;
+		show_entry(&e);
 	}
-	if (um == 0) {
-		if (!match_efilters(info))
-			return;
-
-		snprintf(buf, sizeof(buf)-1, "%s::%s", pinfo.name, info->name);
-		buf[sizeof(buf)-1] = '\0';
-		if (options.encode) {
-			ret = print_codes(buf, PFM_PLM0|PFM_PLM3, pinfo.max_encoding);
-			if (ret)
-				return;
-		}
-		printf("%s", buf);
-		if (options.desc) {
-			printf("%s", options.csv_sep);
-			printf("\"%s.\"", info->desc);
-		}
-		putchar('\n');
+	if (!e.numasks) {
+		e.str = buf;
+		show_entry(&e);
 	}
+	free(buf);
 }
 
 int compare_codes(const void *a, const void *b)
@@ -485,65 +484,128 @@ show_event_info(pfm_event_info_t *info)
 }
 
 
-static int
-show_info(char *event, regex_t *preg)
+static void
+show_event_info_json(pfm_event_info_t *info)
 {
+	static const char *types[PFM_ATTR_MAX]={
+		[PFM_ATTR_NONE] = "none",
+		[PFM_ATTR_UMASK] = "umask",
+		[PFM_ATTR_MOD_BOOL] = "modifier_bool",
+		[PFM_ATTR_MOD_INTEGER] = "modifier_int",
+		[PFM_ATTR_RAW_UMASK] = "raw_umask",
+	};
+	pfm_event_attr_info_t ainfo;
 	pfm_pmu_info_t pinfo;
-	pfm_event_info_t info;
-	int i, j, ret, match = 0, pname;
-	size_t len, l = 0;
-	char *fullname = NULL;
+	int i, n = 0, ret;
 
+	memset(&ainfo, 0, sizeof(ainfo));
 	memset(&pinfo, 0, sizeof(pinfo));
-	memset(&info, 0, sizeof(info));
 
 	pinfo.size = sizeof(pinfo);
-	info.size = sizeof(info);
+	ainfo.size = sizeof(ainfo);
 
-	pname = event_has_pname(event);
+	if (!match_efilters(info))
+		return;
+	ret = pfm_get_pmu_info(info->pmu, &pinfo);
+	if (ret)
+		errx(1, "cannot get pmu info: %s", pfm_strerror(ret));
 
-	/*
-	 * scan all supported events, incl. those
-	 * from undetected PMU models
-	 */
-	pfm_for_all_pmus(j) {
+	json_next();
+	printf("{\"idx\": %d, \"pmu\": ", info->idx);
+	json_str(pinfo.name);
+	printf(", \"name\": ");
+	json_str(info->name);
+	printf(", \"equiv\": ");
+	if (info->equiv)
+		json_str(info->equiv);
+	else
+		printf("null");
+	printf(", \"precise\": %s, \"desc\": ", info->is_precise ? "true" : "false");
+	json_str(info->desc ? info->desc : "");
+	printf(", \"code\": \"0x%"PRIx64"\", \"attrs\": [", info->code);
 
-		ret = pfm_get_pmu_info(j, &pinfo);
+	pfm_for_each_event_attr(i, info) {
+		ret = pfm_get_event_attr_info(info->idx, i, options.os, &ainfo);
 		if (ret != PFM_SUCCESS)
-			continue;
+			errx(1, "cannot retrieve event %s attribute info: %s", info->name, pfm_strerror(ret));
 
-		/* no pmu prefix, just look for detected PMU models */
-		if (!pname && !pinfo.is_present)
+		if (ainfo.type == PFM_ATTR_UMASK && !match_ufilters(&ainfo))
 			continue;
 
-		for (i = pinfo.first_event; i != -1; i = pfm_get_event_next(i)) {
-			ret = pfm_get_event_info(i, options.os, &info);
-			if (ret != PFM_SUCCESS)
-				errx(1, "cannot get event info: %s", pfm_strerror(ret));
+		if (ainfo.ctrl >= PFM_ATTR_CTRL_MAX)
+			ainfo.ctrl = PFM_ATTR_CTRL_UNKNOWN;
+		if (ainfo.type >= PFM_ATTR_MAX)
+			ainfo.type = PFM_ATTR_NONE;
+
+		printf("%s\n  {\"type\": \"%s\", \"name\": ", n++ ? "," : "", types[ainfo.type]);
+		json_str(ainfo.name);
+		printf(", \"code\": \"0x%"PRIx64"\", \"src\": \"%s\", \"default\": %s, \"precise\": %s, \"equiv\": ",
+		       ainfo.code,
+		       srcs[ainfo.ctrl],
+		       ainfo.is_dfl ? "true" : "false",
+		       ainfo.is_precise ? "true" : "false");
+		if (ainfo.equiv)
+			json_str(ainfo.equiv);
+		else
+			printf("null");
+		printf(", \"desc\": ");
+		json_str(ainfo.desc ? ainfo.desc : "");
+		putchar('}');
+	}
+	printf("]}");
+}
 
-			len = strlen(info.name) + strlen(pinfo.name) + 1 + 2;
-			if (len > l) {
-				l = len;
-				fullname = realloc(fullname, l);
-				if (!fullname)
-					err(1, "cannot allocate memory");
-			}
-			sprintf(fullname, "%s::%s", pinfo.name, info.name);
+static int
+show_info(char *event)
+{
+	pfm_event_iter_arg_t arg;
+	pfm_event_iter_info_t e;
+	pfm_event_info_t info;
+	pfm_event_iter_t *iter;
+	int ret, match = 0;
 
-			if (regexec(preg, fullname, 0, NULL, 0) == 0) {
-				if (options.compact)
-					if (options.combo)
-						show_event_info_combo(&info);
-					else
-						show_event_info_compact(&info);
-				else
-					show_event_info(&info);
-				match++;
-			}
+	memset(&arg, 0, sizeof(arg));
+	memset(&e, 0, sizeof(e));
+	memset(&info, 0, sizeof(info));
+
+	arg.size = sizeof(arg);
+	e.size = sizeof(e);
+	info.size = sizeof(info);
+
+	arg.pattern = event;
+	arg.max_umasks = options.combo_lim;
+
+	/* with a pmu prefix, include undetected PMU models */
+	if (event_has_pname(event))
+		arg.flags |= PFM_ITER_INACTIVE;
+
+	if (options.compact)
+		arg.flags |= options.combo ? PFM_ITER_COMBOS : PFM_ITER_UMASKS;
+
+	ret = pfm_event_iter_create(&arg, &iter);
+	if (ret == PFM_ERR_INVAL)
+		errx(1, "error in regular expression for event \"%s\"", event);
+	if (ret != PFM_SUCCESS)
+		errx(1, "cannot enumerate events: %s", pfm_strerror(ret));
+
+	while ((ret = pfm_event_iter_next(iter, &e)) == PFM_SUCCESS) {
+		if (options.compact) {
+			show_entry(&e);
+		} else {
+			ret = pfm_get_event_info(e.idx, options.os, &info);
+			if (ret != PFM_SUCCESS)
+				errx(1, "cannot get event info: %s", pfm_strerror(ret));
+			if (options.json)
+				show_event_info_json(&info);
+			else
+				show_event_info(&info);
 		}
+		match++;
 	}
-	if (fullname)
-		free(fullname);
+	if (ret != PFM_ERR_NOTFOUND)
+		errx(1, "cannot enumerate events: %s", pfm_strerror(ret));
+
+	pfm_event_iter_destroy(iter);
 
 	return match;
 }
@@ -607,7 +669,9 @@ show_info_sorted(char *event, regex_t *preg)
 
 			if (regexec(preg, fullname, 0, NULL, 0) == 0) {
 				if (options.compact)
-					show_event_info_compact(&info);
+					show_event_umasks(&info, pinfo.name);
+				else if (options.json)
+					show_event_info_json(&info);
 				else
 					show_event_info(&info);
 				match++;
@@ -624,18 +688,21 @@ show_info_sorted(char *event, regex_t *preg)
 	static void
 usage(void)
 {
-	printf("showevtinfo [-L] [-E] [-h] [-s] [-m mask]\n"
+	printf("showevtinfo [-L] [-E] [-M] [-j] [-h] [-s] [-m mask] [-X file]\n"
 			"-L\t\tlist one event per line (compact mode)\n"
 			"-E\t\tlist one event per line with encoding (compact mode)\n"
 			"-M\t\tdisplay all valid unit masks combination (use with -L or -E)\n"
+			"-j\t\tJSON output\n"
 			"-h\t\tget help\n"
 			"-s\t\tsort event by PMU and by code based on -m mask\n"
-			"-l\t\tmaximum number of umasks to list all combinations (default: %d)\n"
+			"-l n\t\tmaximum number of umasks per combination with -M, 0 for no limit (default: %d)\n"
+			"\t\tevents with more than 18 umasks are combined at most 4 at a time\n"
 			"-F\t\tshow only events and attributes with certain flags (precise,...)\n"
 			"-m mask\t\thexadecimal event code mask, bits to match when sorting\n"
 			"-x sep\t\tuse sep as field separator in compact mode\n"
 			"-D\t\t\tprint event description in compact mode\n"
-			"-O os\t\tshow attributes for the specific operating system\n",
+			"-O os\t\tshow attributes for the specific operating system\n"
+			"-X file\t\texport the event database of the detected PMUs to file (see LIBPFM_EVENT_DB)\n",
 			COMBO_MAX);
 }
 
@@ -739,6 +806,39 @@ static const char *pmu_types[]={
 	"OS generic",
 };
 
+static void
+show_pmus_json(void)
+{
+	pfm_pmu_info_t pinfo;
+	int i, ret, n = 0;
+
+	memset(&pinfo, 0, sizeof(pinfo));
+	pinfo.size = sizeof(pinfo);
+
+	printf("\"pmus\": [");
+	pfm_for_all_pmus(i) {
+		ret = pfm_get_pmu_info(i, &pinfo);
+		if (ret != PFM_SUCCESS)
+			continue;
+
+		if (pinfo.type >= PFM_PMU_TYPE_MAX)
+			pinfo.type = PFM_PMU_TYPE_UNKNOWN;
+
+		printf("%s\n{\"id\": %d, \"name\": ", n++ ? "," : "", i);
+		json_str(pinfo.name);
+		printf(", \"desc\": ");
+		json_str(pinfo.desc);
+		printf(", \"present\": %s, \"nevents\": %d, \"max_encoding\": %d, \"counters\": %d, \"type\": ",
+		       pinfo.is_present ? "true" : "false",
+		       pinfo.nevents,
+		       pinfo.max_encoding,
+		       pinfo.num_cntrs + pinfo.num_fixed_cntrs);
+		json_str(pmu_types[pinfo.type]);
+		putchar('}');
+	}
+	printf("\n],\n");
+}
+
 static void
 setup_os(char *ostr)
 {
@@ -768,8 +868,9 @@ main(int argc, char **argv)
 	char *endptr = NULL;
 	char default_sep[2] = "\t";
 	char *ostr = NULL;
+	char *dbfile = NULL;
 	char **args;
-	int i, match;
+	int i, match, status = 0;
 	regex_t preg;
 	int ret, c;
 
@@ -777,7 +878,9 @@ main(int argc, char **argv)
 
 	pinfo.size = sizeof(pinfo);
 
-	while ((c=getopt(argc, argv,"hELsm:Ml:F:x:DO:")) != -1) {
+	options.combo_lim = -1;
+
+	while ((c=getopt(argc, argv,"hELsm:Ml:F:x:DO:X:j")) != -1) {
 		switch(c) {
 			case 'L':
 				options.compact = 1;
@@ -798,6 +901,9 @@ main(int argc, char **argv)
 			case 'D':
 				options.desc = 1;
 				break;
+			case 'j':
+				options.json = 1;
+				break;
 			case 'l':
 				options.combo_lim = atoi(optarg);
 				break;
@@ -807,6 +913,9 @@ main(int argc, char **argv)
 			case 'O':
 				ostr = optarg;
 				break;
+			case 'X':
+				dbfile = optarg;
+				break;
 			case 'm':
 				options.mask = strtoull(optarg, &endptr, 16);
 				if (*endptr)
@@ -829,6 +938,13 @@ main(int argc, char **argv)
 	if (ret != PFM_SUCCESS)
 		errx(1, "cannot initialize libpfm: %s", pfm_strerror(ret));
 
+	if (dbfile) {
+		ret = pfm_export_event_db(dbfile, NULL, 0);
+		if (ret != PFM_SUCCESS)
+			errx(1, "cannot export event database to %s: %s", dbfile, pfm_strerror(ret));
+		return 0;
+	}
+
 	if (options.mask == 0)
 		options.mask = ~0;
 
@@ -841,7 +957,7 @@ main(int argc, char **argv)
 		options.csv_sep = default_sep;
 
 	/* avoid combinatorial explosion */
-	if (options.combo_lim == 0)
+	if (options.combo_lim < 0)
 		options.combo_lim = COMBO_MAX;
 
 	if (ostr)
@@ -849,7 +965,12 @@ main(int argc, char **argv)
 	else
 		options.os = PFM_OS_NONE;
 
-	if (!options.compact) {
+	if (options.json) {
+		printf("{");
+		if (!options.compact)
+			show_pmus_json();
+		printf("\"events\": [");
+	} else if (!options.compact) {
 		int total_supported_events = 0;
 		int total_available_events = 0;
 
@@ -891,23 +1012,28 @@ main(int argc, char **argv)
 	while(*args) {
 		/* drop umasks and modifiers */
 		drop_event_attributes(*args);
-		if (regcomp(&preg, *args, REG_ICASE))
-			errx(1, "error in regular expression for event \"%s\"", *argv);
 
-		if (options.sort)
+		if (options.sort) {
+			if (regcomp(&preg, *args, REG_ICASE))
+				errx(1, "error in regular expression for event \"%s\"", *args);
 			match = show_info_sorted(*args, &preg);
-		else
-			match = show_info(*args, &preg);
-
-		if (match == 0)
-			errx(1, "event %s not found", *args);
-
+			regfree(&preg);
+		} else
+			match = show_info(*args);
+
+		if (match == 0) {
+			/* keep the JSON output well formed */
+			if (!options.json)
+				errx(1, "event %s not found", *args);
+			warnx("event %s not found", *args);
+			status = 1;
+		}
 		args++;
 	}
-
-	regfree(&preg);
+	if (options.json)
+		printf("\n]}\n");
 
 	pfm_terminate();
 
-	return 0;
+	return status;
 }
@@ -443,18 +443,80 @@ typedef struct {
 	int		idx;		/* out: unique event identifier */
 } pfm_pmu_encode_arg_t;
 
+/*
+ * use with pfm_get_encode_cache_info()
+ */
+typedef struct {
+	size_t		size;		/* sizeof struct */
+	int		max_entries;	/* maximum number of entries, 0 = disabled */
+	int		nentries;	/* current number of entries */
+	uint64_t	hits;		/* encodings served from the cache */
+	uint64_t	misses;		/* encodings not found in the cache */
+	uint64_t	evictions;	/* entries dropped to respect max_entries */
+} pfm_encode_cache_info_t;
+
+/*
+ * use with pfm_get_event_groups(), one per event
+ */
+typedef struct {
+	const char	*str;		/* in: event string */
+	size_t		size;		/* sizeof struct */
+	uint64_t	cntmsk;		/* out: counters the event can use, bit 32+n = fixed counter n */
+	int		idx;		/* out: unique event identifier */
+	int		group;		/* out: group number */
+	int		counter;	/* out: counter assigned in the group, -1 if none needed */
+	int		reserved;	/* for future use */
+} pfm_event_group_arg_t;
+
+/*
+ * use with pfm_event_iter_create()
+ */
+typedef struct pfm_event_iter pfm_event_iter_t;
+
+#define PFM_ITER_UMASKS		0x1	/* one entry per unit mask (plain event if none) */
+#define PFM_ITER_COMBOS		0x2	/* all unit mask combinations which encode */
+#define PFM_ITER_INACTIVE	0x4	/* include PMUs not detected on the host */
+
+typedef struct {
+	const char	*pattern;	/* in: regex on pmu::event, NULL for all */
+	size_t		size;		/* sizeof struct */
+	pfm_pmu_t	pmu;		/* in: only this PMU, PFM_PMU_NONE for all */
+	int		flags;		/* in: PFM_ITER_* */
+	int		max_umasks;	/* in: max unit masks per combination, 0 = no limit */
+	int		reserved;	/* for future use */
+} pfm_event_iter_arg_t;
+
+/*
+ * use with pfm_event_iter_next(), valid until the next call
+ */
+typedef struct {
+	const char	*str;		/* out: pmu::event[:umask...] */
+	const int	*umasks;	/* out: attribute index of each unit mask */
+	size_t		size;		/* sizeof struct */
+	int		idx;		/* out: unique event identifier */
+	int		numasks;	/* out: number of unit masks in str */
+} pfm_event_iter_info_t;
+
 #if __WORDSIZE == 64
 #define PFM_PMU_INFO_ABI0	56
 #define PFM_EVENT_INFO_ABI0	64
 #define PFM_ATTR_INFO_ABI0	64
 
 #define PFM_RAW_ENCODE_ABI0	32
+#define PFM_ENCODE_CACHE_INFO_ABI0	40
+#define PFM_EVENT_GROUP_ABI0	40
+#define PFM_EVENT_ITER_ARG_ABI0	32
+#define PFM_EVENT_ITER_INFO_ABI0	32
 #else
 #define PFM_PMU_INFO_ABI0	44
 #define PFM_EVENT_INFO_ABI0	48
 #define PFM_ATTR_INFO_ABI0	48
 
 #define PFM_RAW_ENCODE_ABI0	20
+#define PFM_ENCODE_CACHE_INFO_ABI0	36
+#define PFM_EVENT_GROUP_ABI0	32
+#define PFM_EVENT_ITER_ARG_ABI0	24
+#define PFM_EVENT_ITER_INFO_ABI0	20
 #endif
 
 
@@ -485,6 +547,38 @@ extern pfm_err_t pfm_get_event_info(int idx, pfm_os_t os, pfm_event_info_t *outp
  */
 extern pfm_err_t pfm_get_os_event_encoding(const char *str, int dfl_plm, pfm_os_t os, void *args);
 
+/*
+ * same without heap allocation, memory comes from scratch
+ * (returned codes and fstr point into scratch)
+ */
+#define PFM_ENCODE_SCRATCH_SIZE	16384	/* enough for most events */
+extern pfm_err_t pfm_get_os_event_encoding_r(const char *str, int dfl_plm, pfm_os_t os, void *args, void *scratch, size_t scratch_sz);
+
+/*
+ * pack events into groups which fit the counters of their PMU
+ */
+extern pfm_err_t pfm_get_event_groups(pfm_event_group_arg_t *events, int nevents, int dfl_plm, pfm_os_t os, int *ngroups);
+
+/*
+ * streaming enumeration of event strings
+ */
+extern pfm_err_t pfm_event_iter_create(const pfm_event_iter_arg_t *arg, pfm_event_iter_t **iter);
+extern pfm_err_t pfm_event_iter_next(pfm_event_iter_t *iter, pfm_event_iter_info_t *info);
+extern void pfm_event_iter_destroy(pfm_event_iter_t *iter);
+
+/*
+ * encoding cache API (cache disabled by default)
+ */
+extern pfm_err_t pfm_set_encode_cache(int max_entries);
+extern pfm_err_t pfm_flush_encode_cache(void);
+extern pfm_err_t pfm_get_encode_cache_info(pfm_encode_cache_info_t *info);
+
+/*
+ * compiled event database, loaded with LIBPFM_EVENT_DB
+ * (pmus = NULL: all detected PMUs)
+ */
+extern pfm_err_t pfm_export_event_db(const char *path, const pfm_pmu_t *pmus, int npmus);
+
 /*
  * attribute API
  */
@@ -0,0 +1,493 @@
+/*
+ * gen_event_hash.c: generate the build-time event and unit mask name hashes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * This file is part of libpfm, a performance monitoring support library for
+ * applications on Linux.
+ *
+ * This program is linked with the library objects, except the generated
+ * pfmlib_event_hash.o, and prints pfmlib_event_hash.c on stdout. It reads
+ * the event tables the library is compiled with, through the PMU callbacks,
+ * without calling pfm_initialize(). For each PMU, it builds a minimal perfect
+ * hash (hash and displace) of the event names and one of the unit mask names,
+ * keyed by event index. See pfmlib_phash_t in pfmlib_priv.h for the lookup.
+ *
+ * PMUs with their own matching function or with a table built at runtime
+ * (pme_count is 0 until pmu_init()) get no hashes. PMUs which count their
+ * events at runtime (get_num_events) may hide unit masks depending on the
+ * host, so they get no unit mask hash.
+ */
+#include <sys/types.h>
+#include <ctype.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "pfmlib_priv.h"
+
+/* the library objects refer to the generated table */
+const pfmlib_pmu_phash_t *const pfmlib_pmu_phashes[PFM_PMU_MAX];
+
+#define MAX_DISP	(1U << 24)
+
+typedef struct {
+	char		*name;	/* lowercase */
+	unsigned int	seed;
+	int		idx;
+} gen_key_t;
+
+typedef struct {
+	unsigned int	nkeys;
+	unsigned int	nbuckets;
+	unsigned int	*disp;
+	int		*slot;
+	int		*list;
+	int		nlist;
+} gen_hash_t;
+
+static gen_key_t *keys;
+static int nkeys, max_keys;
+
+static void *
+xmalloc(size_t sz)
+{
+	void *p;
+
+	p = calloc(1, sz ? sz : 1);
+	if (!p) {
+		fprintf(stderr, "gen_event_hash: out of memory\n");
+		exit(1);
+	}
+	return p;
+}
+
+static void
+add_key(const char *name, unsigned int seed, int idx)
+{
+	gen_key_t *k;
+	char *p;
+
+	if (nkeys == max_keys) {
+		max_keys = max_keys ? 2 * max_keys : 1024;
+		keys = realloc(keys, max_keys * sizeof(*keys));
+		if (!keys) {
+			fprintf(stderr, "gen_event_hash: out of memory\n");
+			exit(1);
+		}
+	}
+	k = keys + nkeys++;
+	k->name = strdup(name);
+	if (!k->name) {
+		fprintf(stderr, "gen_event_hash: out of memory\n");
+		exit(1);
+	}
+	for (p = k->name; *p; p++)
+		*p = tolower((int)*p);
+	k->seed = seed;
+	k->idx = idx;
+}
+
+static void
+free_keys(void)
+{
+	int i;
+
+	for (i = 0; i < nkeys; i++)
+		free(keys[i].name);
+	nkeys = 0;
+}
+
+/*
+ * keys of the same name are adjacent, by increasing index
+ */
+static int
+cmp_key(const void *a, const void *b)
+{
+	const gen_key_t *x = a, *y = b;
+	int ret;
+
+	if (x->seed != y->seed)
+		return x->seed < y->seed ? -1 : 1;
+	ret = strcmp(x->name, y->name);
+	if (ret)
+		return ret;
+	return x->idx - y->idx;
+}
+
+static int
+same_name(const gen_key_t *x, const gen_key_t *y)
+{
+	return x->seed == y->seed && !strcmp(x->name, y->name);
+}
+
+/*
+ * first key of each distinct name, in u[]
+ */
+static int
+unique_keys(int *u)
+{
+	int i, n = 0;
+
+	qsort(keys, nkeys, sizeof(*keys), cmp_key);
+
+	for (i = 0; i < nkeys; i++)
+		if (!i || !same_name(keys + i - 1, keys + i))
+			u[n++] = i;
+	return n;
+}
+
+static int *bucket_keys, *bucket_start, *order;
+
+static int
+cmp_bucket(const void *a, const void *b)
+{
+	int x = *(const int *)a, y = *(const int *)b;
+	int sx = bucket_start[x + 1] - bucket_start[x];
+	int sy = bucket_start[y + 1] - bucket_start[y];
+
+	if (sx != sy)
+		return sy - sx;
+	return x - y;
+}
+
+/*
+ * place the n distinct names u[] with nb buckets, 0 on success
+ */
+static int
+try_place(gen_hash_t *h, const int *u, unsigned int n, unsigned int nb)
+{
+	unsigned int *pos, *fill, i, j, b, d;
+	char *used;
+	int ret = 0;
+
+	pos	= xmalloc(n * sizeof(*pos));
+	fill	= xmalloc((nb + 1) * sizeof(*fill));
+	used	= xmalloc(n);
+	bucket_keys  = xmalloc(n * sizeof(*bucket_keys));
+	bucket_start = xmalloc((nb + 1) * sizeof(*bucket_start));
+	order	= xmalloc(nb * sizeof(*order));
+
+	for (i = 0; i < n; i++)
+		bucket_start[pfmlib_phash(keys[u[i]].name, keys[u[i]].seed) % nb + 1]++;
+	for (b = 0; b < nb; b++)
+		bucket_start[b + 1] += bucket_start[b];
+	for (i = 0; i < n; i++) {
+		b = pfmlib_phash(keys[u[i]].name, keys[u[i]].seed) % nb;
+		bucket_keys[bucket_start[b] + fill[b]++] = u[i];
+	}
+	for (b = 0; b < nb; b++)
+		order[b] = b;
+	qsort(order, nb, sizeof(*order), cmp_bucket);
+
+	h->disp = xmalloc(nb * sizeof(*h->disp));
+	h->slot = xmalloc(n * sizeof(*h->slot));
+
+	for (i = 0; i < nb; i++) {
+		int s, m;
+
+		b = order[i];
+		s = bucket_start[b];
+		m = bucket_start[b + 1] - s;
+		if (!m)
+			break;
+
+		for (d = 1; d < MAX_DISP; d++) {
+			for (j = 0; j < (unsigned int)m; j++) {
+				gen_key_t *k = keys + bucket_keys[s + j];
+				unsigned int l;
+
+				pos[j] = pfmlib_phash(k->name, k->seed ^ (d * PFMLIB_PHASH_MULT)) % n;
+				if (used[pos[j]])
+					break;
+				for (l = 0; l < j; l++)
+					if (pos[l] == pos[j])
+						break;
+				if (l < j)
+					break;
+			}
+			if (j == (unsigned int)m)
+				break;
+		}
+		if (d == MAX_DISP) {
+			ret = -1;
+			break;
+		}
+		h->disp[b] = d;
+		for (j = 0; j < (unsigned int)m; j++) {
+			used[pos[j]] = 1;
+			h->slot[pos[j]] = bucket_keys[s + j];
+		}
+	}
+	if (ret) {
+		free(h->disp);
+		free(h->slot);
+	}
+	free(pos);
+	free(fill);
+	free(used);
+	free(bucket_keys);
+	free(bucket_start);
+	free(order);
+
+	return ret;
+}
+
+/*
+ * build the hash of the current keys
+ */
+static void
+build_hash(gen_hash_t *h, const char *pmu)
+{
+	unsigned int n, nb;
+	int *u, i, j, k;
+
+	memset(h, 0, sizeof(*h));
+	if (!nkeys)
+		return;
+
+	u = xmalloc(nkeys * sizeof(*u));
+	n = unique_keys(u);
+
+	for (nb = n / 4 + 1; try_place(h, u, n, nb); nb = 2 * nb) {
+		if (nb > n) {
+			fprintf(stderr, "gen_event_hash: %s: cannot build hash of %u names\n", pmu, n);
+			exit(1);
+		}
+	}
+	h->nkeys = n;
+	h->nbuckets = nb;
+
+	/* slot[] holds the first key of each name, replace by index or list */
+	h->list = xmalloc(nkeys * 2 * sizeof(*h->list));
+	for (i = 0; i < (int)n; i++) {
+		k = h->slot[i];
+		if (k + 1 == nkeys || !same_name(keys + k, keys + k + 1)) {
+			h->slot[i] = keys[k].idx;
+			continue;
+		}
+		h->slot[i] = -(h->nlist + 1);
+		for (j = k; j < nkeys && same_name(keys + j, keys + k); j++)
+			h->list[h->nlist++] = keys[j].idx;
+		h->list[h->nlist++] = -1;
+	}
+	free(u);
+}
+
+/*
+ * hashes already printed, PMUs with the same table and unit masks
+ * (e.g., the uncore boxes of a socket) share them
+ */
+typedef struct {
+	char		name[64];
+	gen_hash_t	h;
+} gen_out_t;
+
+static gen_out_t *outs;
+static int nouts;
+
+static void
+make_ident(char *buf, size_t sz, const char *pmu, const char *pfx)
+{
+	char *p;
+
+	snprintf(buf, sz, "phash_%s%s%s", pmu, *pfx ? "_" : "", pfx);
+	for (p = buf; *p; p++)
+		if (!isalnum((int)*p))
+			*p = '_';
+}
+
+static void
+print_string(const char *s)
+{
+	putchar('"');
+	for (; *s; s++) {
+		if (*s == '"' || *s == '\\')
+			putchar('\\');
+		putchar(*s);
+	}
+	putchar('"');
+}
+
+static void
+print_array(const char *name, const char *sfx, const char *type, const void *v, int n, int is_signed)
+{
+	int i;
+
+	printf("static const %s %s%s[] = {", type, name, sfx);
+	for (i = 0; i < n; i++) {
+		if (!(i % 10))
+			printf("\n\t");
+		if (is_signed)
+			printf("%d,", ((const int *)v)[i]);
+		else
+			printf("%u,", ((const unsigned int *)v)[i]);
+	}
+	printf("\n};\n");
+}
+
+static int
+same_hash(const gen_hash_t *x, const gen_hash_t *y)
+{
+	return x->nkeys == y->nkeys && x->nbuckets == y->nbuckets && x->nlist == y->nlist
+	    && !memcmp(x->disp, y->disp, x->nbuckets * sizeof(*x->disp))
+	    && !memcmp(x->slot, y->slot, x->nkeys * sizeof(*x->slot))
+	    && !memcmp(x->list, y->list, x->nlist * sizeof(*x->list));
+}
+
+/*
+ * print the arrays of h unless identical ones were printed,
+ * return their index in outs[] (which may move), -1 if h is empty
+ */
+static int
+print_hash(const char *pmu, const char *pfx, gen_hash_t *h)
+{
+	gen_out_t *o;
+	int i;
+
+	if (!h->nkeys)
+		return -1;
+
+	for (i = 0; i < nouts; i++)
+		if (same_hash(&outs[i].h, h)) {
+			free(h->disp);
+			free(h->slot);
+			free(h->list);
+			return i;
+		}
+
+	outs = realloc(outs, (nouts + 1) * sizeof(*outs));
+	if (!outs) {
+		fprintf(stderr, "gen_event_hash: out of memory\n");
+		exit(1);
+	}
+	o = outs + nouts++;
+	make_ident(o->name, sizeof(o->name), pmu, pfx);
+	o->h = *h;
+
+	print_array(o->name, "disp", "unsigned int", h->disp, h->nbuckets, 0);
+	print_array(o->name, "slot", "int", h->slot, h->nkeys, 1);
+	if (h->nlist)
+		print_array(o->name, "list", "int", h->list, h->nlist, 1);
+
+	return nouts - 1;
+}
+
+static void
+print_hash_init(int i)
+{
+	const gen_out_t *o;
+
+	if (i < 0) {
+		printf("\t{ 0, 0, NULL, NULL, NULL },\n");
+		return;
+	}
+	o = outs + i;
+	printf("\t{ %u, %u, %sdisp, %sslot, ", o->h.nkeys, o->h.nbuckets, o->name, o->name);
+	if (o->h.nlist)
+		printf("%slist },\n", o->name);
+	else
+		printf("NULL },\n");
+}
+
+int
+main(void)
+{
+	pfm_event_attr_info_t ainfo;
+	pfm_event_info_t einfo;
+	int oe, ou;
+	gen_hash_t ev, um;
+	pfmlib_pmu_t *pmu;
+	char ident[64], *first;
+	unsigned int seed;
+	int done[PFM_PMU_MAX];
+	int i, j, a, n, ret;
+
+	memset(done, 0, sizeof(done));
+
+	printf("/*\n * pfmlib_event_hash.c: generated by gen_event_hash, do not edit\n */\n");
+	printf("#include <sys/types.h>\n#include <stdio.h>\n\n#include \"pfmlib_priv.h\"\n\n");
+
+	for (i = 0; (pmu = pfmlib_get_pmu_by_idx(i)); i++) {
+		if (pmu->pme_count <= 0 || !pmu->pe || pmu->match_event || pmu->resolve_event)
+			continue;
+
+		/* a PMU model may be listed more than once */
+		if (done[pmu->pmu])
+			continue;
+
+		first = NULL;
+		for (j = 0; j < pmu->pme_count; j++) {
+			ret = pmu->get_event_info(pmu, j, &einfo);
+			if (ret != PFM_SUCCESS) {
+				fprintf(stderr, "gen_event_hash: %s: no info for event %d\n", pmu->name, j);
+				exit(1);
+			}
+			if (!j)
+				first = strdup(einfo.name);
+			add_key(einfo.name, 0, j);
+		}
+		if (!first) {
+			fprintf(stderr, "gen_event_hash: out of memory\n");
+			exit(1);
+		}
+		build_hash(&ev, pmu->name);
+		free_keys();
+
+		for (j = 0; !pmu->get_num_events && pmu->get_event_nattrs && j < pmu->pme_count; j++) {
+			seed = (j + 1) * PFMLIB_PHASH_MULT;
+			n = pmu->get_event_nattrs(pmu, j);
+			for (a = 0; a < n; a++) {
+				ret = pmu->get_event_attr_info(pmu, j, a, &ainfo);
+				if (ret != PFM_SUCCESS || ainfo.type != PFM_ATTR_UMASK)
+					continue;
+				add_key(ainfo.name, seed, a);
+			}
+		}
+		build_hash(&um, pmu->name);
+		free_keys();
+
+		oe = print_hash(pmu->name, "e", &ev);
+		ou = print_hash(pmu->name, "u", &um);
+
+		make_ident(ident, sizeof(ident), pmu->name, "");
+		printf("static const pfmlib_pmu_phash_t %s = {\n\t%d,\n\t", ident, pmu->pme_count);
+		print_string(first);
+		printf(",\n\t");
+		print_string(einfo.name);
+		printf(",\n");
+		print_hash_init(oe);
+		print_hash_init(ou);
+		printf("};\n\n");
+
+		free(first);
+		done[pmu->pmu] = 1;
+	}
+
+	printf("const pfmlib_pmu_phash_t *const pfmlib_pmu_phashes[PFM_PMU_MAX] = {\n");
+	for (i = 0; (pmu = pfmlib_get_pmu_by_idx(i)); i++) {
+		if (done[pmu->pmu] != 1)
+			continue;
+		make_ident(ident, sizeof(ident), pmu->name, "");
+		printf("\t[%d] = &%s,\n", pmu->pmu, ident);
+		done[pmu->pmu] = 2;
+	}
+	printf("};\n");
+
+	return 0;
+}
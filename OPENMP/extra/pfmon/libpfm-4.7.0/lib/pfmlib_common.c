@@ -32,6 +32,7 @@
 #include <stdlib.h>
 #include <stdarg.h>
 #include <limits.h>
+#include <pthread.h>
 
 #include <perfmon/pfmlib.h>
 
@@ -461,7 +462,8 @@ pfmlib_same_attr(pfmlib_event_desc_t *d, int i, int j)
 static inline int
 pfmlib_pmu_active(pfmlib_pmu_t *pmu)
 {
-        return !!(pmu->flags & PFMLIB_PMU_FL_ACTIVE);
+        /* cleared by a failed deferred init, see pfmlib_pmu_lazy_init() */
+        return !!(__atomic_load_n(&pmu->flags, __ATOMIC_RELAXED) & PFMLIB_PMU_FL_ACTIVE);
 }
 
 static inline int
@@ -470,6 +472,54 @@ pfmlib_pmu_initialized(pfmlib_pmu_t *pmu)
         return !!(pmu->flags & PFMLIB_PMU_FL_INIT);
 }
 
+static pthread_mutex_t pfmlib_lazy_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * run the pmu_init() callback deferred by LIBPFM_LAZY_INIT
+ * on failure, the PMU is deactivated as it would have been
+ * by pfm_initialize() and later calls keep failing
+ */
+static int
+pfmlib_pmu_lazy_init(pfmlib_pmu_t *pmu)
+{
+	int ret = PFM_SUCCESS;
+
+	pthread_mutex_lock(&pfmlib_lazy_lock);
+
+	if (pmu->flags & PFMLIB_PMU_FL_LAZY) {
+		ret = pmu->pmu_init(pmu);
+		if (ret != PFM_SUCCESS) {
+			DPRINT("deferred init of %s failed\n", pmu->desc);
+			__atomic_or_fetch(&pmu->flags, PFMLIB_PMU_FL_LAZY_FAIL, __ATOMIC_RELAXED);
+			__atomic_and_fetch(&pmu->flags, ~PFMLIB_PMU_FL_ACTIVE, __ATOMIC_RELAXED);
+		} else {
+			DPRINT("deferred init of %s\n", pmu->desc);
+		}
+		__atomic_and_fetch(&pmu->flags, ~PFMLIB_PMU_FL_LAZY, __ATOMIC_RELEASE);
+	} else if (pmu->flags & PFMLIB_PMU_FL_LAZY_FAIL) {
+		ret = PFM_ERR_NOTSUPP;
+	}
+
+	pthread_mutex_unlock(&pfmlib_lazy_lock);
+
+	return ret;
+}
+
+/*
+ * must be called before accessing the event tables of
+ * an active PMU
+ */
+static inline int
+pfmlib_pmu_ready(pfmlib_pmu_t *pmu)
+{
+	int flags = __atomic_load_n(&pmu->flags, __ATOMIC_ACQUIRE);
+
+	if (!(flags & PFMLIB_PMU_FL_LAZY))
+		return flags & PFMLIB_PMU_FL_LAZY_FAIL ? PFM_ERR_NOTSUPP : PFM_SUCCESS;
+
+	return pfmlib_pmu_lazy_init(pmu);
+}
+
 static inline pfm_pmu_t
 idx2pmu(int idx)
 {
@@ -511,6 +561,9 @@ pfmlib_idx2pidx(int idx, int *pidx)
 
 	*pidx = idx & PFMLIB_PMU_PIDX_MASK;
 
+	if (pfmlib_pmu_ready(pmu) != PFM_SUCCESS)
+		return NULL;
+
 	if (!pmu->event_is_valid(pmu, *pidx))
 		return NULL;
 
@@ -601,6 +654,21 @@ pfmlib_init_env(void)
 	str = getenv("LIBPFM_DISABLED_PMUS");
 	if (str)
 		pfm_cfg.blacklist_pmus = str;
+
+	pfm_cfg.no_evt_index = !!getenv("LIBPFM_NO_EVENT_INDEX");
+
+	pfm_cfg.no_evt_phash = !!getenv("LIBPFM_NO_EVENT_PHASH");
+
+	str = getenv("LIBPFM_ENCODE_CACHE");
+	pfm_cfg.encode_cache = str ? atoi(str) : 0;
+
+	pfm_cfg.lazy_init = !!getenv("LIBPFM_LAZY_INIT");
+
+	pfm_cfg.debugfs_mnt = getenv("LIBPFM_DEBUGFS");
+
+	pfm_cfg.tp_cache = getenv("LIBPFM_TRACEPOINT_CACHE");
+
+	pfm_cfg.event_db = getenv("LIBPFM_EVENT_DB");
 }
 
 static int
@@ -630,7 +698,7 @@ pfmlib_build_fstr(pfmlib_event_desc_t *e, char **fstr)
 	if (!fstr)
 		return PFM_SUCCESS;
 
-	*fstr = malloc(strlen(e->fstr) + 2 + strlen(e->pmu->name) + 1);
+	*fstr = pfmlib_event_alloc(e, strlen(e->fstr) + 2 + strlen(e->pmu->name) + 1);
 	if (*fstr)
 		sprintf(*fstr, "%s::%s", e->pmu->name, e->fstr);
 
@@ -749,7 +817,17 @@ pfmlib_init_pmus(void)
 			}
 		}
 
-		ret = pfmlib_pmu_activate(p);
+		/*
+		 * detected PMU, table setup deferred until
+		 * first use in lazy mode
+		 */
+		if (pfm_cfg.lazy_init && p->pmu_init) {
+			p->flags |= PFMLIB_PMU_FL_ACTIVE | PFMLIB_PMU_FL_LAZY;
+			DPRINT("activated %s, init deferred\n", p->desc);
+			ret = PFM_SUCCESS;
+		} else {
+			ret = pfmlib_pmu_activate(p);
+		}
 		if (ret == PFM_SUCCESS)
 			nsuccess++;
 
@@ -814,6 +892,12 @@ pfm_initialize(void)
 		pfmlib_init_os();
 
 		ret = pfmlib_init_pmus();
+
+		if (ret == PFM_SUCCESS && pfm_cfg.encode_cache > 0)
+			pfmlib_encode_cache_set(pfm_cfg.encode_cache);
+
+		if (ret == PFM_SUCCESS && pfm_cfg.event_db)
+			pfmlib_event_db_load(pfm_cfg.event_db);
 	}
 
 	pfm_cfg.initdone = 1;
@@ -822,6 +906,8 @@ pfm_initialize(void)
 	return ret;
 }
 
+static void pfmlib_event_index_free(pfmlib_event_index_t *x);
+
 void
 pfm_terminate(void)
 {
@@ -831,10 +917,25 @@ pfm_terminate(void)
 	if (PFMLIB_INITIALIZED() == 0)
 		return;
 
+	pfmlib_encode_cache_fini();
+
+	pfmlib_event_db_unload();
+
 	pfmlib_for_each_pmu(i) {
 		pmu = pfmlib_pmus[i];
+		/* index may exist for inactive PMUs (LIBPFM_ENCODE_INACTIVE) */
+		pfmlib_event_index_free(pmu->evt_index);
+		pmu->evt_index = NULL;
+		pmu->evt_phash = NULL;
+		pmu->evt_phash_checked = 0;
+		pmu->flags &= ~PFMLIB_PMU_FL_LAZY_FAIL;
 		if (!pfmlib_pmu_active(pmu))
 			continue;
+		/* pmu_init() was never called */
+		if (pmu->flags & PFMLIB_PMU_FL_LAZY) {
+			pmu->flags &= ~(PFMLIB_PMU_FL_LAZY | PFMLIB_PMU_FL_ACTIVE);
+			continue;
+		}
 		if (pmu->pmu_terminate)
 			pmu->pmu_terminate(pmu);
 	}
@@ -890,6 +991,8 @@ pfmlib_sanitize_event(pfmlib_event_desc_t *d)
 	return PFM_SUCCESS;
 }
 
+static int pfmlib_find_umask_attr(pfmlib_event_desc_t *d, const char *s);
+
 static int
 pfmlib_parse_event_attr(char *str, pfmlib_event_desc_t *d)
 {
@@ -948,6 +1051,15 @@ pfmlib_parse_event_attr(char *str, pfmlib_event_desc_t *d)
 			goto found_attr;
 		}
 
+		/* unit masks without value, e.g., not L2_LINES_IN:I=1 */
+		if (!has_val) {
+			aidx = pfmlib_find_umask_attr(d, s);
+			if (aidx >= 0) {
+				ainfo = d->pattrs + aidx;
+				goto found_attr;
+			}
+		}
+
 		for(aidx = 0; aidx < d->npattrs; aidx++) {
 			if (!strcasecmp(d->pattrs[aidx].name, s)) {
 				ainfo = d->pattrs + aidx;
@@ -980,13 +1092,13 @@ found_attr:
 				return PFM_ERR_ATTR_VAL;
 
 			/* copy because it is const */
-			z = strdup(ainfo->equiv);
+			z = pfmlib_event_strdup(d, ainfo->equiv);
 			if (!z)
 				return PFM_ERR_NOMEM;
 
 			ret = pfmlib_parse_event_attr(z, d);
 
-			free(z);
+			pfmlib_event_free(d, z);
 
 			if (ret != PFM_SUCCESS)
 				return ret;
@@ -1086,9 +1198,11 @@ pfmlib_build_event_pattrs(pfmlib_event_desc_t  *e)
 		npattrs++;
 
 	if (npattrs) {
-		e->pattrs = malloc(npattrs * sizeof(*e->pattrs));
+		e->pattrs = pfmlib_event_alloc(e, npattrs * sizeof(*e->pattrs));
 		if (!e->pattrs)
 			return PFM_ERR_NOMEM;
+		/* OS attributes do not set all fields (defaults) */
+		memset(e->pattrs, 0, npattrs * sizeof(*e->pattrs));
 	}
 
 	/* collect all actual PMU attrs */
@@ -1114,7 +1228,7 @@ pfmlib_build_event_pattrs(pfmlib_event_desc_t  *e)
 
 	return PFM_SUCCESS;
 error:
-	free(e->pattrs);
+	pfmlib_event_free(e, e->pattrs);
 	e->pattrs = NULL;
 	return ret;
 }
@@ -1122,22 +1236,411 @@ error:
 void
 pfmlib_release_event(pfmlib_event_desc_t *e)
 {
-	free(e->pattrs);
+	pfmlib_event_free(e, e->pattrs);
 	e->pattrs = NULL;
 }
 
+/*
+ * memory for the parsing and encoding of event e, taken
+ * from the arena of the event if any, otherwise from the heap
+ */
+void *
+pfmlib_event_alloc(pfmlib_event_desc_t *e, size_t sz)
+{
+	pfmlib_arena_t *a = e->arena;
+	size_t off;
+
+	if (!a)
+		return malloc(sz);
+
+	off = (a->used + PFMLIB_ARENA_ALIGN - 1) & ~(PFMLIB_ARENA_ALIGN - 1);
+	if (off > a->size || sz > a->size - off) {
+		DPRINT("scratch memory too small for %zu bytes\n", sz);
+		a->full = 1;
+		return NULL;
+	}
+	a->used = off + sz;
+
+	return a->base + off;
+}
+
+char *
+pfmlib_event_strdup(pfmlib_event_desc_t *e, const char *s)
+{
+	size_t sz = strlen(s) + 1;
+	char *p;
+
+	p = pfmlib_event_alloc(e, sz);
+	if (p)
+		memcpy(p, s, sz);
+	return p;
+}
+
+/*
+ * arena memory is released with the arena, by the caller
+ */
+void
+pfmlib_event_free(pfmlib_event_desc_t *e, void *p)
+{
+	if (!e->arena)
+		free(p);
+}
+
 static int
 match_event(void *this, pfmlib_event_desc_t *d, const char *e, const char *s)
 {
 	return strcasecmp(e, s);
 }
 
+/*
+ * FNV-1a hash of the lowercase event name
+ */
+static inline unsigned int
+pfmlib_hash_name(const char *s)
+{
+	unsigned int h = 2166136261U;
+
+	while (*s) {
+		h ^= (unsigned char)tolower((int)*s++);
+		h *= 16777619U;
+	}
+	return h;
+}
+
+/*
+ * serializes the changes to the name indexes, lookups do not lock
+ */
+static pthread_mutex_t pfmlib_index_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static pfmlib_event_index_t *
+pfmlib_event_index_alloc(unsigned int nslots)
+{
+	pfmlib_event_index_t *x;
+	unsigned int i;
+
+	x = malloc(sizeof(*x) + nslots * sizeof(x->slots[0]));
+	if (!x)
+		return NULL;
+
+	x->mask = nslots - 1;
+	x->count = 0;
+	x->retired = NULL;
+	for (i = 0; i < nslots; i++)
+		x->slots[i].pidx = -1;
+	return x;
+}
+
+/*
+ * insert name into index, the first pidx inserted for a name wins,
+ * i.e., the same event as a linear scan of the table
+ */
+static void
+pfmlib_event_index_insert(pfmlib_event_index_t *x, const char *name, unsigned int h, int pidx)
+{
+	pfmlib_event_index_entry_t *e;
+	unsigned int i;
+
+	for (i = h & x->mask; ; i = (i + 1) & x->mask) {
+		e = x->slots + i;
+		if (e->pidx == -1)
+			break;
+		if (e->hash == h && !strcasecmp(e->name, name))
+			return;
+	}
+	e->name = name;
+	e->hash = h;
+	/* readers may be probing the index, pidx last */
+	__atomic_store_n(&e->pidx, pidx, __ATOMIC_RELEASE);
+	x->count++;
+}
+
+static void
+pfmlib_event_index_free(pfmlib_event_index_t *x)
+{
+	pfmlib_event_index_t *r;
+
+	for (; x; x = r) {
+		r = x->retired;
+		free(x);
+	}
+}
+
+/*
+ * add an event to an existing index, e.g., for PMUs whose event
+ * table grows after initialization. The index is resized to keep
+ * at least half of the slots free. Nothing to do if the index is
+ * not built yet, it will include the event when it is.
+ *
+ * Other threads may be looking up names, a replaced index is kept
+ * until pfm_terminate().
+ */
+int
+pfmlib_event_index_add(pfmlib_pmu_t *pmu, const char *name, int pidx)
+{
+	pfmlib_event_index_t *x, *nx;
+	unsigned int i;
+	int ret = PFM_SUCCESS;
+
+	pthread_mutex_lock(&pfmlib_index_lock);
+
+	x = pmu->evt_index;
+	if (!x)
+		goto done;
+
+	if (2 * (x->count + 1) > x->mask + 1) {
+		nx = pfmlib_event_index_alloc(2 * (x->mask + 1));
+		if (!nx) {
+			/* unchanged, the lookup falls back to resolve_event() */
+			ret = PFM_ERR_NOMEM;
+			goto done;
+		}
+		for (i = 0; i <= x->mask; i++)
+			if (x->slots[i].pidx != -1)
+				pfmlib_event_index_insert(nx, x->slots[i].name,
+							  x->slots[i].hash,
+							  x->slots[i].pidx);
+		nx->retired = x;
+		__atomic_store_n(&pmu->evt_index, nx, __ATOMIC_RELEASE);
+		x = nx;
+	}
+	pfmlib_event_index_insert(x, name, pfmlib_hash_name(name), pidx);
+done:
+	pthread_mutex_unlock(&pfmlib_index_lock);
+	return ret;
+}
+
+/*
+ * hash of the lowercase name for the build-time hashes,
+ * must not change without regenerating them
+ */
+unsigned int
+pfmlib_phash(const char *s, unsigned int seed)
+{
+	unsigned int h = 2166136261U ^ seed;
+
+	while (*s) {
+		h ^= (unsigned char)tolower((int)*s++);
+		h *= 16777619U;
+	}
+	/* FNV-1a alone mixes the high bits poorly */
+	h ^= h >> 16;
+	h *= 0x85ebca6bU;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35U;
+	h ^= h >> 16;
+
+	return h;
+}
+
+/*
+ * return the number of candidate indexes for name s, in *idx
+ */
+int
+pfmlib_phash_lookup(const pfmlib_phash_t *h, const char *s, unsigned int seed, const int **idx)
+{
+	unsigned int d, k;
+	int n;
+
+	if (!h->nkeys)
+		return 0;
+
+	d = h->disp[pfmlib_phash(s, seed) % h->nbuckets];
+	k = pfmlib_phash(s, seed ^ (d * PFMLIB_PHASH_MULT)) % h->nkeys;
+
+	if (h->slot[k] >= 0) {
+		*idx = h->slot + k;
+		return 1;
+	}
+	*idx = h->list - h->slot[k] - 1;
+	for (n = 0; (*idx)[n] != -1; n++);
+
+	return n;
+}
+
+/*
+ * build-time hashes of the PMU, if any. They are built from the
+ * tables the library is compiled with. The PMU may use another
+ * table or event count depending on the host (pmu_init()), so
+ * the hashes are used only if the table matches.
+ */
+static const pfmlib_pmu_phash_t *
+pfmlib_pmu_phash(pfmlib_pmu_t *pmu)
+{
+	const pfmlib_pmu_phash_t *ph = NULL;
+	pfm_event_info_t einfo;
+
+	if (__atomic_load_n(&pmu->evt_phash_checked, __ATOMIC_ACQUIRE))
+		return __atomic_load_n(&pmu->evt_phash, __ATOMIC_RELAXED);
+
+	if (!(pfm_cfg.no_evt_index || pfm_cfg.no_evt_phash || pmu->match_event))
+		ph = pfmlib_pmu_phashes[pmu->pmu];
+
+	if (ph && (ph->pme_count != pmu->pme_count
+	    || pmu->get_event_info(pmu, 0, &einfo) != PFM_SUCCESS
+	    || strcmp(einfo.name, ph->first)
+	    || pmu->get_event_info(pmu, ph->pme_count - 1, &einfo) != PFM_SUCCESS
+	    || strcmp(einfo.name, ph->last))) {
+		DPRINT("%s: table does not match build-time hashes\n", pmu->name);
+		ph = NULL;
+	}
+	/* threads racing here all find the same result */
+	__atomic_store_n(&pmu->evt_phash, ph, __ATOMIC_RELAXED);
+	__atomic_store_n(&pmu->evt_phash_checked, 1, __ATOMIC_RELEASE);
+
+	return ph;
+}
+
+/*
+ * index of unit mask s in d->pattrs using the build-time hashes,
+ * -1 if not found or if it cannot be used
+ */
+static int
+pfmlib_find_umask_attr(pfmlib_event_desc_t *d, const char *s)
+{
+	const pfmlib_pmu_phash_t *ph;
+	const int *idx;
+	int n;
+
+	ph = pfmlib_pmu_phash(d->pmu);
+	if (!ph)
+		return -1;
+
+	n = pfmlib_phash_lookup(&ph->umasks, s, (d->event + 1) * PFMLIB_PHASH_MULT, &idx);
+
+	/*
+	 * first unit mask with this name, the attributes of the
+	 * event must be those the hashes were built from
+	 */
+	if (n && idx[0] < d->npattrs
+	    && d->pattrs[idx[0]].type == PFM_ATTR_UMASK
+	    && !strcasecmp(d->pattrs[idx[0]].name, s))
+		return idx[0];
+
+	return -1;
+}
+
+static int
+pfmlib_build_event_index(pfmlib_pmu_t *pmu)
+{
+	pfmlib_event_index_t *x;
+	pfm_event_info_t einfo;
+	unsigned int nslots = 16;
+	int i, n = 0, ret = PFM_SUCCESS;
+
+	pthread_mutex_lock(&pfmlib_index_lock);
+
+	/* built by another thread */
+	if (pmu->evt_index)
+		goto done;
+
+	pfmlib_for_each_pmu_event(pmu, i)
+		n++;
+
+	while (nslots < 2U * n)
+		nslots <<= 1;
+
+	x = pfmlib_event_index_alloc(nslots);
+	if (!x) {
+		ret = PFM_ERR_NOMEM;
+		goto done;
+	}
+
+	pfmlib_for_each_pmu_event(pmu, i) {
+		ret = pmu->get_event_info(pmu, i, &einfo);
+		if (ret != PFM_SUCCESS) {
+			free(x);
+			goto done;
+		}
+		pfmlib_event_index_insert(x, einfo.name, pfmlib_hash_name(einfo.name), i);
+	}
+	__atomic_store_n(&pmu->evt_index, x, __ATOMIC_RELEASE);
+
+	DPRINT("%s: indexed %u events in %u slots\n", pmu->name, x->count, nslots);
+done:
+	pthread_mutex_unlock(&pfmlib_index_lock);
+	return ret;
+}
+
+/*
+ * find event s in pmu, using the name index when possible
+ * return:
+ * 	>= 0 : private index of the event, einfo is filled in
+ * 	PFM_ERR_NOTFOUND : no match
+ * 	< 0 : error
+ */
+static int
+pfmlib_find_pmu_event(pfmlib_pmu_t *pmu, pfmlib_event_desc_t *d, const char *s, pfm_event_info_t *einfo)
+{
+	const pfmlib_pmu_phash_t *ph;
+	pfmlib_event_index_entry_t *e;
+	pfmlib_event_index_t *x;
+	unsigned int h, i;
+	const int *idx;
+	int pidx, ret, n;
+
+	/*
+	 * build-time hashes: candidates are checked against the
+	 * table, the first valid one is the one a scan would find
+	 */
+	ph = pfmlib_pmu_phash(pmu);
+	if (ph) {
+		n = pfmlib_phash_lookup(&ph->events, s, 0, &idx);
+		for (i = 0; i < (unsigned int)n; i++) {
+			if (!pmu->event_is_valid(pmu, idx[i]))
+				continue;
+			ret = pmu->get_event_info(pmu, idx[i], einfo);
+			if (ret != PFM_SUCCESS)
+				return ret;
+			if (!strcasecmp(einfo->name, s))
+				return idx[i];
+		}
+		return PFM_ERR_NOTFOUND;
+	}
+
+	/*
+	 * PMUs with their own matching function cannot be indexed
+	 * by name (e.g., perf_raw), neither can they be if disabled
+	 * or if the index cannot be built
+	 */
+	x = __atomic_load_n(&pmu->evt_index, __ATOMIC_ACQUIRE);
+	if (!pmu->match_event && !pfm_cfg.no_evt_index && !x) {
+		pfmlib_build_event_index(pmu);
+		x = __atomic_load_n(&pmu->evt_index, __ATOMIC_ACQUIRE);
+	}
+	if (!x || pmu->match_event) {
+		int (*match)(void *this, pfmlib_event_desc_t *d, const char *e, const char *s);
+
+		match = pmu->match_event ? pmu->match_event : match_event;
+
+		pfmlib_for_each_pmu_event(pmu, pidx) {
+			ret = pmu->get_event_info(pmu, pidx, einfo);
+			if (ret != PFM_SUCCESS)
+				return ret;
+			if (!match(pmu, d, einfo->name, s))
+				return pidx;
+		}
+		return PFM_ERR_NOTFOUND;
+	}
+
+	h = pfmlib_hash_name(s);
+	for (i = h & x->mask; ; i = (i + 1) & x->mask) {
+		e = x->slots + i;
+		pidx = __atomic_load_n(&e->pidx, __ATOMIC_ACQUIRE);
+		if (pidx == -1)
+			break;
+		if (e->hash != h || strcasecmp(e->name, s))
+			continue;
+		ret = pmu->get_event_info(pmu, pidx, einfo);
+		return ret == PFM_SUCCESS ? pidx : ret;
+	}
+	return PFM_ERR_NOTFOUND;
+}
+
 static int
 pfmlib_parse_equiv_event(const char *event, pfmlib_event_desc_t *d)
 {
 	pfmlib_pmu_t *pmu = d->pmu;
 	pfm_event_info_t einfo;
-	int (*match)(void *this, pfmlib_event_desc_t *d, const char *e, const char *s);
 	char *str, *s, *p;
 	int i;
 	int ret;
@@ -1145,7 +1648,7 @@ pfmlib_parse_equiv_event(const char *event, pfmlib_event_desc_t *d)
 	/*
 	 * create copy because string is const
 	 */
-	s = str = strdup(event);
+	s = str = pfmlib_event_strdup(d, event);
 	if (!str)
 		return PFM_ERR_NOMEM;
 
@@ -1153,18 +1656,11 @@ pfmlib_parse_equiv_event(const char *event, pfmlib_event_desc_t *d)
 	if (p)
 		*p++ = '\0';
 
-	match = pmu->match_event ? pmu->match_event : match_event;
-
-	pfmlib_for_each_pmu_event(pmu, i) {
-		ret = pmu->get_event_info(pmu, i, &einfo);
-		if (ret != PFM_SUCCESS)
-			goto error;
-		if (!match(pmu, d, einfo.name, s))
-			goto found;
+	i = pfmlib_find_pmu_event(pmu, d, s, &einfo);
+	if (i < 0) {
+		ret = i;
+		goto error;
 	}
-	free(str);
-	return PFM_ERR_NOTFOUND;
-found:
 	d->pmu = pmu;
 	d->event = i; /* private index */
 
@@ -1181,7 +1677,7 @@ found:
 	if (ret == PFM_SUCCESS)
 		ret = pfmlib_sanitize_event(d);
 error:
-	free(str);
+	pfmlib_event_free(d, str);
 
 	if (ret != PFM_SUCCESS)
 		pfmlib_release_event(d);
@@ -1195,14 +1691,13 @@ pfmlib_parse_event(const char *event, pfmlib_event_desc_t *d)
 	pfm_event_info_t einfo;
 	char *str, *s, *p;
 	pfmlib_pmu_t *pmu;
-	int (*match)(void *this, pfmlib_event_desc_t *d, const char *e, const char *s);
 	const char *pname = NULL;
 	int i, j, ret;
 
 	/*
 	 * create copy because string is const
 	 */
-	s = str = strdup(event);
+	s = str = pfmlib_event_strdup(d, event);
 	if (!str)
 		return PFM_ERR_NOMEM;
 
@@ -1250,19 +1745,30 @@ pfmlib_parse_event(const char *event, pfmlib_event_desc_t *d)
 		if (pname && !pfmlib_pmu_active(pmu) && !pfm_cfg.inactive)
 			continue;
 
-		match = pmu->match_event ? pmu->match_event : match_event;
+		if (pfmlib_pmu_ready(pmu) != PFM_SUCCESS)
+			continue;
+
+		i = pfmlib_find_pmu_event(pmu, d, s, &einfo);
 		/*
-		 * for each event
+		 * PMU may load the event and its unit masks on demand,
+		 * e.g., perf_events tracepoints
 		 */
-		pfmlib_for_each_pmu_event(pmu, i) {
-			ret = pmu->get_event_info(pmu, i, &einfo);
-			if (ret != PFM_SUCCESS)
-				goto error;
-			if (!match(pmu, d, einfo.name, s))
-				goto found;
+		if (pmu->resolve_event && (i >= 0 || i == PFM_ERR_NOTFOUND)) {
+			i = pmu->resolve_event(pmu, i, s, p);
+			if (i >= 0) {
+				ret = pmu->get_event_info(pmu, i, &einfo);
+				if (ret != PFM_SUCCESS)
+					goto error;
+			}
+		}
+		if (i >= 0)
+			goto found;
+		if (i != PFM_ERR_NOTFOUND) {
+			ret = i;
+			goto error;
 		}
 	}
-	free(str);
+	pfmlib_event_free(d, str);
 	return PFM_ERR_NOTFOUND;
 found:
 	d->pmu = pmu;
@@ -1295,7 +1801,7 @@ found:
 			DPRINT("%d %d RAW_UMASK (0x%x)\n", d->event, i, a->idx);
 	}
 error:
-	free(str);
+	pfmlib_event_free(d, str);
 	if (ret != PFM_SUCCESS)
 		pfmlib_release_event(d);
 	return ret;
@@ -1368,7 +1874,46 @@ pfm_get_os_event_encoding(const char *str, int dfl_plm, pfm_os_t uos, void *args
 	if (!os)
 		return PFM_ERR_NOTSUPP;
 
-	return os->encode(os, str, dfl_plm, args);
+	return os->encode(os, str, dfl_plm, args, NULL);
+}
+
+/*
+ * same as pfm_get_os_event_encoding() but all the memory needed,
+ * including the returned codes and fstr if requested, is taken
+ * from scratch. Does not use the encoding cache.
+ */
+int
+pfm_get_os_event_encoding_r(const char *str, int dfl_plm, pfm_os_t uos, void *args, void *scratch, size_t scratch_sz)
+{
+	pfmlib_arena_t arena;
+	pfmlib_os_t *os;
+	int ret;
+
+	if (PFMLIB_INITIALIZED() == 0)
+		return PFM_ERR_NOINIT;
+
+	if (!(args && str && scratch))
+		return PFM_ERR_INVAL;
+
+	if (dfl_plm & ~(PFM_PLM_ALL))
+		return PFM_ERR_INVAL;
+
+	os = pfmlib_find_os(uos);
+	if (!os)
+		return PFM_ERR_NOTSUPP;
+
+	arena.base = scratch;
+	arena.size = scratch_sz;
+	arena.used = 0;
+	arena.full = 0;
+
+	ret = os->encode(os, str, dfl_plm, args, &arena);
+
+	/* out of scratch memory, not of heap */
+	if (ret == PFM_ERR_NOMEM && arena.full)
+		ret = PFM_ERR_TOOSMALL;
+
+	return ret;
 }
 
 /*
@@ -1585,7 +2130,7 @@ pfm_pmu_validate(pfm_pmu_t pmu_id, FILE *fp)
 		return PFM_ERR_INVAL;
 
 
-	if (!pfmlib_pmu_initialized(pmu)) {
+	if (!pfmlib_pmu_initialized(pmu) || pfmlib_pmu_ready(pmu) != PFM_SUCCESS) {
 		fprintf(fp, "pmu: %s :: initialization failed\n", pmu->name);
 		return PFM_ERR_INVAL;
 	}
@@ -1708,6 +2253,15 @@ pfm_get_event_info(int idx, pfm_os_t os, pfm_event_info_t *uinfo)
 	/* reset flags */
 	info.is_precise = 0;
 
+	/* compiled event database (LIBPFM_EVENT_DB) */
+	if (pfmlib_find_os(os)
+	    && pfmlib_event_db_event_info(pmu, pidx, os, &info) == PFM_SUCCESS) {
+		info.pmu = pmu->pmu;
+		info.idx = idx;
+		memcpy(uinfo, &info, sz);
+		return PFM_SUCCESS;
+	}
+
 	ret = pmu->get_event_info(pmu, pidx, &info);
 	if (ret != PFM_SUCCESS)
 		return ret;
@@ -1759,6 +2313,19 @@ pfm_get_event_attr_info(int idx, int attr_idx, pfm_os_t os, pfm_event_attr_info_
 	if (!sz)
 		return PFM_ERR_INVAL;
 
+	/* compiled event database (LIBPFM_EVENT_DB) */
+	if (pfmlib_find_os(os)) {
+		memset(&info, 0, sizeof(info));
+		ret = pfmlib_event_db_attr_info(pmu, pidx, attr_idx, os, &info);
+		if (ret == PFM_SUCCESS) {
+			info.size = sz;
+			info.idx  = attr_idx;
+			memcpy(uinfo, &info, sz);
+		}
+		if (ret != PFM_ERR_NOTFOUND)
+			return ret;
+	}
+
 	memset(&e, 0, sizeof(e));
 	e.event = pidx;
 	e.osid  = os;
@@ -1822,6 +2389,9 @@ pfm_get_pmu_info(pfm_pmu_t pmuid, pfm_pmu_info_t *uinfo)
 	if (!pmu)
 		return PFM_ERR_NOTSUPP;
 
+	/* event count and first event may depend on pmu_init() */
+	pfmlib_pmu_ready(pmu);
+
 	info.name = pmu->name;
 	info.desc = pmu->desc;
 	info.pmu  = pmuid;
@@ -1854,6 +2424,16 @@ pfm_get_pmu_info(pfm_pmu_t pmuid, pfm_pmu_info_t *uinfo)
 	return PFM_SUCCESS;
 }
 
+/*
+ * i-th supported PMU, initialized or not, NULL past the last one.
+ * Used by build tools linked with the library (gen_event_hash.c)
+ */
+pfmlib_pmu_t *
+pfmlib_get_pmu_by_idx(int i)
+{
+	return i >= 0 && i < PFMLIB_NUM_PMUS ? pfmlib_pmus[i] : NULL;
+}
+
 pfmlib_pmu_t *
 pfmlib_get_pmu_by_type(pfm_pmu_type_t t)
 {
@@ -1892,16 +2472,52 @@ pfmlib_sort_attr(pfmlib_event_desc_t *e)
 	qsort(e->attrs, e->nattrs, sizeof(pfmlib_attr_t), pfmlib_compare_attr_id);
 }
 
+/*
+ * copy encoding in e->codes to user, allocating the codes array if needed
+ * fstr is handed over to the user on success, freed otherwise
+ */
+static int
+pfmlib_raw_pmu_copy_codes(pfmlib_event_desc_t *e, pfm_pmu_encode_arg_t *arg,
+			  pfm_pmu_encode_arg_t *uarg, size_t sz, char *fstr)
+{
+	int i;
+
+	if (arg->codes == NULL) {
+		arg->codes = pfmlib_event_alloc(e, sizeof(uint64_t) * e->count);
+		if (!arg->codes) {
+			pfmlib_event_free(e, fstr);
+			return PFM_ERR_NOMEM;
+		}
+	} else if (arg->count < e->count) {
+		pfmlib_event_free(e, fstr);
+		return PFM_ERR_TOOSMALL;
+	}
+
+	arg->count = e->count;
+
+	for (i = 0; i < e->count; i++)
+		arg->codes[i] = e->codes[i];
+
+	if (arg->fstr)
+		*arg->fstr = fstr;
+
+	/* copy out results */
+	memcpy(uarg, arg, sz);
+
+	return PFM_SUCCESS;
+}
+
 static int
-pfmlib_raw_pmu_encode(void *this, const char *str, int dfl_plm, void *data)
+pfmlib_raw_pmu_encode(void *this, const char *str, int dfl_plm, void *data, pfmlib_arena_t *arena)
 {
 	pfm_pmu_encode_arg_t arg;
 	pfm_pmu_encode_arg_t *uarg = data;
-
+	pfmlib_encode_key_t key;
 	pfmlib_pmu_t *pmu;
 	pfmlib_event_desc_t e;
-	size_t sz = sizeof(arg);
-	int ret, i;
+	size_t csz, sz = sizeof(arg);
+	char *cfstr = NULL;
+	int ret;
 
 	sz = pfmlib_check_struct(uarg, uarg->size, PFM_RAW_ENCODE_ABI0, sz);
 	if (!sz)
@@ -1918,6 +2534,28 @@ pfmlib_raw_pmu_encode(void *this, const char *str, int dfl_plm, void *data)
 
 	e.osid    = PFM_OS_NONE;
 	e.dfl_plm = dfl_plm;
+	e.arena   = arena;
+
+	/*
+	 * the encoding only depends on the string and dfl_plm
+	 */
+	key.str     = str;
+	key.dfl_plm = dfl_plm;
+	key.osid    = PFM_OS_NONE;
+	key.in      = NULL;
+	key.in_sz   = 0;
+
+	/* the cache allocates its entries, not used with an arena */
+	if (!arena) {
+		csz = sizeof(e.codes);
+		ret = pfmlib_encode_cache_get(&key, e.codes, &csz, &arg.idx, NULL, arg.fstr ? &cfstr : NULL);
+		if (ret == PFM_SUCCESS) {
+			e.count = csz / sizeof(uint64_t);
+			return pfmlib_raw_pmu_copy_codes(&e, &arg, uarg, sz, cfstr);
+		}
+		if (ret != PFM_ERR_NOTFOUND)
+			return ret;
+	}
 
 	ret = pfmlib_parse_event(str, &e);
 	if (ret != PFM_SUCCESS)
@@ -1939,35 +2577,16 @@ pfmlib_raw_pmu_encode(void *this, const char *str, int dfl_plm, void *data)
 	 */
 	arg.idx = pfmlib_pidx2idx(e.pmu, e.event);
 
-	if (arg.codes == NULL) {
-		ret = PFM_ERR_NOMEM;
-		arg.codes = malloc(sizeof(uint64_t) * e.count);
-		if (!arg.codes)
-			goto error_fstr;
-	} else if (arg.count < e.count) {
-		ret = PFM_ERR_TOOSMALL;
-		goto error_fstr;
-	}
-
-	arg.count = e.count;
-
-	for (i = 0; i < e.count; i++)
-		arg.codes[i] = e.codes[i];
-
 	if (arg.fstr) {
-		ret = pfmlib_build_fstr(&e, arg.fstr);
+		ret = pfmlib_build_fstr(&e, &cfstr);
 		if (ret != PFM_SUCCESS)
 			goto error;
 	}
 
-	ret = PFM_SUCCESS;
-
-	/* copy out results */
-	memcpy(uarg, &arg, sz);
+	if (!arena)
+		pfmlib_encode_cache_put(&key, e.codes, e.count * sizeof(uint64_t), arg.idx, -1, cfstr);
 
-error_fstr:
-	if (ret != PFM_SUCCESS)
-		free(arg.fstr);
+	ret = pfmlib_raw_pmu_copy_codes(&e, &arg, uarg, sz, cfstr);
 error:
 	/*
 	 * release resources allocated for event
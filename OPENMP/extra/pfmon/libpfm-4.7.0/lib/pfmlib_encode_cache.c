@@ -0,0 +1,419 @@
+/*
+ * pfmlib_encode_cache.c: memoizing cache of event encodings
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * This file is part of libpfm, a performance monitoring support library for
+ * applications on Linux.
+ *
+ * The OS encoders (PFM_OS_NONE, PFM_OS_PERF_EVENT*) look up the event
+ * string here before parsing it. The key is the string, the default
+ * privilege level mask, the OS layer and whatever part of the caller's
+ * input changes the result (e.g., the perf_event_attr passed in). The
+ * value is a copy of the encoding, the opaque event index, the cpu and
+ * the fully qualified event string, if it was built.
+ *
+ * The cache is disabled by default. Entries are kept in a chained hash
+ * table and in a LRU list, the least recently used entry is dropped when
+ * the bound is reached. All accesses are serialized by one mutex.
+ */
+#include <sys/types.h>
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "pfmlib_priv.h"
+
+typedef struct pfmlib_encode_entry {
+	struct pfmlib_encode_entry	*hnext;		/* hash chain */
+	struct pfmlib_encode_entry	*prev;		/* LRU list, more recent */
+	struct pfmlib_encode_entry	*next;		/* LRU list, less recent */
+	unsigned int			hash;
+	int				dfl_plm;
+	pfm_os_t			osid;
+	int				idx;		/* opaque event identifier */
+	int				cpu;		/* OS specific, -1 if none */
+	size_t				in_sz;
+	size_t				out_sz;
+	void				*in;		/* points into data[] */
+	char				*str;		/* points into data[] */
+	char				*fstr;		/* points into data[], NULL if not built */
+	uint64_t			data[];		/* out, in, str, fstr */
+} pfmlib_encode_entry_t;
+
+static struct {
+	pthread_mutex_t		lock;
+	pfmlib_encode_entry_t	**buckets;
+	pfmlib_encode_entry_t	*head;		/* most recently used */
+	pfmlib_encode_entry_t	*tail;		/* least recently used */
+	unsigned int		mask;		/* number of buckets - 1 */
+	int			max_entries;	/* 0 = disabled */
+	int			nentries;
+	uint64_t		hits;
+	uint64_t		misses;
+	uint64_t		evictions;
+} ecache = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+#define ecache_enabled() __atomic_load_n(&ecache.max_entries, __ATOMIC_RELAXED)
+
+#define ALIGN8(x)	(((x) + 7) & ~(size_t)7)
+
+static unsigned int
+ecache_hash(const pfmlib_encode_key_t *k)
+{
+	const unsigned char *p;
+	unsigned int h = 2166136261U;
+	size_t i;
+
+	for (p = (const unsigned char *)k->str; *p; p++)
+		h = (h ^ *p) * 16777619U;
+
+	h = (h ^ (unsigned int)k->dfl_plm) * 16777619U;
+	h = (h ^ (unsigned int)k->osid) * 16777619U;
+
+	for (i = 0, p = k->in; i < k->in_sz; i++)
+		h = (h ^ p[i]) * 16777619U;
+
+	return h;
+}
+
+static inline int
+ecache_match(const pfmlib_encode_entry_t *e, const pfmlib_encode_key_t *k, unsigned int h)
+{
+	return e->hash == h
+	    && e->dfl_plm == k->dfl_plm
+	    && e->osid == k->osid
+	    && e->in_sz == k->in_sz
+	    && !strcmp(e->str, k->str)
+	    && (!k->in_sz || !memcmp(e->in, k->in, k->in_sz));
+}
+
+static void
+ecache_lru_unlink(pfmlib_encode_entry_t *e)
+{
+	if (e->prev)
+		e->prev->next = e->next;
+	else
+		ecache.head = e->next;
+
+	if (e->next)
+		e->next->prev = e->prev;
+	else
+		ecache.tail = e->prev;
+}
+
+static void
+ecache_lru_push(pfmlib_encode_entry_t *e)
+{
+	e->prev = NULL;
+	e->next = ecache.head;
+	if (ecache.head)
+		ecache.head->prev = e;
+	else
+		ecache.tail = e;
+	ecache.head = e;
+}
+
+static pfmlib_encode_entry_t *
+ecache_find(const pfmlib_encode_key_t *k, unsigned int h)
+{
+	pfmlib_encode_entry_t *e;
+
+	for (e = ecache.buckets[h & ecache.mask]; e; e = e->hnext)
+		if (ecache_match(e, k, h))
+			return e;
+	return NULL;
+}
+
+static void
+ecache_remove(pfmlib_encode_entry_t *e)
+{
+	pfmlib_encode_entry_t **pp;
+
+	for (pp = ecache.buckets + (e->hash & ecache.mask); *pp != e; pp = &(*pp)->hnext)
+		;
+	*pp = e->hnext;
+
+	ecache_lru_unlink(e);
+	ecache.nentries--;
+	free(e);
+}
+
+static void
+ecache_flush(void)
+{
+	pfmlib_encode_entry_t *e, *n;
+
+	for (e = ecache.head; e; e = n) {
+		n = e->next;
+		free(e);
+	}
+	ecache.head = ecache.tail = NULL;
+	ecache.nentries = 0;
+
+	if (ecache.buckets)
+		memset(ecache.buckets, 0, (ecache.mask + 1) * sizeof(*ecache.buckets));
+}
+
+/*
+ * look up an encoding
+ * out: buffer of *out_sz bytes, receives the encoding, *out_sz updated
+ * cpu: may be NULL
+ * fstr: if not NULL, receives a copy of the fully qualified string, entries
+ *       without one do not match
+ * return:
+ * 	PFM_SUCCESS: hit
+ * 	PFM_ERR_NOTFOUND: miss or cache disabled
+ * 	PFM_ERR_NOMEM: fstr cannot be allocated
+ */
+int
+pfmlib_encode_cache_get(const pfmlib_encode_key_t *k, void *out, size_t *out_sz,
+			int *idx, int *cpu, char **fstr)
+{
+	pfmlib_encode_entry_t *e;
+	unsigned int h;
+	char *s = NULL;
+	int ret = PFM_ERR_NOTFOUND;
+
+	if (!ecache_enabled())
+		return PFM_ERR_NOTFOUND;
+
+	h = ecache_hash(k);
+
+	pthread_mutex_lock(&ecache.lock);
+
+	/* cache may have been disabled meanwhile */
+	if (!ecache.max_entries)
+		goto done;
+
+	e = ecache_find(k, h);
+	if (!e || e->out_sz > *out_sz || (fstr && !e->fstr)) {
+		ecache.misses++;
+		goto done;
+	}
+
+	if (fstr) {
+		s = strdup(e->fstr);
+		if (!s) {
+			ret = PFM_ERR_NOMEM;
+			goto done;
+		}
+		*fstr = s;
+	}
+	memcpy(out, e->data, e->out_sz);
+	*out_sz = e->out_sz;
+	*idx = e->idx;
+	if (cpu)
+		*cpu = e->cpu;
+
+	if (e != ecache.head) {
+		ecache_lru_unlink(e);
+		ecache_lru_push(e);
+	}
+	ecache.hits++;
+	ret = PFM_SUCCESS;
+done:
+	pthread_mutex_unlock(&ecache.lock);
+	return ret;
+}
+
+/*
+ * record an encoding, replacing any entry with the same key
+ * failures are silent, the next lookup simply misses
+ */
+void
+pfmlib_encode_cache_put(const pfmlib_encode_key_t *k, const void *out, size_t out_sz,
+			int idx, int cpu, const char *fstr)
+{
+	pfmlib_encode_entry_t *e, *old;
+	size_t slen, flen, sz;
+	unsigned int h;
+	char *p;
+
+	if (!ecache_enabled())
+		return;
+
+	slen = strlen(k->str) + 1;
+	flen = fstr ? strlen(fstr) + 1 : 0;
+	sz = ALIGN8(out_sz) + ALIGN8(k->in_sz) + slen + flen;
+
+	e = malloc(sizeof(*e) + sz);
+	if (!e)
+		return;
+
+	h = ecache_hash(k);
+
+	e->hash = h;
+	e->dfl_plm = k->dfl_plm;
+	e->osid = k->osid;
+	e->idx = idx;
+	e->cpu = cpu;
+	e->out_sz = out_sz;
+	e->in_sz = k->in_sz;
+
+	p = (char *)e->data;
+	memcpy(p, out, out_sz);
+	p += ALIGN8(out_sz);
+
+	e->in = p;
+	if (k->in_sz)
+		memcpy(p, k->in, k->in_sz);
+	p += ALIGN8(k->in_sz);
+
+	e->str = p;
+	memcpy(p, k->str, slen);
+	p += slen;
+
+	e->fstr = NULL;
+	if (fstr) {
+		e->fstr = p;
+		memcpy(p, fstr, flen);
+	}
+
+	pthread_mutex_lock(&ecache.lock);
+
+	if (!ecache.max_entries) {
+		pthread_mutex_unlock(&ecache.lock);
+		free(e);
+		return;
+	}
+
+	old = ecache_find(k, h);
+	if (old)
+		ecache_remove(old);
+
+	if (ecache.nentries >= ecache.max_entries) {
+		ecache_remove(ecache.tail);
+		ecache.evictions++;
+	}
+
+	e->hnext = ecache.buckets[h & ecache.mask];
+	ecache.buckets[h & ecache.mask] = e;
+	ecache_lru_push(e);
+	ecache.nentries++;
+
+	pthread_mutex_unlock(&ecache.lock);
+}
+
+/*
+ * resize the cache to max_entries, 0 disables it
+ * entries are dropped, statistics are kept
+ */
+int
+pfmlib_encode_cache_set(int max_entries)
+{
+	pfmlib_encode_entry_t **b = NULL;
+	unsigned int n = 16;
+
+	if (max_entries < 0)
+		return PFM_ERR_INVAL;
+
+	if (max_entries) {
+		while (n < (unsigned int)max_entries && n < (1U << 20))
+			n <<= 1;
+		b = calloc(n, sizeof(*b));
+		if (!b)
+			return PFM_ERR_NOMEM;
+	}
+
+	pthread_mutex_lock(&ecache.lock);
+
+	ecache_flush();
+	free(ecache.buckets);
+
+	ecache.buckets = b;
+	ecache.mask = max_entries ? n - 1 : 0;
+	__atomic_store_n(&ecache.max_entries, max_entries, __ATOMIC_RELAXED);
+
+	pthread_mutex_unlock(&ecache.lock);
+
+	DPRINT("encode cache: %d entries, %u buckets\n", max_entries, max_entries ? n : 0);
+
+	return PFM_SUCCESS;
+}
+
+/*
+ * called from pfm_terminate(): event identifiers may change on the next
+ * pfm_initialize(), so disable the cache and reset its statistics
+ */
+void
+pfmlib_encode_cache_fini(void)
+{
+	pfmlib_encode_cache_set(0);
+
+	pthread_mutex_lock(&ecache.lock);
+	ecache.hits = ecache.misses = ecache.evictions = 0;
+	pthread_mutex_unlock(&ecache.lock);
+}
+
+pfm_err_t
+pfm_set_encode_cache(int max_entries)
+{
+	if (PFMLIB_INITIALIZED() == 0)
+		return PFM_ERR_NOINIT;
+
+	return pfmlib_encode_cache_set(max_entries);
+}
+
+pfm_err_t
+pfm_flush_encode_cache(void)
+{
+	if (PFMLIB_INITIALIZED() == 0)
+		return PFM_ERR_NOINIT;
+
+	pthread_mutex_lock(&ecache.lock);
+	ecache_flush();
+	pthread_mutex_unlock(&ecache.lock);
+
+	return PFM_SUCCESS;
+}
+
+pfm_err_t
+pfm_get_encode_cache_info(pfm_encode_cache_info_t *uinfo)
+{
+	pfm_encode_cache_info_t info;
+	size_t sz = sizeof(info);
+
+	if (PFMLIB_INITIALIZED() == 0)
+		return PFM_ERR_NOINIT;
+
+	if (!uinfo)
+		return PFM_ERR_INVAL;
+
+	sz = pfmlib_check_struct(uinfo, uinfo->size, PFM_ENCODE_CACHE_INFO_ABI0, sz);
+	if (!sz)
+		return PFM_ERR_INVAL;
+
+	memset(&info, 0, sizeof(info));
+
+	info.size = sz;
+
+	pthread_mutex_lock(&ecache.lock);
+	info.max_entries = ecache.max_entries;
+	info.nentries    = ecache.nentries;
+	info.hits        = ecache.hits;
+	info.misses      = ecache.misses;
+	info.evictions   = ecache.evictions;
+	pthread_mutex_unlock(&ecache.lock);
+
+	memcpy(uinfo, &info, sz);
+
+	return PFM_SUCCESS;
+}
@@ -0,0 +1,812 @@
+/*
+ * pfmlib_event_db.c: compiled event database, exported to a file and mapped
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * This file is part of libpfm, a performance monitoring support library for
+ * applications on Linux.
+ *
+ * pfm_export_event_db() saves what pfm_get_event_info() and
+ * pfm_get_event_attr_info() return for every event of the selected PMUs,
+ * for each activated OS layer. When LIBPFM_EVENT_DB names such a file,
+ * pfm_initialize() maps it read-only and both calls answer from the mapping,
+ * the strings they return point into it. Processes using the same file
+ * share its pages.
+ *
+ * File layout, all offsets are from the start of the file:
+ * 	header
+ * 	PMU records
+ * 	per PMU: pidx -> event record map, event records, attribute records
+ * 	string table (NUL terminated strings, deduplicated)
+ *
+ * The file is tied to the library version and to the host it was exported
+ * on. The header is checked when the file is mapped, each PMU record is
+ * checked against the PMU tables (number of events, first and last events)
+ * on first use. Anything which does not match is served from the tables.
+ * PMUs which add events at runtime (resolve_event) are not exported.
+ */
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/param.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "pfmlib_priv.h"
+
+#define PFMLIB_DB_MAGIC		"libpfmdb"
+#define PFMLIB_DB_VERSION	1
+#define PFMLIB_DB_BYTE_ORDER	0x01020304
+#define PFMLIB_DB_MAX_OS	4	/* room in event records, >= PFM_OS_MAX */
+#define PFMLIB_DB_ALIGN		sizeof(uint64_t)
+#define PFMLIB_DB_NOSTR		0xffffffffU	/* NULL string */
+#define PFMLIB_DB_NOATTR	0xffffffffU	/* event info not exported for the OS */
+
+#define PFMLIB_DB_FL_PRECISE	0x1
+#define PFMLIB_DB_FL_DFL	0x2
+
+typedef struct {
+	char		magic[8];	/* PFMLIB_DB_MAGIC, not NUL terminated */
+	uint32_t	version;	/* PFMLIB_DB_VERSION */
+	uint32_t	byte_order;	/* PFMLIB_DB_BYTE_ORDER */
+	uint32_t	lib_version;	/* LIBPFM_VERSION */
+	uint32_t	nos;		/* PFM_OS_MAX */
+	uint32_t	os_mask;	/* exported OS layers */
+	uint32_t	npmus;		/* number of PMU records */
+	uint64_t	size;		/* file size */
+	uint64_t	pmus;		/* offset of PMU records */
+	uint64_t	strs;		/* offset of string table */
+	uint64_t	strs_size;	/* size of string table */
+} pfmlib_db_hdr_t;
+
+typedef struct {
+	uint32_t	pmu;		/* pfm_pmu_t */
+	uint32_t	nevents;	/* number of events, as pfm_get_pmu_info() */
+	uint32_t	first_pidx;	/* first event */
+	uint32_t	first_name;
+	uint32_t	last_pidx;	/* last event */
+	uint32_t	last_name;
+	uint32_t	nslots;		/* entries in map */
+	uint32_t	nevt;		/* event records */
+	uint32_t	nattr;		/* attribute records */
+	uint32_t	reserved;
+	uint64_t	map;		/* offset of int32_t map[nslots], -1 = no event */
+	uint64_t	events;		/* offset of event records */
+	uint64_t	attrs;		/* offset of attribute records */
+} pfmlib_db_pmu_t;
+
+typedef struct {
+	uint64_t	code;
+	uint32_t	name;		/* string table offsets */
+	uint32_t	desc;
+	uint32_t	equiv;
+	uint32_t	dtype;
+	uint32_t	flags;		/* PFMLIB_DB_FL_PRECISE */
+	uint32_t	nattrs[PFMLIB_DB_MAX_OS];	/* per OS, PFMLIB_DB_NOATTR if none */
+	uint32_t	attrs[PFMLIB_DB_MAX_OS];	/* per OS, first attribute record */
+	uint32_t	reserved;
+} pfmlib_db_event_t;
+
+typedef struct {
+	uint64_t	code;
+	uint64_t	dfl_val64;
+	uint32_t	name;		/* string table offsets */
+	uint32_t	desc;
+	uint32_t	equiv;
+	uint32_t	type;
+	uint32_t	ctrl;
+	uint32_t	flags;		/* PFMLIB_DB_FL_DFL, PFMLIB_DB_FL_PRECISE */
+} pfmlib_db_attr_t;
+
+/*
+ * mapped database
+ */
+static struct {
+	const char		*base;
+	size_t			size;
+	const char		*strs;
+	size_t			strs_size;
+	unsigned int		os_mask;
+	const pfmlib_db_pmu_t	*pmus[PFM_PMU_MAX];	/* NULL if not in the file */
+	int			state[PFM_PMU_MAX];	/* 0: not checked, 1: matches, -1: does not */
+} pfmlib_db;
+
+/*
+ * growing buffer, used to build the file
+ */
+typedef struct {
+	char	*buf;
+	size_t	len;
+	size_t	max;
+} pfmlib_db_buf_t;
+
+typedef struct {
+	pfmlib_db_buf_t	data;	/* maps, events, attributes */
+	pfmlib_db_buf_t	strs;	/* string table */
+	uint32_t	*hash;	/* string table offset + 1, 0 = free slot */
+	size_t		nhash;	/* power of 2 */
+	size_t		nstrs;	/* strings in hash */
+	size_t		base;	/* file offset of data */
+	unsigned int	os_mask;	/* OS layers seen */
+} pfmlib_db_out_t;
+
+/*
+ * true if n elements of sz bytes at off fit in a file of size bytes
+ */
+static inline int
+pfmlib_db_range(uint64_t off, uint64_t n, size_t sz, uint64_t size)
+{
+	if (off > size || (off % PFMLIB_DB_ALIGN))
+		return 0;
+	return n <= (size - off) / sz;
+}
+
+static inline int
+pfmlib_db_getstr(uint32_t off, const char **s)
+{
+	if (off == PFMLIB_DB_NOSTR) {
+		*s = NULL;
+		return 1;
+	}
+	/* the string table is NUL terminated (checked at load) */
+	if (off >= pfmlib_db.strs_size)
+		return 0;
+	*s = pfmlib_db.strs + off;
+	return 1;
+}
+
+static const char *
+pfmlib_db_pmu_event_name(pfmlib_pmu_t *pmu, int pidx)
+{
+	pfm_event_info_t info;
+
+	memset(&info, 0, sizeof(info));
+	if (pmu->get_event_info(pmu, pidx, &info) != PFM_SUCCESS)
+		return NULL;
+	return info.name;
+}
+
+/*
+ * compare a PMU record with the tables, first and last
+ * events and number of events must be the same
+ */
+static int
+pfmlib_db_check_pmu(pfmlib_pmu_t *pmu, const pfmlib_db_pmu_t *p)
+{
+	const char *s, *name;
+	int first, last, pidx, n;
+
+	if (pmu->resolve_event)
+		return 0;
+
+	n = pmu->get_num_events ? pmu->get_num_events(pmu) : pmu->pme_count;
+	if (n < 0 || (uint32_t)n != p->nevents)
+		return 0;
+
+	first = pmu->get_event_first(pmu);
+	if (first < 0 || (uint32_t)first != p->first_pidx)
+		return 0;
+
+	for (last = pidx = first; pidx != -1; pidx = pmu->get_event_next(pmu, pidx))
+		last = pidx;
+	if ((uint32_t)last != p->last_pidx)
+		return 0;
+
+	name = pfmlib_db_pmu_event_name(pmu, first);
+	if (!name || !pfmlib_db_getstr(p->first_name, &s) || !s || strcmp(s, name))
+		return 0;
+
+	name = pfmlib_db_pmu_event_name(pmu, last);
+	if (!name || !pfmlib_db_getstr(p->last_name, &s) || !s || strcmp(s, name))
+		return 0;
+
+	return 1;
+}
+
+/*
+ * event record for pidx, NULL if it must come from the tables
+ */
+static const pfmlib_db_event_t *
+pfmlib_db_event(pfmlib_pmu_t *pmu, int pidx, pfm_os_t os, const pfmlib_db_pmu_t **pp)
+{
+	const pfmlib_db_pmu_t *p;
+	const pfmlib_db_event_t *ev;
+	const int32_t *map;
+	int state, i;
+
+	if (!pfmlib_db.base || !(pfmlib_db.os_mask & (1U << os)))
+		return NULL;
+
+	p = pfmlib_db.pmus[pmu->pmu];
+	if (!p)
+		return NULL;
+
+	state = __atomic_load_n(&pfmlib_db.state[pmu->pmu], __ATOMIC_ACQUIRE);
+	if (!state) {
+		/* concurrent checks compute the same result */
+		state = pfmlib_db_check_pmu(pmu, p) ? 1 : -1;
+		__atomic_store_n(&pfmlib_db.state[pmu->pmu], state, __ATOMIC_RELEASE);
+		if (state < 0)
+			DPRINT("event db: %s does not match the PMU tables, ignored\n", pmu->name);
+	}
+	if (state < 0)
+		return NULL;
+
+	if (pidx < 0 || (uint32_t)pidx >= p->nslots)
+		return NULL;
+
+	map = (const int32_t *)(pfmlib_db.base + p->map);
+	i = map[pidx];
+	if (i < 0 || (uint32_t)i >= p->nevt)
+		return NULL;
+
+	ev = (const pfmlib_db_event_t *)(pfmlib_db.base + p->events) + i;
+
+	if (ev->nattrs[os] == PFMLIB_DB_NOATTR)
+		return NULL;
+
+	if (ev->attrs[os] > p->nattr || ev->nattrs[os] > p->nattr - ev->attrs[os])
+		return NULL;
+
+	*pp = p;
+	return ev;
+}
+
+/*
+ * fill info (except size, pmu, idx) from the database
+ * return PFM_ERR_NOTFOUND if the tables must be used
+ */
+int
+pfmlib_event_db_event_info(pfmlib_pmu_t *pmu, int pidx, pfm_os_t os, pfm_event_info_t *info)
+{
+	const pfmlib_db_event_t *ev;
+	const pfmlib_db_pmu_t *p;
+
+	ev = pfmlib_db_event(pmu, pidx, os, &p);
+	if (!ev)
+		return PFM_ERR_NOTFOUND;
+
+	if (!pfmlib_db_getstr(ev->name, &info->name)
+	    || !pfmlib_db_getstr(ev->desc, &info->desc)
+	    || !pfmlib_db_getstr(ev->equiv, &info->equiv))
+		return PFM_ERR_NOTFOUND;
+
+	info->code       = ev->code;
+	info->dtype      = ev->dtype;
+	info->nattrs     = ev->nattrs[os];
+	info->is_precise = !!(ev->flags & PFMLIB_DB_FL_PRECISE);
+
+	return PFM_SUCCESS;
+}
+
+/*
+ * fill info (except size, idx) from the database
+ * return PFM_ERR_NOTFOUND if the tables must be used
+ */
+int
+pfmlib_event_db_attr_info(pfmlib_pmu_t *pmu, int pidx, int attr_idx, pfm_os_t os, pfm_event_attr_info_t *info)
+{
+	const pfmlib_db_event_t *ev;
+	const pfmlib_db_attr_t *a;
+	const pfmlib_db_pmu_t *p;
+
+	ev = pfmlib_db_event(pmu, pidx, os, &p);
+	if (!ev)
+		return PFM_ERR_NOTFOUND;
+
+	if ((uint32_t)attr_idx >= ev->nattrs[os])
+		return PFM_ERR_INVAL;
+
+	a = (const pfmlib_db_attr_t *)(pfmlib_db.base + p->attrs) + ev->attrs[os] + attr_idx;
+
+	if (!pfmlib_db_getstr(a->name, &info->name)
+	    || !pfmlib_db_getstr(a->desc, &info->desc)
+	    || !pfmlib_db_getstr(a->equiv, &info->equiv))
+		return PFM_ERR_NOTFOUND;
+
+	info->code       = a->code;
+	info->type       = a->type;
+	info->ctrl       = a->ctrl;
+	info->dfl_val64  = a->dfl_val64;
+	info->is_dfl     = !!(a->flags & PFMLIB_DB_FL_DFL);
+	info->is_precise = !!(a->flags & PFMLIB_DB_FL_PRECISE);
+
+	return PFM_SUCCESS;
+}
+
+static int
+pfmlib_db_check_hdr(const pfmlib_db_hdr_t *h, size_t size)
+{
+	const pfmlib_db_pmu_t *p;
+	uint32_t i;
+
+	if (memcmp(h->magic, PFMLIB_DB_MAGIC, sizeof(h->magic))) {
+		DPRINT("event db: not an event database\n");
+		return 0;
+	}
+	if (h->version != PFMLIB_DB_VERSION
+	    || h->byte_order != PFMLIB_DB_BYTE_ORDER
+	    || h->lib_version != LIBPFM_VERSION
+	    || h->nos != PFM_OS_MAX) {
+		DPRINT("event db: format v%u, library 0x%x, %u OS, expected v%d, 0x%x, %d OS\n",
+			h->version, h->lib_version, h->nos,
+			PFMLIB_DB_VERSION, LIBPFM_VERSION, PFM_OS_MAX);
+		return 0;
+	}
+	if (h->size != size
+	    || !pfmlib_db_range(h->pmus, h->npmus, sizeof(*p), size)
+	    || !pfmlib_db_range(h->strs, h->strs_size, 1, size)
+	    || !h->strs_size
+	    || pfmlib_db.base[h->strs + h->strs_size - 1] != '\0') {
+		DPRINT("event db: corrupted header\n");
+		return 0;
+	}
+
+	p = (const pfmlib_db_pmu_t *)(pfmlib_db.base + h->pmus);
+	for (i = 0; i < h->npmus; i++, p++) {
+		if (p->pmu >= PFM_PMU_MAX
+		    || pfmlib_db.pmus[p->pmu]
+		    || !pfmlib_db_range(p->map, p->nslots, sizeof(int32_t), size)
+		    || !pfmlib_db_range(p->events, p->nevt, sizeof(pfmlib_db_event_t), size)
+		    || !pfmlib_db_range(p->attrs, p->nattr, sizeof(pfmlib_db_attr_t), size)) {
+			DPRINT("event db: corrupted PMU record %u\n", i);
+			return 0;
+		}
+		pfmlib_db.pmus[p->pmu] = p;
+	}
+	return 1;
+}
+
+void
+pfmlib_event_db_unload(void)
+{
+	if (pfmlib_db.base)
+		munmap((void *)pfmlib_db.base, pfmlib_db.size);
+
+	memset(&pfmlib_db, 0, sizeof(pfmlib_db));
+}
+
+/*
+ * map the database, not an error if it cannot be used
+ */
+void
+pfmlib_event_db_load(const char *path)
+{
+	const pfmlib_db_hdr_t *h;
+	struct stat st;
+	void *addr;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd == -1) {
+		DPRINT("event db: cannot open %s\n", path);
+		return;
+	}
+
+	if (fstat(fd, &st) || st.st_size < (off_t)sizeof(*h)) {
+		DPRINT("event db: %s is too small\n", path);
+		close(fd);
+		return;
+	}
+
+	addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (addr == MAP_FAILED) {
+		DPRINT("event db: cannot map %s\n", path);
+		return;
+	}
+
+	pfmlib_db.base = addr;
+	pfmlib_db.size = st.st_size;
+
+	h = addr;
+	if (!pfmlib_db_check_hdr(h, pfmlib_db.size)) {
+		pfmlib_event_db_unload();
+		return;
+	}
+
+	pfmlib_db.strs      = pfmlib_db.base + h->strs;
+	pfmlib_db.strs_size = h->strs_size;
+	pfmlib_db.os_mask   = h->os_mask;
+
+	__pfm_vbprintf("event db: %s, %u PMUs\n", path, h->npmus);
+}
+
+static int
+pfmlib_db_add(pfmlib_db_buf_t *b, const void *p, size_t sz)
+{
+	size_t max;
+	char *n;
+
+	if (b->len + sz > b->max) {
+		max = b->max ? b->max : 4096;
+		while (max < b->len + sz)
+			max <<= 1;
+		n = realloc(b->buf, max);
+		if (!n)
+			return PFM_ERR_NOMEM;
+		b->buf = n;
+		b->max = max;
+	}
+	if (p)
+		memcpy(b->buf + b->len, p, sz);
+	else
+		memset(b->buf + b->len, 0, sz);
+	b->len += sz;
+	return PFM_SUCCESS;
+}
+
+static int
+pfmlib_db_align(pfmlib_db_buf_t *b)
+{
+	size_t pad = (PFMLIB_DB_ALIGN - (b->len % PFMLIB_DB_ALIGN)) % PFMLIB_DB_ALIGN;
+
+	return pad ? pfmlib_db_add(b, NULL, pad) : PFM_SUCCESS;
+}
+
+static int
+pfmlib_db_grow_hash(pfmlib_db_out_t *o)
+{
+	uint32_t *h, v;
+	size_t i, j, n;
+
+	n = o->nhash ? o->nhash << 1 : 4096;
+	h = calloc(n, sizeof(*h));
+	if (!h)
+		return PFM_ERR_NOMEM;
+
+	for (i = 0; i < o->nhash; i++) {
+		v = o->hash[i];
+		if (!v)
+			continue;
+		j = pfmlib_phash(o->strs.buf + v - 1, 0) & (n - 1);
+		while (h[j])
+			j = (j + 1) & (n - 1);
+		h[j] = v;
+	}
+	free(o->hash);
+	o->hash = h;
+	o->nhash = n;
+	return PFM_SUCCESS;
+}
+
+/*
+ * offset of s in the string table, added if needed
+ */
+static int
+pfmlib_db_str(pfmlib_db_out_t *o, const char *s, uint32_t *off)
+{
+	size_t j, len;
+	uint32_t v;
+	int ret;
+
+	if (!s) {
+		*off = PFMLIB_DB_NOSTR;
+		return PFM_SUCCESS;
+	}
+
+	if (2 * (o->nstrs + 1) > o->nhash) {
+		ret = pfmlib_db_grow_hash(o);
+		if (ret != PFM_SUCCESS)
+			return ret;
+	}
+
+	j = pfmlib_phash(s, 0) & (o->nhash - 1);
+	while ((v = o->hash[j])) {
+		if (!strcmp(o->strs.buf + v - 1, s)) {
+			*off = v - 1;
+			return PFM_SUCCESS;
+		}
+		j = (j + 1) & (o->nhash - 1);
+	}
+
+	len = strlen(s) + 1;
+	if (o->strs.len + len >= PFMLIB_DB_NOSTR)
+		return PFM_ERR_TOOMANY;
+
+	*off = o->strs.len;
+
+	ret = pfmlib_db_add(&o->strs, s, len);
+	if (ret != PFM_SUCCESS)
+		return ret;
+
+	o->hash[j] = *off + 1;
+	o->nstrs++;
+	return PFM_SUCCESS;
+}
+
+static int
+pfmlib_db_export_attrs(pfmlib_db_out_t *o, int idx, pfm_os_t os, int nattrs, pfmlib_db_buf_t *attrs)
+{
+	pfm_event_attr_info_t ainfo;
+	pfmlib_db_attr_t a;
+	int i, ret;
+
+	for (i = 0; i < nattrs; i++) {
+		memset(&ainfo, 0, sizeof(ainfo));
+		ret = pfm_get_event_attr_info(idx, i, os, &ainfo);
+		if (ret != PFM_SUCCESS)
+			return ret;
+
+		memset(&a, 0, sizeof(a));
+		a.code      = ainfo.code;
+		a.dfl_val64 = ainfo.dfl_val64;
+		a.type      = ainfo.type;
+		a.ctrl      = ainfo.ctrl;
+		a.flags     = (ainfo.is_dfl ? PFMLIB_DB_FL_DFL : 0)
+			    | (ainfo.is_precise ? PFMLIB_DB_FL_PRECISE : 0);
+
+		ret = pfmlib_db_str(o, ainfo.name, &a.name);
+		if (ret == PFM_SUCCESS)
+			ret = pfmlib_db_str(o, ainfo.desc, &a.desc);
+		if (ret == PFM_SUCCESS)
+			ret = pfmlib_db_str(o, ainfo.equiv, &a.equiv);
+		if (ret == PFM_SUCCESS)
+			ret = pfmlib_db_add(attrs, &a, sizeof(a));
+		if (ret != PFM_SUCCESS)
+			return ret;
+	}
+	return PFM_SUCCESS;
+}
+
+/*
+ * append map, events and attributes of the PMU to o->data
+ */
+static int
+pfmlib_db_export_pmu(pfmlib_db_out_t *o, pfmlib_pmu_t *pmu, pfmlib_db_pmu_t *rec)
+{
+	pfmlib_db_buf_t events, attrs, pidxs;
+	pfmlib_db_event_t ev, *evs;
+	pfm_pmu_info_t pinfo;
+	pfm_event_info_t info;
+	int32_t *map, *pi;
+	pfm_os_t os;
+	uint32_t i, nslots = 0;
+	int idx, pidx, ret;
+
+	memset(&events, 0, sizeof(events));
+	memset(&attrs, 0, sizeof(attrs));
+	memset(&pidxs, 0, sizeof(pidxs));
+
+	memset(&pinfo, 0, sizeof(pinfo));
+	ret = pfm_get_pmu_info(pmu->pmu, &pinfo);
+	if (ret != PFM_SUCCESS)
+		return ret;
+
+	memset(rec, 0, sizeof(*rec));
+	rec->pmu     = pmu->pmu;
+	rec->nevents = pinfo.nevents;
+
+	for (idx = pinfo.first_event; idx != -1; idx = pfm_get_event_next(idx)) {
+		pidx = idx & PFMLIB_PMU_PIDX_MASK;
+
+		memset(&ev, 0, sizeof(ev));
+
+		for (os = PFM_OS_NONE; os < PFM_OS_MAX; os++) {
+			ev.nattrs[os] = PFMLIB_DB_NOATTR;
+
+			/* PFM_ERR_NOTSUPP: OS layer not activated */
+			memset(&info, 0, sizeof(info));
+			ret = pfm_get_event_info(idx, os, &info);
+			if (ret != PFM_SUCCESS) {
+				if (ret != PFM_ERR_NOTSUPP)
+					DPRINT("event db: %s: no info for event %d, OS %d\n", pmu->name, pidx, os);
+				continue;
+			}
+
+			o->os_mask |= 1U << os;
+			ev.nattrs[os] = info.nattrs;
+			ev.attrs[os] = attrs.len / sizeof(pfmlib_db_attr_t);
+
+			ret = pfmlib_db_export_attrs(o, idx, os, info.nattrs, &attrs);
+			if (ret != PFM_SUCCESS)
+				goto error;
+
+			/* same for all OS */
+			ev.code  = info.code;
+			ev.dtype = info.dtype;
+			ev.flags = info.is_precise ? PFMLIB_DB_FL_PRECISE : 0;
+
+			ret = pfmlib_db_str(o, info.name, &ev.name);
+			if (ret == PFM_SUCCESS)
+				ret = pfmlib_db_str(o, info.desc, &ev.desc);
+			if (ret == PFM_SUCCESS)
+				ret = pfmlib_db_str(o, info.equiv, &ev.equiv);
+			if (ret != PFM_SUCCESS)
+				goto error;
+		}
+
+		if (ev.nattrs[PFM_OS_NONE] == PFMLIB_DB_NOATTR)
+			continue;
+
+		if (events.len == 0) {
+			rec->first_pidx = pidx;
+			rec->first_name = ev.name;
+		}
+		rec->last_pidx = pidx;
+		rec->last_name = ev.name;
+
+		ret = pfmlib_db_add(&events, &ev, sizeof(ev));
+		if (ret == PFM_SUCCESS)
+			ret = pfmlib_db_add(&pidxs, &pidx, sizeof(int32_t));
+		if (ret != PFM_SUCCESS)
+			goto error;
+
+		if ((uint32_t)pidx >= nslots)
+			nslots = pidx + 1;
+	}
+
+	rec->nslots = nslots;
+	rec->nevt   = events.len / sizeof(ev);
+	rec->nattr  = attrs.len / sizeof(pfmlib_db_attr_t);
+
+	/* the fingerprint needs the first and last events */
+	ret = PFM_ERR_NOTSUPP;
+	if (!rec->nevt)
+		goto error;
+
+	ret = pfmlib_db_align(&o->data);
+	if (ret != PFM_SUCCESS)
+		goto error;
+
+	rec->map = o->base + o->data.len;
+	ret = pfmlib_db_add(&o->data, NULL, nslots * sizeof(int32_t));
+	if (ret != PFM_SUCCESS)
+		goto error;
+
+	map = (int32_t *)(o->data.buf + rec->map - o->base);
+	pi  = (int32_t *)pidxs.buf;
+	evs = (pfmlib_db_event_t *)events.buf;
+
+	for (i = 0; i < nslots; i++)
+		map[i] = -1;
+	for (i = 0; i < rec->nevt; i++)
+		map[pi[i]] = i;
+
+	ret = pfmlib_db_align(&o->data);
+	if (ret != PFM_SUCCESS)
+		goto error;
+
+	rec->events = o->base + o->data.len;
+	ret = pfmlib_db_add(&o->data, evs, events.len);
+	if (ret != PFM_SUCCESS)
+		goto error;
+
+	rec->attrs = o->base + o->data.len;
+	ret = pfmlib_db_add(&o->data, attrs.buf, attrs.len);
+error:
+	free(events.buf);
+	free(attrs.buf);
+	free(pidxs.buf);
+	return ret;
+}
+
+/*
+ * PMU is exported: requested or, without a list, detected
+ */
+static int
+pfmlib_db_selected(pfmlib_pmu_t *pmu, const pfm_pmu_t *pmus, int npmus)
+{
+	int i;
+
+	if (!pmus)
+		return !!(pmu->flags & PFMLIB_PMU_FL_ACTIVE);
+
+	for (i = 0; i < npmus; i++)
+		if (pmus[i] == pmu->pmu)
+			return 1;
+	return 0;
+}
+
+int
+pfm_export_event_db(const char *path, const pfm_pmu_t *pmus, int npmus)
+{
+	pfmlib_db_out_t o;
+	pfmlib_db_hdr_t hdr;
+	pfmlib_db_pmu_t *recs = NULL;
+	pfmlib_pmu_t *pmu;
+	char tmp[MAXPATHLEN];
+	FILE *fp;
+	int i, n = 0, ret;
+
+	if (PFMLIB_INITIALIZED() == 0)
+		return PFM_ERR_NOINIT;
+
+	if (!path || npmus < 0 || (!pmus && npmus))
+		return PFM_ERR_INVAL;
+
+	if (snprintf(tmp, MAXPATHLEN, "%s.%d", path, (int)getpid()) >= MAXPATHLEN)
+		return PFM_ERR_INVAL;
+
+	memset(&o, 0, sizeof(o));
+
+	recs = calloc(PFM_PMU_MAX, sizeof(*recs));
+	if (!recs)
+		return PFM_ERR_NOMEM;
+
+	for (i = 0; (pmu = pfmlib_get_pmu_by_idx(i)); i++) {
+		if (!pfmlib_db_selected(pmu, pmus, npmus))
+			continue;
+		if (pmu->resolve_event) {
+			DPRINT("event db: %s adds events at runtime, not exported\n", pmu->name);
+			continue;
+		}
+		n++;
+	}
+	o.base = sizeof(hdr) + n * sizeof(*recs);
+
+	n = 0;
+	for (i = 0; (pmu = pfmlib_get_pmu_by_idx(i)); i++) {
+		if (!pfmlib_db_selected(pmu, pmus, npmus) || pmu->resolve_event)
+			continue;
+
+		ret = pfmlib_db_export_pmu(&o, pmu, recs + n);
+		if (ret == PFM_SUCCESS)
+			n++;
+		else if (pmus || ret != PFM_ERR_NOTSUPP)
+			goto error;
+	}
+
+	ret = pfmlib_db_align(&o.data);
+	if (ret == PFM_SUCCESS && !o.strs.len)
+		ret = pfmlib_db_add(&o.strs, "", 1);
+	if (ret != PFM_SUCCESS)
+		goto error;
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, PFMLIB_DB_MAGIC, sizeof(hdr.magic));
+	hdr.version     = PFMLIB_DB_VERSION;
+	hdr.byte_order  = PFMLIB_DB_BYTE_ORDER;
+	hdr.lib_version = LIBPFM_VERSION;
+	hdr.nos         = PFM_OS_MAX;
+	hdr.os_mask     = o.os_mask;
+	hdr.npmus       = n;
+	hdr.pmus        = sizeof(hdr);
+	hdr.strs        = o.base + o.data.len;
+	hdr.strs_size   = o.strs.len;
+	hdr.size        = hdr.strs + hdr.strs_size;
+
+	ret = PFM_ERR_NOTSUPP;
+	fp = fopen(tmp, "w");
+	if (!fp) {
+		DPRINT("event db: cannot create %s\n", tmp);
+		goto error;
+	}
+
+	/* PMUs skipped on error leave empty records, data offsets do not change */
+	fwrite(&hdr, sizeof(hdr), 1, fp);
+	fwrite(recs, sizeof(*recs), (o.base - sizeof(hdr)) / sizeof(*recs), fp);
+	fwrite(o.data.buf, 1, o.data.len, fp);
+	fwrite(o.strs.buf, 1, o.strs.len, fp);
+
+	if (ferror(fp) | fclose(fp) || rename(tmp, path)) {
+		DPRINT("event db: cannot write %s\n", path);
+		unlink(tmp);
+		goto error;
+	}
+	ret = PFM_SUCCESS;
+error:
+	free(recs);
+	free(o.data.buf);
+	free(o.strs.buf);
+	free(o.hash);
+	return ret;
+}
@@ -0,0 +1,295 @@
+/*
+ * pfmlib_event_groups.c: pack events into groups which fit the PMU counters
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * This file is part of libpfm, a performance monitoring support library for
+ * applications on Linux.
+ *
+ * Each event is parsed and encoded as for PFM_OS_NONE, then the PMU tells
+ * which counters it can use (get_event_cntmsk(), all generic counters by
+ * default). A group holds events of a single PMU which can all be assigned
+ * a different counter at the same time, i.e., a bipartite matching of events
+ * to counters. Events are placed most constrained first, each in the first
+ * group where an augmenting path exists, or in a new group. This is the
+ * usual first-fit heuristic, it does not guarantee the minimum number of
+ * groups in all cases.
+ *
+ * Events of PMUs without counters (software events, tracepoints, ...) do
+ * not use a counter, they are put in the first group. The generic hardware
+ * events of the perf PMU get the generic counters of the default core PMU
+ * but are still grouped apart from the events of the core PMU itself.
+ */
+#include <sys/types.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "pfmlib_priv.h"
+
+#define PFMLIB_MAX_CNTRS	64	/* bits in a counter mask */
+
+typedef struct {
+	pfmlib_pmu_t	*pmu;
+	uint64_t	cntmsk;
+	int		idx;
+	int		group;
+	int		counter;
+	int		pmu_rank;	/* order of first appearance of the PMU */
+	int		weight;		/* number of usable counters */
+	int		pos;		/* position in caller's array */
+} pfmlib_grp_evt_t;
+
+typedef struct {
+	pfmlib_pmu_t	*pmu;
+	int		owner[PFMLIB_MAX_CNTRS];	/* event using the counter, or -1 */
+	int		first;		/* lowest position of a member */
+} pfmlib_grp_t;
+
+/*
+ * all the counters of the PMU, bit 32 + n is fixed counter n
+ */
+uint64_t
+pfmlib_pmu_cntmsk(pfmlib_pmu_t *pmu)
+{
+	uint64_t gen = 0, fixed = 0;
+
+	if (pmu->num_cntrs > 0)
+		gen = pmu->num_cntrs >= 32 ? 0xffffffffULL : (1ULL << pmu->num_cntrs) - 1;
+
+	if (pmu->num_fixed_cntrs > 0)
+		fixed = pmu->num_fixed_cntrs >= 32 ? 0xffffffffULL : (1ULL << pmu->num_fixed_cntrs) - 1;
+
+	return gen | (fixed << 32);
+}
+
+static int
+pfmlib_grp_cmp(const void *a, const void *b)
+{
+	const pfmlib_grp_evt_t *x = a, *y = b;
+
+	if (x->pmu_rank != y->pmu_rank)
+		return x->pmu_rank - y->pmu_rank;
+	if (x->weight != y->weight)
+		return x->weight - y->weight;
+	return x->pos - y->pos;
+}
+
+static int
+pfmlib_grp_first_cmp(const void *a, const void *b)
+{
+	const pfmlib_grp_t *x = a, *y = b;
+
+	return x->first - y->first;
+}
+
+/*
+ * find a counter for event i in group g, moving other events
+ * of the group to other counters if needed (augmenting path)
+ */
+static int
+pfmlib_grp_augment(pfmlib_grp_evt_t *ev, pfmlib_grp_t *g, int i, uint64_t *seen)
+{
+	unsigned int c;
+
+	/* pfmlib_for_each_bit() does not handle bits above 31 */
+	for (c = 0; c < PFMLIB_MAX_CNTRS; c++) {
+		if (!(ev[i].cntmsk & (1ULL << c)) || (*seen & (1ULL << c)))
+			continue;
+		*seen |= 1ULL << c;
+
+		if (g->owner[c] == -1 || pfmlib_grp_augment(ev, g, g->owner[c], seen)) {
+			g->owner[c] = i;
+			ev[i].counter = c;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * parse and encode the event, return what it needs
+ */
+static int
+pfmlib_grp_event(const char *str, int dfl_plm, pfm_os_t osid, pfmlib_grp_evt_t *ev)
+{
+	pfmlib_event_desc_t e;
+	pfmlib_pmu_t *pmu;
+	int ret;
+
+	memset(&e, 0, sizeof(e));
+
+	e.osid    = osid;
+	e.dfl_plm = dfl_plm;
+
+	ret = pfmlib_parse_event(str, &e);
+	if (ret != PFM_SUCCESS)
+		return ret;
+
+	pmu = e.pmu;
+
+	/* adds the default unit masks, which may carry counter masks */
+	if (!pmu->get_event_encoding[PFM_OS_NONE]) {
+		DPRINT("PMU %s does not support PFM_OS_NONE\n", pmu->name);
+		ret = PFM_ERR_NOTSUPP;
+		goto error;
+	}
+	ret = pmu->get_event_encoding[PFM_OS_NONE](pmu, &e);
+	if (ret != PFM_SUCCESS)
+		goto error;
+
+	ev->pmu = pmu;
+	ev->idx = pfmlib_pidx2idx(pmu, e.event);
+
+	if (pmu->get_event_cntmsk)
+		ev->cntmsk = pmu->get_event_cntmsk(pmu, &e);
+	else
+		ev->cntmsk = pfmlib_pmu_cntmsk(pmu) & 0xffffffffULL;
+
+	/* the PMU has counters but the event cannot use any */
+	if (!ev->cntmsk && pfmlib_pmu_cntmsk(pmu)) {
+		DPRINT("%s: no counter available\n", str);
+		ret = PFM_ERR_NOTSUPP;
+	}
+error:
+	pfmlib_release_event(&e);
+	return ret;
+}
+
+int
+pfm_get_event_groups(pfm_event_group_arg_t *uevents, int nevents, int dfl_plm, pfm_os_t osid, int *ngroups)
+{
+	pfm_event_group_arg_t arg, *uarg;
+	pfmlib_grp_evt_t *ev = NULL;
+	pfmlib_grp_t *grp = NULL;
+	pfmlib_pmu_t **pmus = NULL;
+	uint64_t seen;
+	size_t sz = sizeof(arg), usz;
+	int i, j, g, npmus = 0, ng = 0, nfree = 0;
+	int ret = PFM_ERR_NOMEM;
+
+	if (PFMLIB_INITIALIZED() == 0)
+		return PFM_ERR_NOINIT;
+
+	if (!(uevents && ngroups) || nevents <= 0)
+		return PFM_ERR_INVAL;
+
+	if (dfl_plm & ~(PFM_PLM_ALL))
+		return PFM_ERR_INVAL;
+
+	/* all elements have the size of the first one */
+	usz = uevents->size ? uevents->size : PFM_EVENT_GROUP_ABI0;
+	sz = pfmlib_check_struct(uevents, uevents->size, PFM_EVENT_GROUP_ABI0, sz);
+	if (!sz)
+		return PFM_ERR_INVAL;
+
+	ev   = calloc(nevents, sizeof(*ev));
+	grp  = malloc(nevents * sizeof(*grp));
+	pmus = malloc(nevents * sizeof(*pmus));
+	if (!(ev && grp && pmus))
+		goto error;
+
+	for (i = 0; i < nevents; i++) {
+		uarg = (pfm_event_group_arg_t *)((char *)uevents + i * usz);
+		if (!uarg->str) {
+			ret = PFM_ERR_INVAL;
+			goto error;
+		}
+		ret = pfmlib_grp_event(uarg->str, dfl_plm, osid, ev + i);
+		if (ret != PFM_SUCCESS)
+			goto error;
+
+		for (j = 0; j < npmus; j++)
+			if (pmus[j] == ev[i].pmu)
+				break;
+		if (j == npmus)
+			pmus[npmus++] = ev[i].pmu;
+
+		ev[i].pmu_rank = j;
+		ev[i].weight   = pfmlib_popcnt(ev[i].cntmsk & 0xffffffffULL)
+			       + pfmlib_popcnt(ev[i].cntmsk >> 32);
+		ev[i].pos      = i;
+		ev[i].group    = -1;
+		ev[i].counter  = -1;
+	}
+
+	qsort(ev, nevents, sizeof(*ev), pfmlib_grp_cmp);
+
+	for (i = 0; i < nevents; i++) {
+		if (!ev[i].cntmsk) {
+			nfree++;
+			continue;
+		}
+		for (g = 0; g < ng; g++) {
+			if (grp[g].pmu != ev[i].pmu)
+				continue;
+			seen = 0;
+			if (pfmlib_grp_augment(ev, grp + g, i, &seen))
+				break;
+		}
+		if (g == ng) {
+			grp[ng].pmu = ev[i].pmu;
+			grp[ng].first = ev[i].pos;
+			memset(grp[ng].owner, -1, sizeof(grp[ng].owner));
+			seen = 0;
+			pfmlib_grp_augment(ev, grp + ng, i, &seen);
+			ng++;
+		}
+		if (ev[i].pos < grp[g].first)
+			grp[g].first = ev[i].pos;
+	}
+
+	/*
+	 * number the groups in the order of their first event, the
+	 * counters of the members are known from the owners
+	 */
+	qsort(grp, ng, sizeof(*grp), pfmlib_grp_first_cmp);
+	for (g = 0; g < ng; g++)
+		for (j = 0; j < PFMLIB_MAX_CNTRS; j++)
+			if (grp[g].owner[j] != -1) {
+				ev[grp[g].owner[j]].group = g;
+				ev[grp[g].owner[j]].counter = j;
+			}
+
+	if (nfree && !ng)
+		ng = 1;
+
+	for (i = 0; i < nevents; i++) {
+		if (!ev[i].cntmsk)
+			ev[i].group = 0;
+
+		uarg = (pfm_event_group_arg_t *)((char *)uevents + ev[i].pos * usz);
+
+		memset(&arg, 0, sizeof(arg));
+		arg.str     = uarg->str;
+		arg.size    = sz;
+		arg.cntmsk  = ev[i].cntmsk;
+		arg.idx     = ev[i].idx;
+		arg.group   = ev[i].group;
+		arg.counter = ev[i].counter;
+
+		memcpy(uarg, &arg, sz);
+	}
+	*ngroups = ng;
+	ret = PFM_SUCCESS;
+error:
+	free(ev);
+	free(grp);
+	free(pmus);
+	return ret;
+}
@@ -0,0 +1,496 @@
+/*
+ * pfmlib_event_iter.c: streaming enumeration of event strings
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * This file is part of libpfm, a performance monitoring support library for
+ * applications on Linux.
+ *
+ * The iterator returns one event string at a time, nothing is accumulated.
+ * With PFM_ITER_COMBOS, the unit mask sets of an event are visited depth
+ * first, in attribute order, each set extending its parent by one unit mask.
+ * A set is not extended when:
+ * 	- the new unit mask conflicts with the set according to the unit mask
+ * 	  groups of the PMU (get_event_umask_grp()), no encoding is attempted
+ * 	- the encoding fails for any reason other than a missing unit mask
+ * 	- it already has max_umasks unit masks
+ * Conflicts only grow with the set, so no valid combination is lost to the
+ * first two rules. Aliases (equiv) are skipped, they only add duplicates.
+ * An event with more than PFMLIB_ITER_COMBO_MAX unit masks can have
+ * millions of sets (OFFCORE_RESPONSE), so its sets are capped at
+ * PFMLIB_ITER_DEPTH_MAX unit masks whatever max_umasks says.
+ * Combinations of undetected PMUs need LIBPFM_ENCODE_INACTIVE.
+ */
+#include <sys/types.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <regex.h>
+
+#include "pfmlib_priv.h"
+
+#define PFMLIB_ITER_COMBO_MAX	18	/* unit masks combined without a cap */
+#define PFMLIB_ITER_DEPTH_MAX	4	/* cap on sets of larger events */
+
+typedef struct {
+	const char	*name;
+	int		attr;		/* attribute index */
+	int		grp;		/* unit mask group, -1 if unknown */
+	int		flags;		/* PFMLIB_GRP_* */
+} pfmlib_iter_umask_t;
+
+struct pfm_event_iter {
+	regex_t		preg;
+	int		has_preg;
+	int		flags;
+	int		max_umasks;
+	pfm_pmu_t	pmu_filter;
+	pfm_pmu_t	pmu_id;		/* PMU being scanned */
+	pfmlib_pmu_t	*pmu;
+	const char	*pname;
+	int		idx;		/* event being scanned, -1 = next PMU */
+	int		loaded;		/* idx was loaded, move on before loading */
+	int		busy;		/* event has more entries */
+	int		cur;		/* next unit mask (PFM_ITER_UMASKS) */
+	int		plain;		/* plain event not yet visited */
+	int		descend;	/* current set can be extended (combos) */
+	int		depth_max;	/* max size of a set of this event, 0 = none */
+	int		depth;		/* size of the current set */
+	int		numasks;
+	int		max;		/* allocated umask entries */
+	pfmlib_iter_umask_t *um;
+	int		*pos;		/* current set, positions in um[] */
+	int		*sel;		/* current set, attribute indexes */
+	char		*buf;		/* pmu::event[:umask...] */
+	size_t		bufsz;
+	size_t		base;		/* length of pmu::event */
+	char		scratch[PFM_ENCODE_SCRATCH_SIZE];
+};
+
+static int
+pfmlib_iter_pmu_ok(pfm_event_iter_t *it, const pfm_pmu_info_t *pinfo)
+{
+	if (it->pmu_filter != PFM_PMU_NONE)
+		return pinfo->pmu == it->pmu_filter;
+
+	if (pinfo->is_present)
+		return 1;
+
+	/* combinations are checked by encoding them */
+	if ((it->flags & PFM_ITER_COMBOS) && !pfm_cfg.inactive)
+		return 0;
+
+	return !!(it->flags & PFM_ITER_INACTIVE);
+}
+
+/*
+ * move to the first event of the next selected PMU,
+ * return -1 when there are no more PMUs
+ */
+static int
+pfmlib_iter_next_pmu(pfm_event_iter_t *it)
+{
+	pfm_pmu_info_t pinfo;
+	pfmlib_pmu_t *pmu;
+	int i;
+
+	memset(&pinfo, 0, sizeof(pinfo));
+	pinfo.size = sizeof(pinfo);
+
+	while (++it->pmu_id < PFM_PMU_MAX) {
+		if (pfm_get_pmu_info(it->pmu_id, &pinfo) != PFM_SUCCESS)
+			continue;
+		if (!pfmlib_iter_pmu_ok(it, &pinfo) || pinfo.first_event == -1)
+			continue;
+
+		for (i = 0; (pmu = pfmlib_get_pmu_by_idx(i)); i++)
+			if (pmu->pmu == it->pmu_id)
+				break;
+		if (!pmu)
+			continue;
+
+		it->pmu   = pmu;
+		it->pname = pinfo.name;
+		it->idx   = pinfo.first_event;
+		return 0;
+	}
+	return -1;
+}
+
+static int
+pfmlib_iter_grow(pfm_event_iter_t *it, int n, size_t len)
+{
+	void *p;
+
+	if (n > it->max) {
+		p = realloc(it->um, n * sizeof(*it->um));
+		if (!p)
+			return PFM_ERR_NOMEM;
+		it->um = p;
+
+		p = realloc(it->pos, n * sizeof(*it->pos));
+		if (!p)
+			return PFM_ERR_NOMEM;
+		it->pos = p;
+
+		p = realloc(it->sel, n * sizeof(*it->sel));
+		if (!p)
+			return PFM_ERR_NOMEM;
+		it->sel = p;
+
+		it->max = n;
+	}
+	if (len > it->bufsz) {
+		p = realloc(it->buf, len);
+		if (!p)
+			return PFM_ERR_NOMEM;
+		it->buf = p;
+		it->bufsz = len;
+	}
+	return PFM_SUCCESS;
+}
+
+/*
+ * load the name and unit masks of the current event,
+ * return 1 if the event is selected
+ */
+static int
+pfmlib_iter_load(pfm_event_iter_t *it)
+{
+	pfm_event_attr_info_t ainfo;
+	pfm_event_info_t info;
+	pfmlib_iter_umask_t *u;
+	size_t len;
+	int i, ret;
+
+	memset(&info, 0, sizeof(info));
+	info.size = sizeof(info);
+
+	ret = pfm_get_event_info(it->idx, PFM_OS_NONE, &info);
+	if (ret != PFM_SUCCESS)
+		return ret;
+
+	/* unit mask names are added to the length below */
+	len = strlen(it->pname) + 2 + strlen(info.name) + 1;
+
+	ret = pfmlib_iter_grow(it, info.nattrs, len);
+	if (ret != PFM_SUCCESS)
+		return ret;
+
+	it->base = sprintf(it->buf, "%s::%s", it->pname, info.name);
+
+	if (it->has_preg && regexec(&it->preg, it->buf, 0, NULL, 0))
+		return 0;
+
+	memset(&ainfo, 0, sizeof(ainfo));
+	ainfo.size = sizeof(ainfo);
+
+	it->numasks = 0;
+	for (i = 0; i < info.nattrs; i++) {
+		ret = pfm_get_event_attr_info(it->idx, i, PFM_OS_NONE, &ainfo);
+		if (ret != PFM_SUCCESS)
+			return ret;
+		if (ainfo.type != PFM_ATTR_UMASK)
+			continue;
+		if ((it->flags & PFM_ITER_COMBOS) && ainfo.equiv)
+			continue;
+
+		u = it->um + it->numasks++;
+		u->name  = ainfo.name;
+		u->attr  = i;
+		u->grp   = -1;
+		u->flags = 0;
+		if (it->pmu->get_event_umask_grp)
+			u->grp = it->pmu->get_event_umask_grp(it->pmu, it->idx & PFMLIB_PMU_PIDX_MASK, i, &u->flags);
+
+		len += 1 + strlen(ainfo.name);
+	}
+	ret = pfmlib_iter_grow(it, info.nattrs, len);
+	if (ret != PFM_SUCCESS)
+		return ret;
+
+	it->depth   = 0;
+	it->cur     = 0;
+	it->plain   = 1;
+	it->descend = 1;
+	it->depth_max = it->max_umasks;
+	if (it->numasks > PFMLIB_ITER_COMBO_MAX
+	    && (!it->depth_max || it->depth_max > PFMLIB_ITER_DEPTH_MAX)) {
+		it->depth_max = PFMLIB_ITER_DEPTH_MAX;
+		if (it->flags & PFM_ITER_COMBOS)
+			DPRINT("%s: %d unit masks, sets capped at %d\n",
+			       it->buf, it->numasks, it->depth_max);
+	}
+	return 1;
+}
+
+/*
+ * unit mask at position p cannot join the first n of the current set
+ */
+static int
+pfmlib_iter_conflict(pfm_event_iter_t *it, int p, int n)
+{
+	pfmlib_iter_umask_t *a = it->um + p, *b;
+	int i;
+
+	if (a->grp == -1)
+		return 0;
+
+	for (i = 0; i < n; i++) {
+		b = it->um + it->pos[i];
+		if (b->grp == -1)
+			continue;
+		if (a->grp == b->grp && ((a->flags | b->flags) & PFMLIB_GRP_NCOMBO))
+			return 1;
+		if (a->grp != b->grp && (a->flags & PFMLIB_GRP_EXCL))
+			return 1;
+	}
+	return 0;
+}
+
+static void
+pfmlib_iter_build(pfm_event_iter_t *it)
+{
+	char *p = it->buf + it->base;
+	int i;
+
+	for (i = 0; i < it->depth; i++) {
+		*p++ = ':';
+		strcpy(p, it->um[it->pos[i]].name);
+		p += strlen(p);
+		it->sel[i] = it->um[it->pos[i]].attr;
+	}
+	*p = '\0';
+}
+
+static int
+pfmlib_iter_encode(pfm_event_iter_t *it)
+{
+	pfm_pmu_encode_arg_t arg;
+
+	memset(&arg, 0, sizeof(arg));
+	arg.size = sizeof(arg);
+
+	return pfm_get_os_event_encoding_r(it->buf, PFM_PLM0|PFM_PLM3, PFM_OS_NONE, &arg,
+					   it->scratch, sizeof(it->scratch));
+}
+
+/*
+ * next valid unit mask set of the current event,
+ * return 0 when the event is exhausted
+ */
+static int
+pfmlib_iter_next_combo(pfm_event_iter_t *it)
+{
+	int ret, next;
+
+	if (it->plain) {
+		it->plain = 0;
+		pfmlib_iter_build(it);
+		if (pfmlib_iter_encode(it) == PFM_SUCCESS)
+			return 1;
+	}
+
+	for (;;) {
+		next = it->depth ? it->pos[it->depth - 1] + 1 : 0;
+
+		if (it->descend && next < it->numasks
+		    && (!it->depth_max || it->depth < it->depth_max)) {
+			it->pos[it->depth++] = next;
+		} else {
+			while (it->depth && ++it->pos[it->depth - 1] >= it->numasks)
+				it->depth--;
+			if (!it->depth)
+				return 0;
+		}
+
+		if (pfmlib_iter_conflict(it, it->pos[it->depth - 1], it->depth - 1)) {
+			it->descend = 0;
+			continue;
+		}
+
+		pfmlib_iter_build(it);
+
+		ret = pfmlib_iter_encode(it);
+		it->descend = ret == PFM_SUCCESS || ret == PFM_ERR_UMASK;
+		if (ret == PFM_SUCCESS)
+			return 1;
+	}
+}
+
+/*
+ * next entry of the current event, return 0 when the event is exhausted
+ */
+static int
+pfmlib_iter_next_entry(pfm_event_iter_t *it)
+{
+	if (it->flags & PFM_ITER_COMBOS)
+		return pfmlib_iter_next_combo(it);
+
+	if (it->flags & PFM_ITER_UMASKS) {
+		/* plain event only if it has no unit masks */
+		if (it->plain && !it->numasks) {
+			it->plain = 0;
+			pfmlib_iter_build(it);
+			return 1;
+		}
+		it->plain = 0;
+		if (it->cur == it->numasks)
+			return 0;
+
+		it->pos[0] = it->cur++;
+		it->depth = 1;
+		pfmlib_iter_build(it);
+		return 1;
+	}
+
+	if (!it->plain)
+		return 0;
+
+	it->plain = 0;
+	pfmlib_iter_build(it);
+	return 1;
+}
+
+int
+pfm_event_iter_create(const pfm_event_iter_arg_t *uarg, pfm_event_iter_t **iter)
+{
+	pfm_event_iter_arg_t arg;
+	pfm_pmu_info_t pinfo;
+	pfm_event_iter_t *it;
+	size_t sz = sizeof(arg);
+
+	if (PFMLIB_INITIALIZED() == 0)
+		return PFM_ERR_NOINIT;
+
+	if (!(uarg && iter))
+		return PFM_ERR_INVAL;
+
+	sz = pfmlib_check_struct((void *)uarg, uarg->size, PFM_EVENT_ITER_ARG_ABI0, sz);
+	if (!sz)
+		return PFM_ERR_INVAL;
+
+	memset(&arg, 0, sizeof(arg));
+	memcpy(&arg, uarg, sz);
+
+	if (arg.flags & ~(PFM_ITER_UMASKS|PFM_ITER_COMBOS|PFM_ITER_INACTIVE))
+		return PFM_ERR_INVAL;
+
+	if ((arg.flags & PFM_ITER_UMASKS) && (arg.flags & PFM_ITER_COMBOS))
+		return PFM_ERR_INVAL;
+
+	if (arg.max_umasks < 0 || arg.reserved)
+		return PFM_ERR_INVAL;
+
+	if (arg.pmu != PFM_PMU_NONE) {
+		memset(&pinfo, 0, sizeof(pinfo));
+		pinfo.size = sizeof(pinfo);
+		if (pfm_get_pmu_info(arg.pmu, &pinfo) != PFM_SUCCESS)
+			return PFM_ERR_INVAL;
+
+		/* combinations are checked by encoding them */
+		if ((arg.flags & PFM_ITER_COMBOS) && !pinfo.is_present && !pfm_cfg.inactive)
+			return PFM_ERR_NOTSUPP;
+	}
+
+	it = calloc(1, sizeof(*it));
+	if (!it)
+		return PFM_ERR_NOMEM;
+
+	if (arg.pattern) {
+		if (regcomp(&it->preg, arg.pattern, REG_ICASE|REG_NOSUB)) {
+			free(it);
+			return PFM_ERR_INVAL;
+		}
+		it->has_preg = 1;
+	}
+	it->flags      = arg.flags;
+	it->max_umasks = arg.max_umasks;
+	it->pmu_filter = arg.pmu;
+	it->pmu_id     = -1;
+	it->idx        = -1;
+
+	*iter = it;
+
+	return PFM_SUCCESS;
+}
+
+int
+pfm_event_iter_next(pfm_event_iter_t *it, pfm_event_iter_info_t *uinfo)
+{
+	pfm_event_iter_info_t info;
+	size_t sz = sizeof(info);
+	int ret;
+
+	if (PFMLIB_INITIALIZED() == 0)
+		return PFM_ERR_NOINIT;
+
+	if (!(it && uinfo))
+		return PFM_ERR_INVAL;
+
+	sz = pfmlib_check_struct(uinfo, uinfo->size, PFM_EVENT_ITER_INFO_ABI0, sz);
+	if (!sz)
+		return PFM_ERR_INVAL;
+
+	for (;;) {
+		if (it->busy && pfmlib_iter_next_entry(it))
+			break;
+
+		it->busy = 0;
+
+		if (it->loaded) {
+			it->idx = pfm_get_event_next(it->idx);
+			it->loaded = 0;
+		}
+		if (it->idx == -1 && pfmlib_iter_next_pmu(it))
+			return PFM_ERR_NOTFOUND;
+
+		ret = pfmlib_iter_load(it);
+		if (ret < 0)
+			return ret;
+		it->loaded = 1;
+		it->busy = ret;
+	}
+
+	memset(&info, 0, sizeof(info));
+	info.str     = it->buf;
+	info.umasks  = it->sel;
+	info.size    = sz;
+	info.idx     = it->idx;
+	info.numasks = it->depth;
+
+	memcpy(uinfo, &info, sz);
+
+	return PFM_SUCCESS;
+}
+
+void
+pfm_event_iter_destroy(pfm_event_iter_t *it)
+{
+	if (!it)
+		return;
+
+	if (it->has_preg)
+		regfree(&it->preg);
+
+	free(it->um);
+	free(it->pos);
+	free(it->sel);
+	free(it->buf);
+	free(it);
+}
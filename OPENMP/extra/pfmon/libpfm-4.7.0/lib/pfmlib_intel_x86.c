@@ -1034,6 +1034,77 @@ pfm_intel_x86_valid_pebs(pfmlib_event_desc_t *e)
 	return npebs == numasks ? PFM_SUCCESS : PFM_ERR_FEATCOMB;
 }
 
+/*
+ * counters the event can use once encoded, bit 32 + n is fixed counter n.
+ * Unit mask counter masks supersede the event counter mask. Fixed counters
+ * only support the privilege levels and any thread, and cannot do PEBS
+ */
+uint64_t
+pfm_intel_x86_get_event_cntmsk(void *this, pfmlib_event_desc_t *e)
+{
+	pfmlib_pmu_t *pmu = this;
+	const intel_x86_entry_t *pe = this_pe(this);
+	pfm_event_attr_info_t *a;
+	pfm_intel_x86_reg_t reg;
+	uint64_t msk, umsk = ~0ULL;
+	int i, no_fixed = 0;
+
+	for (i = 0; i < e->nattrs; i++) {
+		a = attr(e, i);
+
+		if (a->ctrl != PFM_ATTR_CTRL_PMU || a->type != PFM_ATTR_UMASK)
+			continue;
+
+		if (pe[e->event].umasks[a->idx].ucntmsk)
+			umsk &= pe[e->event].umasks[a->idx].ucntmsk;
+	}
+	msk = umsk != ~0ULL ? umsk : pe[e->event].cntmsk;
+
+	/* uncore PMUs have their own encoding */
+	if (pmu->type == PFM_PMU_TYPE_CORE && e->count) {
+		reg.val = e->codes[0];
+		if (reg.sel_edge
+		    || reg.sel_inv
+		    || reg.sel_cnt_mask
+		    || reg.sel_intx
+		    || reg.sel_intxcp)
+			no_fixed = 1;
+	}
+#ifdef __linux__
+	if (pfm_intel_x86_requesting_pebs(e))
+		no_fixed = 1;
+#endif
+	if (no_fixed)
+		msk &= 0xffffffffULL;
+
+	return msk & pfmlib_pmu_cntmsk(pmu);
+}
+
+/*
+ * unit mask group of attribute attr_idx, -1 if not a unit mask. Mirrors the
+ * NCOMBO and GRP_EXCL checks of the encoding, so that combinations which
+ * cannot encode can be skipped without trying them
+ */
+int
+pfm_intel_x86_get_event_umask_grp(void *this, int pidx, int attr_idx, int *flags)
+{
+	const intel_x86_entry_t *pe = this_pe(this);
+	int idx;
+
+	if (attr_idx < 0 || attr_idx >= (int)intel_x86_num_umasks(this, pidx))
+		return -1;
+
+	idx = intel_x86_attr2umask(this, pidx, attr_idx);
+
+	*flags = 0;
+	if (intel_x86_uflag(this, pidx, idx, INTEL_X86_NCOMBO))
+		*flags |= PFMLIB_GRP_NCOMBO;
+	if (intel_x86_eflag(this, pidx, INTEL_X86_GRP_EXCL))
+		*flags |= PFMLIB_GRP_EXCL;
+
+	return pe[pidx].umasks[idx].grpid;
+}
+
 unsigned int
 pfm_intel_x86_get_event_nattrs(void *this, int pidx)
 {
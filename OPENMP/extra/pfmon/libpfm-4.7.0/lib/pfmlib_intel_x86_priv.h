@@ -337,6 +337,9 @@ extern int pfm_intel_x86_validate_table(void *this, FILE *fp);
 extern int pfm_intel_x86_get_event_attr_info(void *this, int idx, int attr_idx, pfm_event_attr_info_t *info);
 extern int pfm_intel_x86_get_event_info(void *this, int idx, pfm_event_info_t *info);
 extern int pfm_intel_x86_valid_pebs(pfmlib_event_desc_t *e);
+extern int pfm_intel_x86_requesting_pebs(pfmlib_event_desc_t *e);
+extern uint64_t pfm_intel_x86_get_event_cntmsk(void *this, pfmlib_event_desc_t *e);
+extern int pfm_intel_x86_get_event_umask_grp(void *this, int pidx, int attr_idx, int *flags);
 extern int pfm_intel_x86_perf_event_encoding(pfmlib_event_desc_t *e, void *data);
 extern int pfm_intel_x86_perf_detect(void *this);
 extern unsigned int pfm_intel_x86_get_event_nattrs(void *this, int pidx);
@@ -74,16 +74,17 @@ static const pfmlib_attr_desc_t perf_event_ext_mods[]={
 };
 
 static int
-pfmlib_perf_event_encode(void *this, const char *str, int dfl_plm, void *data)
+pfmlib_perf_event_encode(void *this, const char *str, int dfl_plm, void *data, pfmlib_arena_t *arena)
 {
 	pfm_perf_encode_arg_t arg;
 	pfm_perf_encode_arg_t *uarg = data;
 	pfmlib_os_t *os = this;
-	struct perf_event_attr my_attr, *attr;
+	struct perf_event_attr my_attr, in_attr, *attr;
+	pfmlib_encode_key_t key;
 	pfmlib_pmu_t *pmu;
 	pfmlib_event_desc_t e;
 	pfm_event_attr_info_t *a;
-	size_t orig_sz, asz, sz = sizeof(arg);
+	size_t orig_sz, asz, csz, sz = sizeof(arg);
 	uint64_t ival;
 	int has_plm = 0, has_vmx_plm = 0;
 	int i, plm = 0, ret, vmx_plm = 0;
@@ -128,11 +129,38 @@ pfmlib_perf_event_encode(void *this, const char *str, int dfl_plm, void *data)
 		__pfm_vbprintf("warning: mismatch attr struct size "
 			       "user=%d libpfm=%zu\n", asz, sizeof(*attr));
 
+	/*
+	 * the fields initialized by the user are merged into
+	 * the encoding, so they are part of the cache key
+	 */
+	in_attr = my_attr;
+
+	key.str     = str;
+	key.dfl_plm = dfl_plm;
+	key.osid    = os->id;
+	key.in      = &in_attr;
+	key.in_sz   = sizeof(in_attr);
+
+	/* the cache allocates its entries, not used with an arena */
+	if (!arena) {
+		csz = sizeof(my_attr);
+		ret = pfmlib_encode_cache_get(&key, attr, &csz, &arg.idx, &arg.cpu, arg.fstr);
+		if (ret == PFM_SUCCESS) {
+			memcpy(uarg->attr, attr, asz);
+			uarg->attr->size = orig_sz;
+			memcpy(uarg, &arg, sz);
+			return PFM_SUCCESS;
+		}
+		if (ret != PFM_ERR_NOTFOUND)
+			return ret;
+	}
+
 	memset(&e, 0, sizeof(e));
 
 	e.osid = os->id;
 	e.os_data = attr;
 	e.dfl_plm = dfl_plm;
+	e.arena = arena;
 
 	/* after this call, need to call pfmlib_release_event() */
 	ret = pfmlib_parse_event(str, &e);
@@ -335,6 +363,9 @@ pfmlib_perf_event_encode(void *this, const char *str, int dfl_plm, void *data)
 		memcpy(uarg, &arg, sz);
 
 done:
+	if (ret == PFM_SUCCESS && !arena)
+		pfmlib_encode_cache_put(&key, attr, sizeof(*attr), arg.idx, arg.cpu,
+					arg.fstr ? *arg.fstr : NULL);
 	pfmlib_release_event(&e);
 	return ret;
 }
@@ -22,6 +22,8 @@
  * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 #include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/utsname.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -29,18 +31,12 @@
 #include <dirent.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <pthread.h>
 #ifdef __linux__
-#include <sys/syscall.h> /* for openat() */
+#include <sys/syscall.h>
 #include <sys/param.h>
 #endif
 
-/*
- * looks like several distributions do not have
- * the latest libc with openat support, so disable
- * for now
- */
-#undef HAS_OPENAT
-
 #include "pfmlib_priv.h"
 #include "pfmlib_perf_event_priv.h"
 
@@ -71,6 +67,7 @@ typedef struct {
  * umask options: uflags
  */
 #define PERF_FL_DEFAULT	0x1	/* umask is default for group */
+#define PERF_FL_TP_NOID	0x2	/* tracepoint id not read yet */
 
 #define PERF_INVAL_OVFL_IDX ((unsigned long)-1)
 
@@ -164,6 +161,7 @@ perf_attridx2um(int idx, int attr_idx)
 
 /*
  * figure out the mount point of the debugfs filesystem
+ * LIBPFM_DEBUGFS takes precedence over /proc/mounts
  *
  * returns -1 if none is found
  */
@@ -176,6 +174,12 @@ get_debugfs_mnt(void)
 	char *q, *mnt, *fs;
 	int res = -1;
 
+	if (pfm_cfg.debugfs_mnt) {
+		strncpy(debugfs_mnt, pfm_cfg.debugfs_mnt, MAXPATHLEN);
+		debugfs_mnt[MAXPATHLEN-1]= '\0';
+		return 0;
+	}
+
 	fp = fopen("/proc/mounts", "r");
 	if (!fp)
 		return -1;
@@ -215,6 +219,51 @@ get_debugfs_mnt(void)
 #define PERF_ALLOC_EVENT_COUNT	(512)
 #define PERF_ALLOC_UMASK_COUNT	(1024)
 
+/*
+ * tracepoints: subsystems are events, tracepoints are unit masks
+ *
+ * They are not read at initialization. A tracepoint is added to
+ * the event table when it is first looked up, by path (see
+ * pfm_perf_resolve_event()). All tracepoints are added only when
+ * events are listed, i.e., when the number of events is queried
+ * (see pfm_perf_get_num_events()).
+ */
+static pthread_mutex_t perf_tp_lock = PTHREAD_MUTEX_INITIALIZER;
+static int perf_tp_listed;	/* all tracepoints are in the table */
+
+#define PERF_TP_CACHE_MAGIC	"libpfm tracepoints 1"
+#define PERF_NT_GNU_BUILD_ID	3
+
+/*
+ * tables replaced by a larger copy. They are kept until
+ * pfm_perf_terminate() because tracepoints may be added
+ * while other threads look at the tables
+ */
+static void **perf_retired;
+static int perf_nretired;
+
+static void *
+perf_table_grow(void *old, size_t n, size_t count, size_t sz)
+{
+	void **r;
+	void *addr;
+
+	r = realloc(perf_retired, (perf_nretired + 1) * sizeof(*r));
+	if (!r)
+		return NULL;
+	perf_retired = r;
+
+	addr = calloc(count, sz);
+	if (!addr)
+		return NULL;
+
+	if (old) {
+		memcpy(addr, old, n * sz);
+		perf_retired[perf_nretired++] = old;
+	}
+	return addr;
+}
+
 /*
  * clone static event table into a  dynamic
  * event table
@@ -232,8 +281,8 @@ perf_table_clone(void)
 	if (addr) {
 		memcpy(addr, perf_static_events, perf_nevents * sizeof(perf_event_t));
 		perf_pe_free = addr + perf_nevents;
-		perf_pe_end = perf_pe_free + PERF_ALLOC_EVENT_COUNT;
-		perf_pe = addr;
+		perf_pe_end = addr + perf_pe_count;
+		__atomic_store_n(&perf_pe, addr, __ATOMIC_RELEASE);
 	}
 	return addr;
 }
@@ -243,26 +292,28 @@ perf_table_clone(void)
  *
  * returns NULL if out-of-memory
  *
- * may realloc existing table if necessary for growth
+ * may replace existing table if necessary for growth
  */
 static perf_event_t *
 perf_table_alloc_event(void)
 {
 	perf_event_t *new_pe;
+	int n;
 
 retry:
 	if (perf_pe_free < perf_pe_end)
 		return perf_pe_free++;
 
-	perf_pe_count += PERF_ALLOC_EVENT_COUNT;
-	
-	new_pe = realloc(perf_pe, perf_pe_count * sizeof(perf_event_t));
+	n = perf_pe_count;
+
+	new_pe = perf_table_grow(perf_pe, n, 2 * n, sizeof(*new_pe));
 	if (!new_pe) 
 		return NULL;
 	
+	perf_pe_count = 2 * n;
 	perf_pe_free = new_pe + (perf_pe_free - perf_pe);
-	perf_pe_end = perf_pe_free + PERF_ALLOC_EVENT_COUNT;
-	perf_pe = new_pe;
+	perf_pe_end = new_pe + perf_pe_count;
+	__atomic_store_n(&perf_pe, new_pe, __ATOMIC_RELEASE);
 
 	goto retry;
 }
@@ -285,185 +336,525 @@ static perf_umask_t *
 perf_table_alloc_umask(void)
 {
 	perf_umask_t *new_um;
+	int n;
 
 retry:
 	if (perf_um_free < perf_um_end)
 		return perf_um_free++;
 
-	perf_um_count += PERF_ALLOC_UMASK_COUNT;
-	
-	new_um = realloc(perf_um, perf_um_count * sizeof(*new_um));
+	n = perf_um_count ? 2 * perf_um_count : PERF_ALLOC_UMASK_COUNT;
+
+	new_um = perf_table_grow(perf_um, perf_um_count, n, sizeof(*new_um));
 	if (!new_um) 
 		return NULL;
 	
+	perf_um_count = n;
 	perf_um_free = new_um + (perf_um_free - perf_um);
-	perf_um_end = perf_um_free + PERF_ALLOC_UMASK_COUNT;
-	perf_um = new_um;
+	perf_um_end = new_um + perf_um_count;
+	__atomic_store_n(&perf_um, new_um, __ATOMIC_RELEASE);
 
 	goto retry;
 }
 
-#ifdef __GNUC__
-#define POTENTIALLY_UNUSED __attribute__((unused))
+/*
+ * names are used in paths
+ */
+static inline int
+perf_tp_name_ok(const char *s)
+{
+	return *s && !strchr(s, '/') && strcmp(s, ".") && strcmp(s, "..");
+}
+
+static int
+perf_tp_is_dir(const char *dir, struct dirent *d)
+{
+	char path[MAXPATHLEN];
+	struct stat st;
+
+	if (!perf_tp_name_ok(d->d_name))
+		return 0;
+#ifdef _DIRENT_HAVE_D_TYPE
+	if (d->d_type != DT_UNKNOWN)
+		return d->d_type == DT_DIR;
 #endif
+	if (snprintf(path, MAXPATHLEN, "%s/%s", dir, d->d_name) >= MAXPATHLEN)
+		return 0;
 
-static void
-gen_tracepoint_table(void)
+	return !stat(path, &st) && S_ISDIR(st.st_mode);
+}
+
+static int
+perf_tp_read_id(const char *subsys, const char *event, uint64_t *id)
 {
-	DIR *dir1, *dir2;
-	struct dirent *d1, *d2;
-	perf_event_t *p;
-	perf_umask_t *um;
-	char d2path[MAXPATHLEN];
 	char idpath[MAXPATHLEN];
 	char id_str[32];
+	ssize_t n;
+	int fd;
+
+	if (snprintf(idpath, MAXPATHLEN, "%s/%s/%s/id", debugfs_mnt, subsys, event) >= MAXPATHLEN)
+		return PFM_ERR_NOTFOUND;
+
+	fd = open(idpath, O_RDONLY);
+	if (fd == -1)
+		return PFM_ERR_NOTFOUND;
+
+	n = read(fd, id_str, sizeof(id_str) - 1);
+
+	close(fd);
+
+	if (n <= 0)
+		return PFM_ERR_NOTFOUND;
+
+	id_str[n] = '\0';
+	*id = strtoull(id_str, NULL, 0);
+	DPRINT("idpath=%s:%s id=%"PRIu64"\n", subsys, event, *id);
+
+	return PFM_SUCCESS;
+}
+
+/*
+ * look for a tracepoint subsystem among the first n events
+ */
+static int
+perf_tp_find_event(const char *name, int n)
+{
+	int i;
+
+	for (i = PME_PERF_EVENT_COUNT; i < n; i++)
+		if (!strcasecmp(perf_pe[i].name, name))
+			return i;
+	return -1;
+}
+
+static int
+perf_tp_find_umask(int pidx, const char *name)
+{
+	int i;
+
+	for (i = 0; i < perf_pe[pidx].numasks; i++)
+		if (!strcasecmp(perf_attridx2um(pidx, i)->uname, name))
+			return i;
+	return -1;
+}
+
+/*
+ * add a tracepoint subsystem, without unit masks
+ *
+ * returns the event index or an error
+ */
+static int
+perf_tp_add_event(const char *name)
+{
+	perf_event_t *p;
+	char *str;
+	int pidx;
+
+	if (perf_pe == perf_static_events && !perf_table_clone())
+		return PFM_ERR_NOMEM;
+
+	str = strdup(name);
+	if (!str)
+		return PFM_ERR_NOMEM;
+
+	p = perf_table_alloc_event();
+	if (!p) {
+		free(str);
+		return PFM_ERR_NOMEM;
+	}
+
+	/*
+	 * tracepoint have no event codes
+	 * the code is in the unit masks
+	 */
+	p->name = str;
+	p->desc = "tracepoint";
+	p->id = 0;
+	p->type = PERF_TYPE_TRACEPOINT;
+	p->umask_ovfl_idx = PERF_INVAL_OVFL_IDX;
+	p->modmsk = 0;
+	p->ngrp = 0;
+	p->numasks = 0;
+
+	pidx = p - perf_pe;
+
+	/* events are allocated in order */
+	__atomic_store_n(&perf_nevents, pidx + 1, __ATOMIC_RELEASE);
+
+	pfmlib_event_index_add(&perf_event_support, p->name, pidx);
+
+	return pidx;
+}
+
+/*
+ * add a tracepoint to its subsystem. Unit masks may be added to
+ * any event at any time, so the overflow unit masks of the event
+ * are moved to the end of the overflow table if they are not there
+ * already, to keep them contiguous.
+ *
+ * returns the unit mask index or an error
+ */
+static int
+perf_tp_add_umask(int pidx, const char *name, uint64_t id, int uflags)
+{
+	perf_umask_t *um;
+	unsigned long base = PERF_INVAL_OVFL_IDX, end;
+	int i, n = perf_pe[pidx].numasks;
+	char *str;
+
+	str = strdup(name);
+	if (!str)
+		return PFM_ERR_NOMEM;
+
+	if (n < PERF_MAX_UMASKS) {
+		um = perf_pe[pidx].umasks + n;
+	} else {
+		base = perf_pe[pidx].umask_ovfl_idx;
+		end = perf_um_free - perf_um;
+
+		if (n == PERF_MAX_UMASKS || base + n - PERF_MAX_UMASKS != end) {
+			for (i = PERF_MAX_UMASKS; i < n; i++) {
+				um = perf_table_alloc_umask();
+				if (!um)
+					goto nomem;
+				*um = perf_um[base + i - PERF_MAX_UMASKS];
+			}
+			base = end;
+		}
+		um = perf_table_alloc_umask();
+		if (!um)
+			goto nomem;
+	}
+
+	um->uname  = str;
+	um->udesc  = str;
+	um->uid    = id;
+	um->uflags = uflags;
+	um->grpid  = 0;
+
+	if (base != PERF_INVAL_OVFL_IDX)
+		perf_pe[pidx].umask_ovfl_idx = base;
+	perf_pe[pidx].ngrp = 1;
+
+	__atomic_store_n(&perf_pe[pidx].numasks, n + 1, __ATOMIC_RELEASE);
+
+	return n;
+nomem:
+	free(str);
+	return PFM_ERR_NOMEM;
+}
+
+/*
+ * tracepoints added by listing get their id on first use
+ */
+static perf_umask_t *
+perf_tp_resolve_umask(int pidx, int attr_idx)
+{
+	perf_umask_t *um;
 	uint64_t id;
-	int fd, err;
-	int POTENTIALLY_UNUSED dir2_fd;
-	int reuse_event = 0;
-	int numasks;
-	char *tracepoint_name;
-
-	err = get_debugfs_mnt();
-	if (err == -1)
-		return;
 
-	strncat(debugfs_mnt, "/tracing/events", MAXPATHLEN-1);
-	debugfs_mnt[MAXPATHLEN-1]= '\0';
+	um = perf_attridx2um(pidx, attr_idx);
+	if (!(__atomic_load_n(&um->uflags, __ATOMIC_ACQUIRE) & PERF_FL_TP_NOID))
+		return um;
+
+	pthread_mutex_lock(&perf_tp_lock);
+
+	um = perf_attridx2um(pidx, attr_idx);
+	if ((um->uflags & PERF_FL_TP_NOID)
+	    && perf_tp_read_id(perf_pe[pidx].name, um->uname, &id) == PFM_SUCCESS) {
+		um->uid = id;
+		__atomic_store_n(&um->uflags, um->uflags & ~PERF_FL_TP_NOID, __ATOMIC_RELEASE);
+	}
+
+	pthread_mutex_unlock(&perf_tp_lock);
+
+	return um;
+}
+
+/*
+ * add tracepoint subsys:event found by listing
+ * *pidx is the last subsystem used, *merge is true if it
+ * was already in the table before listing
+ */
+static int
+perf_tp_list_add(const char *subsys, const char *event, int *pidx, int *merge)
+{
+	int ret;
+
+	if (*pidx < 0 || strcmp(perf_pe[*pidx].name, subsys)) {
+		*pidx = perf_tp_find_event(subsys, perf_nevents);
+		*merge = *pidx >= 0;
+		if (*pidx < 0)
+			*pidx = perf_tp_add_event(subsys);
+		if (*pidx < 0)
+			return *pidx;
+	}
+
+	if (*merge && perf_tp_find_umask(*pidx, event) >= 0)
+		return PFM_SUCCESS;
+
+	ret = perf_tp_add_umask(*pidx, event, 0, PERF_FL_TP_NOID);
+
+	return ret < 0 ? ret : PFM_SUCCESS;
+}
+
+/*
+ * list the tracing/events tree, directories only: ids are read on first use
+ */
+static int
+perf_tp_scan(void)
+{
+	DIR *dir1, *dir2;
+	struct dirent *d1, *d2;
+	char d2path[MAXPATHLEN];
+	int pidx = -1, merge = 0;
+	int ret = PFM_SUCCESS;
 
 	dir1 = opendir(debugfs_mnt);
 	if (!dir1)
-		return;
-
-	p = perf_table_clone();
+		return PFM_ERR_NOTFOUND;
 
-	err = 0;
-	while((d1 = readdir(dir1)) && err >= 0) {
+	while(ret == PFM_SUCCESS && (d1 = readdir(dir1))) {
 
-		if (!strcmp(d1->d_name, "."))
+		if (!perf_tp_is_dir(debugfs_mnt, d1))
 			continue;
 
-		if (!strcmp(d1->d_name, ".."))
+		if (snprintf(d2path, MAXPATHLEN, "%s/%s", debugfs_mnt, d1->d_name) >= MAXPATHLEN)
 			continue;
 
-		snprintf(d2path, MAXPATHLEN, "%s/%s", debugfs_mnt, d1->d_name);
-
-		/* fails if d2path is not a directory */
 		dir2 = opendir(d2path);
 		if (!dir2)
 			continue;
 
-		dir2_fd = dirfd(dir2);
+		while(ret == PFM_SUCCESS && (d2 = readdir(dir2))) {
+			if (perf_tp_is_dir(d2path, d2))
+				ret = perf_tp_list_add(d1->d_name, d2->d_name, &pidx, &merge);
+		}
+		closedir(dir2);
+	}
+	closedir(dir1);
+
+	return ret;
+}
 
-		/*
- 		 * if a subdir did not fit our expected
- 		 * tracepoint format, then we reuse the
-		 * allocated space (with have no free)
- 		 */
-		if (!reuse_event)
-			p = perf_table_alloc_event();
-
-		if (!p)
+/*
+ * cache key: build id of the kernel, or its release and version
+ * if the build id is not available
+ */
+static int
+perf_tp_kernel_key(char *key, size_t sz)
+{
+	unsigned char notes[4096];
+	uint32_t namesz, descsz, type;
+	struct utsname u;
+	size_t off = 0, i;
+	ssize_t n = 0;
+	char *q;
+	int fd;
+
+	fd = open("/sys/kernel/notes", O_RDONLY);
+	if (fd != -1) {
+		n = read(fd, notes, sizeof(notes));
+		close(fd);
+	}
+
+	while (n > 0 && off + 12 <= (size_t)n) {
+		memcpy(&namesz, notes + off, 4);
+		memcpy(&descsz, notes + off + 4, 4);
+		memcpy(&type, notes + off + 8, 4);
+		off += 12;
+
+		if (off + ((namesz + 3) & ~3) + descsz > (size_t)n)
 			break;
 
-		if (p)
-			p->name = tracepoint_name = strdup(d1->d_name);
+		if (type == PERF_NT_GNU_BUILD_ID && namesz == 4
+		    && !memcmp(notes + off, "GNU", 4)
+		    && 9 + 2 * descsz < sz) {
+			q = key + sprintf(key, "build-id ");
+			for (i = 0; i < descsz; i++)
+				q += sprintf(q, "%02x", notes[off + 4 + i]);
+			return 0;
+		}
+		off += ((namesz + 3) & ~3) + ((descsz + 3) & ~3);
+	}
+
+	if (uname(&u))
+		return -1;
+
+	snprintf(key, sz, "uname %s %s", u.release, u.version);
 
-		if (!(p && p->name)) {
-			closedir(dir2);
-			err = -1;
+	return 0;
+}
+
+/*
+ * signature of the list of subsystems, independent of the order
+ * of the entries, catches tracepoints of modules loaded or unloaded
+ */
+static int
+perf_tp_signature(char *sig, size_t sz)
+{
+	DIR *dir;
+	struct dirent *d;
+	unsigned int h, sum = 0, n = 0;
+	const char *s;
+
+	dir = opendir(debugfs_mnt);
+	if (!dir)
+		return -1;
+
+	while((d = readdir(dir))) {
+		if (!perf_tp_is_dir(debugfs_mnt, d))
 			continue;
+		h = 2166136261U;
+		for (s = d->d_name; *s; s++) {
+			h ^= (unsigned char)*s;
+			h *= 16777619U;
 		}
+		sum += h;
+		n++;
+	}
+	closedir(dir);
 
-		p->desc = "tracepoint";
-		p->id = -1;
-		p->type = PERF_TYPE_TRACEPOINT;
-		p->umask_ovfl_idx = PERF_INVAL_OVFL_IDX;
-		p->modmsk = 0,
-		p->ngrp = 1;
+	snprintf(sig, sz, "%u %08x", n, sum);
 
-		numasks = 0;
-		reuse_event = 0;
+	return 0;
+}
 
-		while((d2 = readdir(dir2))) {
-			if (!strcmp(d2->d_name, "."))
-				continue;
+/*
+ * cache file format:
+ * 	libpfm tracepoints 1
+ * 	key <kernel key>
+ * 	subsystems <signature>
+ * 	<subsys> <event>
+ * 	...
+ */
+static int
+perf_tp_load_cache(const char *key, const char *sig)
+{
+	FILE *fp;
+	char line[MAXPATHLEN];
+	char *q;
+	int pidx = -1, merge = 0, nlines = 0;
+	int ret = PFM_SUCCESS;
 
-			if (!strcmp(d2->d_name, ".."))
-				continue;
+	fp = fopen(pfm_cfg.tp_cache, "r");
+	if (!fp)
+		return PFM_ERR_NOTFOUND;
 
-#ifdef HAS_OPENAT
-                        snprintf(idpath, MAXPATHLEN, "%s/id", d2->d_name);
-                        fd = openat(dir2_fd, idpath, O_RDONLY);
-#else
-                        snprintf(idpath, MAXPATHLEN, "%s/%s/id", d2path, d2->d_name);
-                        fd = open(idpath, O_RDONLY);
-#endif
-			if (fd == -1)
-				continue;
+	while (ret == PFM_SUCCESS && fgets(line, sizeof(line), fp)) {
+		q = strchr(line, '\n');
+		if (q)
+			*q = '\0';
 
-			err = read(fd, id_str, sizeof(id_str));
+		switch(nlines++) {
+		case 0:
+			if (strcmp(line, PERF_TP_CACHE_MAGIC))
+				ret = PFM_ERR_NOTFOUND;
+			continue;
+		case 1:
+			if (strncmp(line, "key ", 4) || strcmp(line + 4, key))
+				ret = PFM_ERR_NOTFOUND;
+			continue;
+		case 2:
+			if (strncmp(line, "subsystems ", 11) || strcmp(line + 11, sig))
+				ret = PFM_ERR_NOTFOUND;
+			continue;
+		}
 
-			close(fd);
+		q = strchr(line, ' ');
+		if (!q || !perf_tp_name_ok(q + 1)) {
+			ret = PFM_ERR_INVAL;
+			break;
+		}
+		*q++ = '\0';
 
-			if (err < 0)
-				continue;
+		if (!perf_tp_name_ok(line)) {
+			ret = PFM_ERR_INVAL;
+			break;
+		}
+		ret = perf_tp_list_add(line, q, &pidx, &merge);
+	}
+	fclose(fp);
 
-			id = strtoull(id_str, NULL, 0);
+	if (nlines < 3)
+		ret = PFM_ERR_NOTFOUND;
 
-			if (numasks < PERF_MAX_UMASKS)
-				um = p->umasks+numasks;
-			else {
-				um = perf_table_alloc_umask();
-				if (numasks == PERF_MAX_UMASKS)
-					p->umask_ovfl_idx = perf_get_ovfl_umask_idx(um);
-			}
+	DPRINT("tracepoint cache %s: %s\n", pfm_cfg.tp_cache, pfm_strerror(ret));
 
-			if (!um) {
-				err = -1;
-				break;
-			}
+	return ret;
+}
 
-			/*
-			 * tracepoint have no event codes
-			 * the code is in the unit masks
-			 */
-			p->id = 0;
+/*
+ * written to a temporary file renamed in place, concurrent
+ * readers see either the old or the new file
+ */
+static void
+perf_tp_save_cache(const char *key, const char *sig)
+{
+	FILE *fp;
+	char tmp[MAXPATHLEN];
+	int i, j, ret;
 
-			um->uname = strdup(d2->d_name);
-			if (!um->uname) {
-				err = -1;
-				break;
-			}
-			um->udesc = um->uname;
-			um->uid   = id;
-			um->grpid = 0;
-			DPRINT("idpath=%s:%s id=%"PRIu64"\n", p->name, um->uname, id);
-			numasks++;
-		}
-		p->numasks = numasks;
+	if (snprintf(tmp, MAXPATHLEN, "%s.%d", pfm_cfg.tp_cache, (int)getpid()) >= MAXPATHLEN)
+		return;
 
-		closedir(dir2);
+	fp = fopen(tmp, "w");
+	if (!fp) {
+		DPRINT("cannot create tracepoint cache %s\n", tmp);
+		return;
+	}
 
-		/*
-		 * directory was not pointing
-		 * to a tree structure we know about
-		 */
-		if (!numasks) {
-			free(tracepoint_name);
-			reuse_event =1;
-			continue;
-		}
+	fprintf(fp, "%s\nkey %s\nsubsystems %s\n", PERF_TP_CACHE_MAGIC, key, sig);
 
-		/*
- 		 * update total number of events
- 		 * only when no error is reported
- 		 */
-		if (err >= 0)
-			perf_nevents++;
-		reuse_event = 0;
+	for (i = PME_PERF_EVENT_COUNT; i < perf_nevents; i++)
+		for (j = 0; j < perf_pe[i].numasks; j++)
+			fprintf(fp, "%s %s\n", perf_pe[i].name, perf_attridx2um(i, j)->uname);
+
+	ret = ferror(fp);
+	ret |= fclose(fp);
+
+	if (ret || rename(tmp, pfm_cfg.tp_cache)) {
+		DPRINT("cannot write tracepoint cache %s\n", pfm_cfg.tp_cache);
+		unlink(tmp);
 	}
-	closedir(dir1);
+}
+
+/*
+ * add all tracepoints to the table, from the cache file when
+ * LIBPFM_TRACEPOINT_CACHE is set and the file matches the kernel,
+ * from the tracing/events tree otherwise (and the cache file is updated)
+ */
+static void
+perf_tp_list_all(void)
+{
+	char key[256], sig[32];
+	int cache, ret;
+
+	if (!debugfs_mnt[0] || __atomic_load_n(&perf_tp_listed, __ATOMIC_ACQUIRE))
+		return;
+
+	pthread_mutex_lock(&perf_tp_lock);
+
+	if (perf_tp_listed)
+		goto done;
+
+	cache = pfm_cfg.tp_cache
+	     && !perf_tp_kernel_key(key, sizeof(key))
+	     && !perf_tp_signature(sig, sizeof(sig));
+
+	if (cache && perf_tp_load_cache(key, sig) == PFM_SUCCESS) {
+		ret = PFM_SUCCESS;
+	} else {
+		ret = perf_tp_scan();
+		if (ret == PFM_SUCCESS && cache)
+			perf_tp_save_cache(key, sig);
+	}
+	/* on error, on-demand lookups remain possible */
+	if (ret == PFM_SUCCESS)
+		__atomic_store_n(&perf_tp_listed, 1, __ATOMIC_RELEASE);
+
+	DPRINT("%d tracepoint subsystems\n", perf_nevents - PME_PERF_EVENT_COUNT);
+done:
+	pthread_mutex_unlock(&perf_tp_lock);
 }
 
 static int
@@ -492,15 +883,118 @@ pfm_perf_init(void *this)
 	 * from the default count
 	 */
 	perf_event_support.pme_count = PME_PERF_EVENT_COUNT;
+	perf_tp_listed = 0;
+
+	/*
+	 * tracepoints are added on demand, only
+	 * locate them here
+	 */
+	if (get_debugfs_mnt() == -1) {
+		debugfs_mnt[0] = '\0';
+	} else {
+		strncat(debugfs_mnt, "/tracing/events", MAXPATHLEN - 1 - strlen(debugfs_mnt));
+		if (access(debugfs_mnt, F_OK))
+			debugfs_mnt[0] = '\0';
+	}
+	DPRINT("tracepoints in %s\n", debugfs_mnt[0] ? debugfs_mnt : "(none)");
 
-	/* must dynamically add tracepoints */
-	gen_tracepoint_table();
 	/* dynamically patch supported plm based on CORE PMU plm */
 	pmu->supported_plm = pfm_perf_pmu_supported_plm(pmu);
 
 	return PFM_SUCCESS;
 }
 
+/*
+ * look up tracepoint subsys:event by path when it is not in the
+ * table, pidx is the result of the lookup of e in the table
+ *
+ * returns the index of the event or an error
+ */
+static int
+pfm_perf_resolve_event(void *this, int pidx, const char *e, const char *attrs)
+{
+	char path[MAXPATHLEN], s[MAXPATHLEN];
+	const char *p, *q;
+	struct stat st;
+	uint64_t id;
+	size_t n;
+	int ret;
+
+	if (pidx >= 0 && perf_pe[pidx].type != PERF_TYPE_TRACEPOINT)
+		return pidx;
+
+	if (!debugfs_mnt[0] || __atomic_load_n(&perf_tp_listed, __ATOMIC_ACQUIRE))
+		return pidx;
+
+	if (pidx < 0 && !perf_tp_name_ok(e))
+		return pidx;
+
+	pthread_mutex_lock(&perf_tp_lock);
+
+	/* may have been added since the lookup */
+	if (pidx < 0)
+		pidx = perf_tp_find_event(e, perf_nevents);
+
+	if (pidx < 0) {
+		if (snprintf(path, MAXPATHLEN, "%s/%s", debugfs_mnt, e) >= MAXPATHLEN
+		    || stat(path, &st) || !S_ISDIR(st.st_mode)) {
+			ret = PFM_ERR_NOTFOUND;
+			goto done;
+		}
+		pidx = perf_tp_add_event(e);
+		if (pidx < 0) {
+			ret = pidx;
+			goto done;
+		}
+	}
+
+	/*
+	 * unit masks not in the table yet, skip modifiers. Attributes
+	 * are copied one at a time, attrs is const and this may run
+	 * on the allocation-free path (pfm_get_os_event_encoding_r())
+	 */
+	for (p = attrs; p && *p; p = *q ? q + 1 : q) {
+		q = strchr(p, ':');
+		if (!q)
+			q = p + strlen(p);
+
+		n = q - p;
+		if (!n || n >= sizeof(s))
+			continue;
+		memcpy(s, p, n);
+		s[n] = '\0';
+
+		if (strchr(s, '=') || !perf_tp_name_ok(s))
+			continue;
+
+		if (perf_tp_find_umask(pidx, s) >= 0)
+			continue;
+
+		if (perf_tp_read_id(perf_pe[pidx].name, s, &id) != PFM_SUCCESS)
+			continue;
+
+		ret = perf_tp_add_umask(pidx, s, id, 0);
+		if (ret < 0)
+			goto done;
+	}
+	ret = pidx;
+done:
+	pthread_mutex_unlock(&perf_tp_lock);
+
+	return ret;
+}
+
+/*
+ * listing events: add all tracepoints
+ */
+static int
+pfm_perf_get_num_events(void *this)
+{
+	perf_tp_list_all();
+
+	return perf_nevents;
+}
+
 static int
 pfm_perf_get_event_first(void *this)
 {
@@ -590,14 +1084,12 @@ pfmlib_perf_encode_tp(pfmlib_event_desc_t *e)
 			if (++nu > 1)
 				return PFM_ERR_FEATCOMB;
 
-			if (a->idx < PERF_MAX_UMASKS) {
-				e->codes[0] = perf_pe[e->event].umasks[a->idx].uid;
-				evt_strcat(e->fstr, ":%s", perf_pe[e->event].umasks[a->idx].uname);
-			} else {
-				um = perf_get_ovfl_umask(e->event);
-				e->codes[0] = um[a->idx - PERF_MAX_UMASKS].uid;
-				evt_strcat(e->fstr, ":%s", um[a->idx - PERF_MAX_UMASKS].uname);
-			}
+			um = perf_tp_resolve_umask(e->event, a->idx);
+			if (um->uflags & PERF_FL_TP_NOID)
+				return PFM_ERR_UMASK;
+
+			e->codes[0] = um->uid;
+			evt_strcat(e->fstr, ":%s", um->uname);
 		} else
 			return PFM_ERR_ATTR;
 	}
@@ -738,7 +1230,7 @@ pfm_perf_get_event_attr_info(void *this, int idx, int attr_idx, pfm_event_attr_i
 	perf_umask_t *um;
 
 	/* only supports umasks, modifiers handled at OS layer */
-	um = perf_attridx2um(idx, attr_idx);
+	um = perf_tp_resolve_umask(idx, attr_idx);
 
 	info->name = um->uname;
 	info->desc = um->udesc;
@@ -779,56 +1271,76 @@ pfm_perf_terminate(void *this)
 	perf_event_t *p;
 	int i, j;
 
-	if (!(perf_pe && perf_um))
-		return;
-
 	/*
 	 * free tracepoints name + unit mask names
 	 * which are dynamically allocated
 	 */
-	for (i=0; i < perf_nevents; i++) {
-		p = &perf_pe[i];
+	if (perf_pe != perf_static_events) {
+		for (i=0; i < perf_nevents; i++) {
+			p = &perf_pe[i];
 
-		if (p->type != PERF_TYPE_TRACEPOINT)
-			continue;
+			if (p->type != PERF_TYPE_TRACEPOINT)
+				continue;
 
-		/* cast to keep compiler happy, we are
-		 * freeing the dynamically allocated clone
-		 * table, not the static one. We do not want
-		 * to create a specific data type
-		 */
-		free((void *)p->name);
+			/* cast to keep compiler happy, we are
+			 * freeing the dynamically allocated clone
+			 * table, not the static one. We do not want
+			 * to create a specific data type
+			 */
+			free((void *)p->name);
 
-		/*
-		 * first PERF_MAX_UMASKS are pre-allocated
-		 * the rest is in a separate dynamic table
-		 */
-		for (j=0; j < p->numasks; j++) {
-			if (j == PERF_MAX_UMASKS)
-				break;
-			free((void *)p->umasks[j].uname);
+			/*
+			 * overflow unit masks may have been moved,
+			 * only the current ones are freed
+			 */
+			for (j=0; j < p->numasks; j++)
+				free((void *)perf_attridx2um(i, j)->uname);
 		}
+		free(perf_pe);
 	}
-	/*
-	 * perf_pe is systematically allocated
-	 */
-	free(perf_pe);
-	perf_pe = NULL;
+	perf_pe = perf_static_events;
 	perf_pe_free = perf_pe_end = NULL;
+	perf_pe_count = 0;
 
-	if (perf_um) {
-		int n;
-		/*
-		 * free the dynamic umasks' uname
-		 */
-		n = perf_um_free - perf_um;
-		for(i=0; i < n; i++) {
-			free((void *)(perf_um[i].uname));
-		}
-		free(perf_um);
-		perf_um = NULL;
-		perf_um_free = perf_um_end = NULL;
+	free(perf_um);
+	perf_um = NULL;
+	perf_um_free = perf_um_end = NULL;
+	perf_um_count = 0;
+
+	for (i=0; i < perf_nretired; i++)
+		free(perf_retired[i]);
+	free(perf_retired);
+	perf_retired = NULL;
+	perf_nretired = 0;
+
+	perf_event_support.pme_count = PME_PERF_EVENT_COUNT;
+	perf_tp_listed = 0;
+}
+
+/*
+ * generic hardware and cache events are counted by the core PMU, the kernel
+ * picks the actual event and its constraints are unknown here, so any of the
+ * generic counters of the default core PMU. No core PMU, no counter.
+ */
+static uint64_t
+pfm_perf_get_event_cntmsk(void *this, pfmlib_event_desc_t *e)
+{
+	pfmlib_pmu_t *pmu;
+
+	switch(perf_pe[e->event].type) {
+	case PERF_TYPE_HARDWARE:
+	case PERF_TYPE_HW_CACHE:
+		break;
+	default:
+		return 0;
+	}
+
+	pmu = pfmlib_get_pmu_by_type(PFM_PMU_TYPE_CORE);
+	if (!pmu) {
+		DPRINT("no core CPU PMU, %s does not use a counter\n", perf_pe[e->event].name);
+		return 0;
 	}
+	return pfmlib_pmu_cntmsk(pmu) & 0xffffffffULL;
 }
 
 static int
@@ -991,6 +1503,8 @@ pfmlib_pmu_t perf_event_support={
 	.pmu_detect		= pfm_perf_detect,
 	.pmu_init		= pfm_perf_init,
 	.pmu_terminate		= pfm_perf_terminate,
+	.resolve_event		= pfm_perf_resolve_event,
+	.get_num_events		= pfm_perf_get_num_events,
 	.get_event_encoding[PFM_OS_NONE] = pfm_perf_get_encoding,
 	 PFMLIB_ENCODE_PERF(pfm_perf_get_perf_encoding),
 	.get_event_first	= pfm_perf_get_event_first,
@@ -1000,5 +1514,6 @@ pfmlib_pmu_t perf_event_support={
 	.get_event_attr_info	= pfm_perf_get_event_attr_info,
 	.validate_table		= pfm_perf_validate_table,
 	.get_event_nattrs	= pfm_perf_get_event_nattrs,
+	.get_event_cntmsk	= pfm_perf_get_event_cntmsk,
 	 PFMLIB_VALID_PERF_PATTRS(pfm_perf_perf_validate_pattrs),
 };
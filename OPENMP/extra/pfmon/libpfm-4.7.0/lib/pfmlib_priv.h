@@ -79,6 +79,19 @@ typedef struct {
  */
 #define PFMLIB_MAX_PATTRS	(PFMLIB_MAX_ATTRS+1)
 
+/*
+ * caller provided memory used instead of the heap
+ * by pfm_get_os_event_encoding_r(), never freed
+ */
+typedef struct {
+	char	*base;		/* start of scratch memory */
+	size_t	size;		/* size of scratch memory */
+	size_t	used;		/* bytes handed out */
+	int	full;		/* an allocation did not fit */
+} pfmlib_arena_t;
+
+#define PFMLIB_ARENA_ALIGN	((size_t)sizeof(uint64_t))
+
 struct pfmlib_pmu;
 typedef struct {
 	struct pfmlib_pmu	*pmu;				/* pmu */
@@ -94,8 +107,58 @@ typedef struct {
 	char			fstr[PFMLIB_EVT_MAX_NAME_LEN];	/* fully qualified event string */
 	uint64_t		codes[PFMLIB_MAX_ENCODING];	/* event encoding */
 	void			*os_data;
+	pfmlib_arena_t		*arena;				/* scratch memory, NULL for heap */
 } pfmlib_event_desc_t;
 #define modx(atdesc, a, z)	(atdesc[(a)].z)
+
+/*
+ * per-PMU hash index of event names, built on first lookup
+ * (open addressing, linear probing, case insensitive)
+ */
+typedef struct {
+	const char	*name;		/* event name, owned by the PMU table */
+	unsigned int	hash;		/* hash of lowercase name */
+	int		pidx;		/* private event index, -1 if slot free */
+} pfmlib_event_index_entry_t;
+
+typedef struct pfmlib_event_index {
+	unsigned int			mask;	/* number of slots - 1 */
+	unsigned int			count;	/* number of used slots */
+	struct pfmlib_event_index	*retired; /* smaller index replaced by this one */
+	pfmlib_event_index_entry_t	slots[];
+} pfmlib_event_index_t;
+
+/*
+ * minimal perfect hash of names, generated at build time
+ * (gen_event_hash.c) as const data
+ *
+ * key k of name s: d = disp[pfmlib_phash(s, seed) % nbuckets],
+ * k = pfmlib_phash(s, seed ^ (d * PFMLIB_PHASH_MULT)) % nkeys
+ * slot[k] >= 0 is the only index for the name, otherwise
+ * -(slot[k] + 1) is the offset in list[] of the indexes
+ * for the name, terminated by -1. The hash does not store
+ * the names, a match must be checked against the table.
+ */
+#define PFMLIB_PHASH_MULT	0x9e3779b9U
+
+typedef struct {
+	unsigned int	nkeys;		/* number of distinct names */
+	unsigned int	nbuckets;	/* number of displacements */
+	const unsigned int *disp;	/* displacement per bucket */
+	const int	*slot;		/* index, or list offset, per key */
+	const int	*list;		/* indexes of duplicated names */
+} pfmlib_phash_t;
+
+typedef struct {
+	int		pme_count;	/* table the hashes were built from */
+	const char	*first;		/* name of event 0 */
+	const char	*last;		/* name of event pme_count - 1 */
+	pfmlib_phash_t	events;		/* event name -> private index */
+	pfmlib_phash_t	umasks;		/* event index + umask name -> attr index */
+} pfmlib_pmu_phash_t;
+
+extern const pfmlib_pmu_phash_t *const pfmlib_pmu_phashes[PFM_PMU_MAX];
+
 #define attr(e, k)		((e)->pattrs + (e)->attrs[k].id)
 
 typedef struct pfmlib_pmu {
@@ -141,6 +204,13 @@ typedef struct pfmlib_pmu {
 	int 		 (*get_num_events)(void *this);
 	void		 (*display_reg)(void *this, pfmlib_event_desc_t *e, void *val);
 	int 		 (*match_event)(void *this, pfmlib_event_desc_t *d, const char *e, const char *s);
+	int		 (*resolve_event)(void *this, int pidx, const char *e, const char *attrs);
+	uint64_t	 (*get_event_cntmsk)(void *this, pfmlib_event_desc_t *e);
+	int		 (*get_event_umask_grp)(void *this, int pidx, int attr_idx, int *flags);
+
+	pfmlib_event_index_t *evt_index;	/* event name index (library private) */
+	const pfmlib_pmu_phash_t *evt_phash;	/* build-time name hashes (library private) */
+	int evt_phash_checked;			/* evt_phash checked against the PMU table */
 } pfmlib_pmu_t;
 
 typedef struct {
@@ -151,11 +221,17 @@ typedef struct {
 	int				(*detect)(void *this);
 	int				(*get_os_attr_info)(void *this, pfmlib_event_desc_t *e);
 	int				(*get_os_nattrs)(void *this, pfmlib_event_desc_t *e);
-	int				(*encode)(void *this, const char *str, int dfl_plm, void *args);
+	int				(*encode)(void *this, const char *str, int dfl_plm, void *args, pfmlib_arena_t *arena);
 } pfmlib_os_t;
 
 #define PFMLIB_OS_FL_ACTIVATED	0x1	/* OS layer detected */
 
+/*
+ * get_event_umask_grp() flags
+ */
+#define PFMLIB_GRP_NCOMBO	0x1	/* unit mask cannot be combined with others of its group */
+#define PFMLIB_GRP_EXCL		0x2	/* event takes unit masks from a single group */
+
 /*
  * pfmlib_pmu_t common flags (LSB 16 bits)
  */
@@ -164,6 +240,8 @@ typedef struct {
 #define PFMLIB_PMU_FL_RAW_UMASK	0x4	/* PMU supports PFM_ATTR_RAW_UMASKS */
 #define PFMLIB_PMU_FL_ARCH_DFL	0x8	/* PMU is arch default */
 #define PFMLIB_PMU_FL_NO_SMPL	0x10	/* PMU does not support sampling */
+#define PFMLIB_PMU_FL_LAZY	0x20	/* PMU detected, pmu_init() deferred (LIBPFM_LAZY_INIT) */
+#define PFMLIB_PMU_FL_LAZY_FAIL	0x40	/* deferred pmu_init() failed */
 
 typedef struct {
 	int	initdone;
@@ -171,8 +249,15 @@ typedef struct {
 	int	verbose;
 	int	debug;
 	int	inactive;
+	int	no_evt_index;	/* do not hash event names (LIBPFM_NO_EVENT_INDEX) */
+	int	no_evt_phash;	/* ignore build-time name hashes (LIBPFM_NO_EVENT_PHASH) */
+	int	encode_cache;	/* encoding cache entries (LIBPFM_ENCODE_CACHE) */
+	int	lazy_init;	/* defer pmu_init() to first use (LIBPFM_LAZY_INIT) */
 	char	*forced_pmu;
 	char	*blacklist_pmus;
+	char	*debugfs_mnt;	/* debugfs mount point override (LIBPFM_DEBUGFS) */
+	char	*tp_cache;	/* tracepoint list cache file (LIBPFM_TRACEPOINT_CACHE) */
+	char	*event_db;	/* compiled event database file (LIBPFM_EVENT_DB) */
 	FILE 	*fp;	/* verbose and debug file descriptor, default stderr or PFMLIB_DEBUG_STDOUT */
 } pfmlib_config_t;	
 
@@ -192,6 +277,36 @@ extern int pfmlib_build_fstr(pfmlib_event_desc_t *e, char **fstr);
 extern void pfmlib_sort_attr(pfmlib_event_desc_t *e);
 extern pfmlib_pmu_t * pfmlib_get_pmu_by_type(pfm_pmu_type_t t);
 extern void pfmlib_release_event(pfmlib_event_desc_t *e);
+extern void *pfmlib_event_alloc(pfmlib_event_desc_t *e, size_t sz);
+extern char *pfmlib_event_strdup(pfmlib_event_desc_t *e, const char *s);
+extern void pfmlib_event_free(pfmlib_event_desc_t *e, void *p);
+extern int pfmlib_event_index_add(pfmlib_pmu_t *pmu, const char *name, int pidx);
+extern unsigned int pfmlib_phash(const char *s, unsigned int seed);
+extern int pfmlib_phash_lookup(const pfmlib_phash_t *h, const char *s, unsigned int seed, const int **list);
+extern pfmlib_pmu_t *pfmlib_get_pmu_by_idx(int i);
+extern uint64_t pfmlib_pmu_cntmsk(pfmlib_pmu_t *pmu);
+
+/*
+ * encoding cache key, in is the part of the OS specific
+ * input which changes the result of the encoding
+ */
+typedef struct {
+	const char	*str;		/* event string */
+	int		dfl_plm;	/* default priv level mask */
+	pfm_os_t	osid;		/* OS layer */
+	const void	*in;		/* OS specific input, may be NULL */
+	size_t		in_sz;		/* size of in */
+} pfmlib_encode_key_t;
+
+extern int pfmlib_encode_cache_get(const pfmlib_encode_key_t *k, void *out, size_t *out_sz, int *idx, int *cpu, char **fstr);
+extern void pfmlib_encode_cache_put(const pfmlib_encode_key_t *k, const void *out, size_t out_sz, int idx, int cpu, const char *fstr);
+extern int pfmlib_encode_cache_set(int max_entries);
+extern void pfmlib_encode_cache_fini(void);
+
+extern void pfmlib_event_db_load(const char *path);
+extern void pfmlib_event_db_unload(void);
+extern int pfmlib_event_db_event_info(pfmlib_pmu_t *pmu, int pidx, pfm_os_t os, pfm_event_info_t *info);
+extern int pfmlib_event_db_attr_info(pfmlib_pmu_t *pmu, int pidx, int attr_idx, pfm_os_t os, pfm_event_attr_info_t *info);
 
 extern size_t pfmlib_check_struct(void *st, size_t usz, size_t refsz, size_t sz);
 
@@ -0,0 +1,143 @@
+/*
+ * bench_util.c - helpers shared by the benchmarks
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * This file is part of libpfm, a performance monitoring support library for
+ * applications on Linux.
+ */
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <perfmon/err.h>
+
+#include "bench_util.h"
+
+char **bench_names;
+int bench_num_names;
+static int max_names;
+
+/*
+ * monotonic time in seconds
+ */
+double
+bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*
+ * PMU named in pmus[], or active if npmus is 0
+ */
+int
+bench_pmu_selected(const pfm_pmu_info_t *pinfo, char **pmus, int npmus)
+{
+	int j;
+
+	if (!npmus)
+		return pinfo->is_present;
+
+	for (j = 0; j < npmus; j++)
+		if (!strcmp(pmus[j], pinfo->name))
+			return 1;
+	return 0;
+}
+
+/*
+ * append a copy of str to bench_names
+ */
+void
+bench_add_name(const char *str)
+{
+	char **p;
+
+	if (bench_num_names == max_names) {
+		max_names = max_names ? 2 * max_names : 256;
+		p = realloc(bench_names, max_names * sizeof(*p));
+		if (!p)
+			errx(1, "cannot allocate event names");
+		bench_names = p;
+	}
+	bench_names[bench_num_names] = strdup(str);
+	if (!bench_names[bench_num_names])
+		errx(1, "cannot allocate event names");
+	bench_num_names++;
+}
+
+void
+bench_free_names(void)
+{
+	while (bench_num_names)
+		free(bench_names[--bench_num_names]);
+}
+
+/*
+ * the fully qualified names of all the events of the selected PMUs,
+ * or of all active PMUs if none are selected, with with_umasks also
+ * one name per event and unit mask
+ */
+void
+bench_collect_names(char **pmus, int npmus, int with_umasks)
+{
+	pfm_event_attr_info_t ainfo;
+	pfm_event_info_t info;
+	pfm_pmu_info_t pinfo;
+	pfm_pmu_t p;
+	char *str;
+	int i, j, ret;
+
+	memset(&pinfo, 0, sizeof(pinfo));
+	memset(&info, 0, sizeof(info));
+	memset(&ainfo, 0, sizeof(ainfo));
+	pinfo.size = sizeof(pinfo);
+	info.size = sizeof(info);
+	ainfo.size = sizeof(ainfo);
+
+	pfm_for_all_pmus(p) {
+		ret = pfm_get_pmu_info(p, &pinfo);
+		if (ret != PFM_SUCCESS)
+			continue;
+		if (!bench_pmu_selected(&pinfo, pmus, npmus))
+			continue;
+
+		for (i = pinfo.first_event; i != -1; i = pfm_get_event_next(i)) {
+			ret = pfm_get_event_info(i, PFM_OS_NONE, &info);
+			if (ret != PFM_SUCCESS)
+				continue;
+			if (asprintf(&str, "%s::%s", pinfo.name, info.name) < 0)
+				errx(1, "cannot allocate event names");
+			bench_add_name(str);
+			free(str);
+
+			for (j = 0; with_umasks && j < info.nattrs; j++) {
+				ret = pfm_get_event_attr_info(i, j, PFM_OS_NONE, &ainfo);
+				if (ret != PFM_SUCCESS || ainfo.type != PFM_ATTR_UMASK)
+					continue;
+				if (asprintf(&str, "%s::%s:%s", pinfo.name, info.name, ainfo.name) < 0)
+					errx(1, "cannot allocate event names");
+				bench_add_name(str);
+				free(str);
+			}
+		}
+	}
+}
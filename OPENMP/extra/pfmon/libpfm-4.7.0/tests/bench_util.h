@@ -0,0 +1,38 @@
+/*
+ * bench_util.h - helpers shared by the benchmarks
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * This file is part of libpfm, a performance monitoring support library for
+ * applications on Linux.
+ */
+#ifndef __BENCH_UTIL_H__
+#define __BENCH_UTIL_H__
+
+#include <perfmon/pfmlib.h>
+
+extern char **bench_names;	/* event strings, see bench_add_name() */
+extern int bench_num_names;
+
+extern double bench_now(void);
+extern int bench_pmu_selected(const pfm_pmu_info_t *pinfo, char **pmus, int npmus);
+extern void bench_add_name(const char *str);
+extern void bench_free_names(void);
+extern void bench_collect_names(char **pmus, int npmus, int with_umasks);
+
+#endif /* __BENCH_UTIL_H__ */
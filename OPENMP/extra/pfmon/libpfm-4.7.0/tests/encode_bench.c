@@ -0,0 +1,424 @@
+/*
+ * encode_bench.c - event lookup and encoding throughput
+ *
+ * runs with the build-time name hashes, with the event name index built
+ * at runtime, without either and with the encoding cache
+ *
+ * With -c, prints instead the per PMU cost of the event API as CSV, one
+ * line per PMU and operation with the average ns per call:
+ * 	find_event  : pfm_find_event()
+ * 	encode      : pfm_get_os_event_encoding(), PFM_OS_NONE and PFM_OS_PERF_EVENT_EXT
+ * 	event_info  : pfm_get_event_next() + pfm_get_event_info() over all events
+ * 	attr_info   : pfm_get_event_attr_info() over all attributes of all events
+ * 	              (plus the pfm_get_event_info() of the event, per attribute)
+ * plus one line for pfm_initialize() + pfm_terminate() cycles.
+ * Each event string there carries up to two unit masks and the u, k and c=1
+ * modifiers when the PMU has them, i.e., pmu::event:umask1:umask2:u:k:c=1.
+ * Combinations the PMU rejects are simplified until the event encodes.
+ * The output is meant to be collected across versions, the columns do not change.
+ *
+ * Copyright (c) 2010 Google, Inc
+ * Contributed by Stephane Eranian <eranian@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * This file is part of libpfm, a performance monitoring support library for
+ * applications on Linux.
+ */
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <string.h>
+#include <perfmon/err.h>
+
+#include <perfmon/pfmlib.h>
+#ifdef __linux__
+#include <perfmon/pfmlib_perf_event.h>
+#endif
+
+#include "bench_util.h"
+
+#define MAX_STR	512
+
+static int with_umasks;
+
+/*
+ * time count lookups and encodings over all names
+ */
+static void
+run(const char *label, int count, double *find_ns, double *enc_ns)
+{
+	pfm_pmu_encode_arg_t e;
+	uint64_t codes[8];
+	double t;
+	int i, k, found = 0, encoded = 0;
+
+	t = bench_now();
+	for (k = 0; k < count; k++)
+		for (i = 0; i < bench_num_names; i++)
+			found += pfm_find_event(bench_names[i]) >= 0;
+	*find_ns = (bench_now() - t) * 1e9 / ((double)count * bench_num_names);
+
+	t = bench_now();
+	for (k = 0; k < count; k++)
+		for (i = 0; i < bench_num_names; i++) {
+			memset(&e, 0, sizeof(e));
+			e.codes = codes;
+			e.count = 8;
+			/* events with required umasks fail, lookup cost is the same */
+			encoded += pfm_get_os_event_encoding(bench_names[i], PFM_PLM3, PFM_OS_NONE, &e) == PFM_SUCCESS;
+		}
+	*enc_ns = (bench_now() - t) * 1e9 / ((double)count * bench_num_names);
+
+	printf("%-10s %12.1f %12.1f %8d %8d\n", label, *find_ns, *enc_ns,
+	       found / count, encoded / count);
+}
+
+/*
+ * the index settings are read by pfm_initialize()
+ */
+static void
+reinit(const char *no_phash, const char *no_index)
+{
+	int ret;
+
+	pfm_terminate();
+	if (no_phash)
+		setenv("LIBPFM_NO_EVENT_PHASH", no_phash, 1);
+	else
+		unsetenv("LIBPFM_NO_EVENT_PHASH");
+	if (no_index)
+		setenv("LIBPFM_NO_EVENT_INDEX", no_index, 1);
+	else
+		unsetenv("LIBPFM_NO_EVENT_INDEX");
+	ret = pfm_initialize();
+	if (ret != PFM_SUCCESS)
+		errx(1, "cannot initialize libpfm: %s", pfm_strerror(ret));
+}
+
+static int
+encode_none(const char *str)
+{
+	pfm_pmu_encode_arg_t e;
+	uint64_t codes[8];
+
+	memset(&e, 0, sizeof(e));
+	e.codes = codes;
+	e.count = 8;
+	return pfm_get_os_event_encoding(str, PFM_PLM0|PFM_PLM3, PFM_OS_NONE, &e);
+}
+
+#ifdef __linux__
+static int
+encode_perf(const char *str)
+{
+	struct perf_event_attr attr;
+	pfm_perf_encode_arg_t arg;
+
+	memset(&attr, 0, sizeof(attr));
+	memset(&arg, 0, sizeof(arg));
+	arg.attr = &attr;
+	arg.size = sizeof(arg);
+	return pfm_get_os_event_encoding(str, PFM_PLM0|PFM_PLM3, PFM_OS_PERF_EVENT_EXT, &arg);
+}
+#endif
+
+/*
+ * pmu::event with unit masks and modifiers, simplified until it encodes
+ */
+static void
+add_event(const char *pmu, int idx, const pfm_event_info_t *info)
+{
+	pfm_event_attr_info_t ainfo;
+	const char *um[2] = { NULL, NULL };
+	char str[MAX_STR], mods[64];
+	int i, n = 0, u = 0, k = 0, c = 0, try;
+
+	memset(&ainfo, 0, sizeof(ainfo));
+	ainfo.size = sizeof(ainfo);
+
+	for (i = 0; i < info->nattrs; i++) {
+		if (pfm_get_event_attr_info(idx, i, PFM_OS_NONE, &ainfo) != PFM_SUCCESS)
+			continue;
+		if (ainfo.type == PFM_ATTR_UMASK && n < 2)
+			um[n++] = ainfo.name;
+		else if (ainfo.type == PFM_ATTR_MOD_BOOL && !strcmp(ainfo.name, "u"))
+			u = 1;
+		else if (ainfo.type == PFM_ATTR_MOD_BOOL && !strcmp(ainfo.name, "k"))
+			k = 1;
+		else if (ainfo.type == PFM_ATTR_MOD_INTEGER && !strcmp(ainfo.name, "c"))
+			c = 1;
+	}
+	snprintf(mods, sizeof(mods), "%s%s%s", u ? ":u" : "", k ? ":k" : "", c ? ":c=1" : "");
+
+	/* two unit masks + modifiers, one unit mask + modifiers, modifiers, plain */
+	for (try = 0; try < 4; try++) {
+		snprintf(str, sizeof(str), "%s::%s%s%s%s%s%s", pmu, info->name,
+			 try < 2 && um[0] ? ":" : "", try < 2 && um[0] ? um[0] : "",
+			 try < 1 && um[1] ? ":" : "", try < 1 && um[1] ? um[1] : "",
+			 try < 3 ? mods : "");
+		if (encode_none(str) == PFM_SUCCESS) {
+			bench_add_name(str);
+			return;
+		}
+	}
+}
+
+/*
+ * iterate count times over the events of the PMU, with attrs
+ * over their attributes, n is the number of calls per pass
+ */
+static double
+time_info(const pfm_pmu_info_t *pinfo, int count, int attrs, int *n)
+{
+	pfm_event_attr_info_t ainfo;
+	pfm_event_info_t info;
+	double t;
+	int i, j, k;
+
+	memset(&info, 0, sizeof(info));
+	memset(&ainfo, 0, sizeof(ainfo));
+	info.size = sizeof(info);
+	ainfo.size = sizeof(ainfo);
+
+	t = bench_now();
+	for (k = 0; k < count; k++) {
+		*n = 0;
+		for (i = pinfo->first_event; i != -1; i = pfm_get_event_next(i)) {
+			if (pfm_get_event_info(i, PFM_OS_NONE, &info) != PFM_SUCCESS)
+				continue;
+			if (!attrs) {
+				(*n)++;
+				continue;
+			}
+			for (j = 0; j < info.nattrs; j++)
+				pfm_get_event_attr_info(i, j, PFM_OS_NONE, &ainfo);
+			*n += info.nattrs;
+		}
+	}
+	/* attr_info includes the event_info needed to get nattrs */
+	return *n ? (bench_now() - t) * 1e9 / ((double)count * *n) : 0.0;
+}
+
+static double
+time_find(int count)
+{
+	double t;
+	int i, k;
+
+	t = bench_now();
+	for (k = 0; k < count; k++)
+		for (i = 0; i < bench_num_names; i++)
+			pfm_find_event(bench_names[i]);
+	return (bench_now() - t) * 1e9 / ((double)count * bench_num_names);
+}
+
+static double
+time_encode(int count, int (*encode)(const char *))
+{
+	double t;
+	int i, k;
+
+	t = bench_now();
+	for (k = 0; k < count; k++)
+		for (i = 0; i < bench_num_names; i++)
+			encode(bench_names[i]);
+	return (bench_now() - t) * 1e9 / ((double)count * bench_num_names);
+}
+
+static double
+time_init(int count)
+{
+	double t;
+	int i, ret;
+
+	pfm_terminate();
+
+	t = bench_now();
+	for (i = 0; i < count; i++) {
+		ret = pfm_initialize();
+		if (ret != PFM_SUCCESS)
+			errx(1, "cannot initialize libpfm: %s", pfm_strerror(ret));
+		pfm_terminate();
+	}
+	t = (bench_now() - t) * 1e9 / count;
+
+	ret = pfm_initialize();
+	if (ret != PFM_SUCCESS)
+		errx(1, "cannot initialize libpfm: %s", pfm_strerror(ret));
+	return t;
+}
+
+static void
+row(const char *pmu, const char *op, const char *os, int n, int count, double ns)
+{
+	printf("%s,%s,%s,%d,%d,%.1f\n", pmu, op, os, n, count, ns);
+}
+
+/*
+ * per PMU cost of the event API, one CSV line per operation
+ */
+static void
+run_csv(int count, int icount, char **pmus, int npmus)
+{
+	pfm_event_info_t info;
+	pfm_pmu_info_t pinfo;
+	pfm_pmu_t p;
+	double ns;
+	int i, n, ret;
+
+	printf("pmu,op,os,n,count,ns_per_op\n");
+
+	memset(&pinfo, 0, sizeof(pinfo));
+	memset(&info, 0, sizeof(info));
+	pinfo.size = sizeof(pinfo);
+	info.size = sizeof(info);
+
+	pfm_for_all_pmus(p) {
+		ret = pfm_get_pmu_info(p, &pinfo);
+		if (ret != PFM_SUCCESS)
+			continue;
+		if (!bench_pmu_selected(&pinfo, pmus, npmus))
+			continue;
+
+		ns = time_info(&pinfo, count, 0, &n);
+		row(pinfo.name, "event_info", "none", n, count, ns);
+		ns = time_info(&pinfo, count, 1, &n);
+		row(pinfo.name, "attr_info", "none", n, count, ns);
+
+		for (i = pinfo.first_event; i != -1; i = pfm_get_event_next(i))
+			if (pfm_get_event_info(i, PFM_OS_NONE, &info) == PFM_SUCCESS)
+				add_event(pinfo.name, i, &info);
+
+		if (bench_num_names) {
+			row(pinfo.name, "find_event", "none", bench_num_names, count, time_find(count));
+			row(pinfo.name, "encode", "none", bench_num_names, count, time_encode(count, encode_none));
+#ifdef __linux__
+			/* perf_events may not be available */
+			if (encode_perf(bench_names[0]) == PFM_SUCCESS)
+				row(pinfo.name, "encode", "perf_ext", bench_num_names, count, time_encode(count, encode_perf));
+#endif
+		}
+		bench_free_names();
+	}
+
+	row("all", "init_terminate", "none", 1, icount, time_init(icount));
+}
+
+static void
+usage(void)
+{
+	printf("encode_bench [-h] [-u] [-c] [-n count] [-i count] [pmu ...]\n"
+		"-h\t\tget help\n"
+		"-u\t\talso encode each event with each of its unit masks\n"
+		"-c\t\tper PMU cost of the event API, CSV output\n"
+		"-n count\trepeat each lookup count times (default 20)\n"
+		"-i count\tnumber of initialize/terminate cycles with -c (default 100)\n"
+		"pmu\t\tuse the events of these PMUs, active or not (default: active PMUs)\n"
+		"-c output: pmu,op,os,n,count,ns_per_op where n is the number of strings,\n"
+		"events or attributes the operation was applied to\n");
+}
+
+int
+main(int argc, char **argv)
+{
+	pfm_encode_cache_info_t cinfo;
+	double find_ph, enc_ph, find_idx, enc_idx, find_lin, enc_lin;
+	int count = 20, icount = 100, csv = 0, c, ret;
+
+	while ((c = getopt(argc, argv, "hucn:i:")) != -1) {
+		switch (c) {
+		case 'u':
+			with_umasks = 1;
+			break;
+		case 'c':
+			csv = 1;
+			break;
+		case 'n':
+			count = atoi(optarg);
+			break;
+		case 'i':
+			icount = atoi(optarg);
+			break;
+		case 'h':
+			usage();
+			exit(0);
+		default:
+			usage();
+			exit(1);
+		}
+	}
+	if (count < 1)
+		count = 1;
+	if (icount < 1)
+		icount = 1;
+
+	/* allow named PMUs to be used even if not detected */
+	if (optind < argc)
+		setenv("LIBPFM_ENCODE_INACTIVE", "1", 1);
+
+	unsetenv("LIBPFM_NO_EVENT_PHASH");
+	unsetenv("LIBPFM_NO_EVENT_INDEX");
+	ret = pfm_initialize();
+	if (ret != PFM_SUCCESS)
+		errx(1, "cannot initialize libpfm: %s", pfm_strerror(ret));
+
+	if (csv) {
+		run_csv(count, icount, argv + optind, argc - optind);
+		pfm_terminate();
+		return 0;
+	}
+
+	bench_collect_names(argv + optind, argc - optind, with_umasks);
+	if (!bench_num_names)
+		errx(1, "no events found");
+
+	printf("%d events, %d iterations, ns per call\n", bench_num_names, count);
+	printf("%-10s %12s %12s %8s %8s\n", "lookup", "find_event", "encode", "found", "encoded");
+
+	run("phash", count, &find_ph, &enc_ph);
+
+	reinit("1", NULL);
+	run("index", count, &find_idx, &enc_idx);
+
+	reinit("1", "1");
+	run("linear", count, &find_lin, &enc_lin);
+
+	printf("speedup    %12.2f %12.2f (phash vs. linear)\n", find_lin / find_ph, enc_lin / enc_ph);
+	printf("speedup    %12.2f %12.2f (phash vs. index)\n", find_idx / find_ph, enc_idx / enc_ph);
+
+	/* name hashes and encoding cache, one entry per event */
+	reinit(NULL, NULL);
+	ret = pfm_set_encode_cache(bench_num_names);
+	if (ret != PFM_SUCCESS)
+		errx(1, "cannot enable encoding cache: %s", pfm_strerror(ret));
+	run("cache", count, &find_idx, &enc_idx);
+
+	memset(&cinfo, 0, sizeof(cinfo));
+	cinfo.size = sizeof(cinfo);
+	ret = pfm_get_encode_cache_info(&cinfo);
+	if (ret == PFM_SUCCESS)
+		printf("speedup    %12s %12.2f (%"PRIu64" hits, %"PRIu64" misses)\n", "",
+			enc_lin / enc_idx, cinfo.hits, cinfo.misses);
+
+	pfm_terminate();
+	bench_free_names();
+	return 0;
+}
@@ -0,0 +1,241 @@
+/*
+ * init_bench.c - library initialization latency, eager vs. lazy PMU init
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * This file is part of libpfm, a performance monitoring support library for
+ * applications on Linux.
+ *
+ * For each mode (LIBPFM_LAZY_INIT unset, then set) measures:
+ * 	init   : pfm_initialize() + pfm_terminate()
+ * 	encode : same, plus the encoding of one event
+ * 	check  : a full run of the check_events example, as a new process
+ * With -t, the tracepoints are read from a generated debugfs tree with the
+ * given number of subsystems and events per subsystem (LIBPFM_DEBUGFS).
+ * Tracepoints are named subsysN:eventM, e.g., -t 300 -e subsys0:event0.
+ * check lists all events, set LIBPFM_TRACEPOINT_CACHE to measure the cache.
+ */
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <perfmon/err.h>
+
+#include <perfmon/pfmlib.h>
+
+#include "bench_util.h"
+
+static char tree[] = "/tmp/pfm_init_bench.XXXXXX";
+static int nsubsys, nevents = 20;
+
+static void
+xmkdir(const char *path)
+{
+	if (mkdir(path, 0755) && errno != EEXIST)
+		err(1, "cannot create %s", path);
+}
+
+/*
+ * tree/tracing/events/subsysN/eventM/id
+ */
+static void
+make_tree(void)
+{
+	char path[1024], id[32];
+	int i, j, fd, n = 1;
+
+	if (!mkdtemp(tree))
+		err(1, "cannot create %s", tree);
+
+	snprintf(path, sizeof(path), "%s/tracing", tree);
+	xmkdir(path);
+	snprintf(path, sizeof(path), "%s/tracing/events", tree);
+	xmkdir(path);
+
+	for (i = 0; i < nsubsys; i++) {
+		snprintf(path, sizeof(path), "%s/tracing/events/subsys%d", tree, i);
+		xmkdir(path);
+		for (j = 0; j < nevents; j++, n++) {
+			snprintf(path, sizeof(path), "%s/tracing/events/subsys%d/event%d", tree, i, j);
+			xmkdir(path);
+			snprintf(path, sizeof(path), "%s/tracing/events/subsys%d/event%d/id", tree, i, j);
+			fd = open(path, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+			if (fd == -1)
+				err(1, "cannot create %s", path);
+			snprintf(id, sizeof(id), "%d\n", n);
+			if (write(fd, id, strlen(id)) < 0)
+				err(1, "cannot write %s", path);
+			close(fd);
+		}
+	}
+	setenv("LIBPFM_DEBUGFS", tree, 1);
+}
+
+static void
+remove_tree(void)
+{
+	char cmd[1100];
+
+	snprintf(cmd, sizeof(cmd), "rm -rf %s", tree);
+	if (system(cmd))
+		warnx("cannot remove %s", tree);
+}
+
+/*
+ * average time in microseconds of count init (+ encode) + terminate cycles
+ */
+static double
+time_init(int count, const char *event)
+{
+	pfm_pmu_encode_arg_t e;
+	uint64_t codes[8];
+	double t;
+	int i, ret;
+
+	t = bench_now();
+	for (i = 0; i < count; i++) {
+		ret = pfm_initialize();
+		if (ret != PFM_SUCCESS)
+			errx(1, "cannot initialize libpfm: %s", pfm_strerror(ret));
+		if (event) {
+			memset(&e, 0, sizeof(e));
+			e.codes = codes;
+			e.count = 8;
+			ret = pfm_get_os_event_encoding(event, PFM_PLM3, PFM_OS_NONE, &e);
+			if (ret != PFM_SUCCESS)
+				errx(1, "cannot encode %s: %s", event, pfm_strerror(ret));
+		}
+		pfm_terminate();
+	}
+	return (bench_now() - t) * 1e6 / count;
+}
+
+/*
+ * average time in microseconds of count runs of check_events event
+ */
+static double
+time_check_events(int count, const char *prog, const char *event)
+{
+	double t;
+	pid_t pid;
+	int i, fd, status;
+
+	if (access(prog, X_OK))
+		return -1.0;
+
+	t = bench_now();
+	for (i = 0; i < count; i++) {
+		pid = fork();
+		if (pid == -1)
+			err(1, "cannot fork");
+		if (pid == 0) {
+			fd = open("/dev/null", O_WRONLY);
+			if (fd != -1)
+				dup2(fd, 1);
+			execl(prog, prog, event, (char *)NULL);
+			_exit(127);
+		}
+		if (waitpid(pid, &status, 0) == -1 || !WIFEXITED(status) || WEXITSTATUS(status))
+			errx(1, "%s %s failed", prog, event);
+	}
+	return (bench_now() - t) * 1e6 / count;
+}
+
+static void
+usage(void)
+{
+	printf("init_bench [-h] [-n count] [-t subsys[,events]] [-e event] [-c check_events]\n"
+		"-h\t\tget help\n"
+		"-n count\trepeat each measurement count times (default 20)\n"
+		"-t subsys,events\tuse a generated tracepoint tree (default 20 events per subsystem)\n"
+		"-e event\tevent to encode (default PERF_COUNT_HW_CPU_CYCLES)\n"
+		"-c path\t\tcheck_events program (default ../examples/check_events)\n");
+}
+
+int
+main(int argc, char **argv)
+{
+	const char *event = "PERF_COUNT_HW_CPU_CYCLES";
+	const char *prog = "../examples/check_events";
+	double init[2], enc[2], check[2];
+	char *p;
+	int count = 20, c, lazy;
+
+	while ((c = getopt(argc, argv, "hn:t:e:c:")) != -1) {
+		switch (c) {
+		case 'n':
+			count = atoi(optarg);
+			break;
+		case 't':
+			nsubsys = strtol(optarg, &p, 0);
+			if (*p == ',')
+				nevents = atoi(p + 1);
+			break;
+		case 'e':
+			event = optarg;
+			break;
+		case 'c':
+			prog = optarg;
+			break;
+		case 'h':
+			usage();
+			exit(0);
+		default:
+			usage();
+			exit(1);
+		}
+	}
+	if (count < 1)
+		count = 1;
+
+	if (nsubsys > 0)
+		make_tree();
+
+	for (lazy = 0; lazy < 2; lazy++) {
+		if (lazy)
+			setenv("LIBPFM_LAZY_INIT", "1", 1);
+		else
+			unsetenv("LIBPFM_LAZY_INIT");
+
+		init[lazy]  = time_init(count, NULL);
+		enc[lazy]   = time_init(count, event);
+		check[lazy] = time_check_events(count, prog, event);
+	}
+
+	if (nsubsys > 0) {
+		printf("%d tracepoint subsystems, %d events each\n", nsubsys, nevents);
+		remove_tree();
+	}
+
+	printf("%d iterations, usec per iteration, event %s\n", count, event);
+	printf("%-8s %12s %12s %12s\n", "mode", "init", "encode", "check");
+	for (lazy = 0; lazy < 2; lazy++)
+		printf("%-8s %12.1f %12.1f %12.1f\n", lazy ? "lazy" : "eager",
+			init[lazy], enc[lazy], check[lazy]);
+	printf("%-8s %12.2f %12.2f %12.2f\n", "speedup",
+		init[0] / init[1], enc[0] / enc[1],
+		check[1] > 0 ? check[0] / check[1] : 0.0);
+
+	return 0;
+}
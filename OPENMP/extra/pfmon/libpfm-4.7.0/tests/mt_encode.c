@@ -0,0 +1,361 @@
+/*
+ * mt_encode.c - multi-threaded encoding stress and throughput test
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * This file is part of libpfm, a performance monitoring support library for
+ * applications on Linux.
+ *
+ * All the events of the selected PMUs are encoded by several threads at
+ * the same time and the results compared with a single threaded encoding:
+ * 	locked  : pfm_get_os_event_encoding() serialized by a lock
+ * 	shared  : pfm_get_os_event_encoding() without lock
+ * 	scratch : pfm_get_os_event_encoding_r() with a buffer on the stack
+ * The library is initialized again before each run, so the threads also
+ * race on the lazily built structures (name indexes, deferred PMU init).
+ * When linked with --wrap (see Makefile), the heap allocations made by
+ * the library are counted, there must be none in scratch mode once the
+ * first pass over the events has built the name indexes.
+ */
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <string.h>
+#include <pthread.h>
+#include <perfmon/err.h>
+
+#include <perfmon/pfmlib_perf_event.h>
+
+#include "bench_util.h"
+
+#define MAX_CODES	8
+
+typedef struct {
+	char			*name;
+	int			ok_none;	/* encodes with PFM_OS_NONE */
+	int			ok_perf;	/* encodes with PFM_OS_PERF_EVENT_EXT */
+	int			count;
+	uint64_t		codes[MAX_CODES];
+	char			*fstr;
+	struct perf_event_attr	attr;
+} ref_t;
+
+typedef struct {
+	pthread_t	tid;
+	int		id;
+	int		mode;
+	uint64_t	ops;
+	uint64_t	errors;
+	uint64_t	allocs;
+} worker_t;
+
+enum { MODE_LOCKED, MODE_SHARED, MODE_SCRATCH, MODE_MAX };
+
+static const char *mode_names[MODE_MAX] = { "locked", "shared", "scratch" };
+
+static ref_t *refs;
+static int num_refs, with_umasks, count = 20;
+static pthread_mutex_t encode_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_barrier_t start_barrier;
+
+#ifdef MT_ENCODE_WRAP
+/*
+ * heap allocations by the library, per thread
+ */
+static __thread uint64_t nallocs;
+
+extern void *__real_malloc(size_t sz);
+extern void *__real_calloc(size_t n, size_t sz);
+extern void *__real_realloc(void *p, size_t sz);
+extern char *__real_strdup(const char *s);
+
+void *__wrap_malloc(size_t sz) { nallocs++; return __real_malloc(sz); }
+void *__wrap_calloc(size_t n, size_t sz) { nallocs++; return __real_calloc(n, sz); }
+void *__wrap_realloc(void *p, size_t sz) { nallocs++; return __real_realloc(p, sz); }
+char *__wrap_strdup(const char *s) { nallocs++; return __real_strdup(s); }
+#else
+static __thread uint64_t nallocs;
+#endif
+
+/*
+ * one reference per event name, the names stay in bench_names
+ */
+static void
+collect_refs(char **pmus, int npmus)
+{
+	int i;
+
+	bench_collect_names(pmus, npmus, with_umasks);
+
+	num_refs = bench_num_names;
+	refs = calloc(num_refs ? num_refs : 1, sizeof(*refs));
+	if (!refs)
+		errx(1, "cannot allocate event names");
+	for (i = 0; i < num_refs; i++)
+		refs[i].name = bench_names[i];
+}
+
+/*
+ * single threaded encodings to compare with, also checks
+ * that a scratch buffer too small is reported
+ */
+static int
+build_refs(void)
+{
+	pfm_perf_encode_arg_t parg;
+	pfm_pmu_encode_arg_t arg;
+	char small[16];
+	int i, ret, errors = 0;
+
+	for (i = 0; i < num_refs; i++) {
+		memset(&arg, 0, sizeof(arg));
+		arg.codes = refs[i].codes;
+		arg.count = MAX_CODES;
+		arg.fstr = &refs[i].fstr;
+		ret = pfm_get_os_event_encoding(refs[i].name, PFM_PLM3, PFM_OS_NONE, &arg);
+		if (ret == PFM_SUCCESS) {
+			refs[i].ok_none = 1;
+			refs[i].count = arg.count;
+		}
+
+		memset(&parg, 0, sizeof(parg));
+		parg.attr = &refs[i].attr;
+		ret = pfm_get_os_event_encoding(refs[i].name, PFM_PLM3, PFM_OS_PERF_EVENT_EXT, &parg);
+		if (ret == PFM_SUCCESS)
+			refs[i].ok_perf = 1;
+
+		if (!refs[i].ok_none)
+			continue;
+
+		memset(&arg, 0, sizeof(arg));
+		ret = pfm_get_os_event_encoding_r(refs[i].name, PFM_PLM3, PFM_OS_NONE, &arg, small, sizeof(small));
+		if (ret != PFM_ERR_TOOSMALL) {
+			warnx("%s: small scratch returned %s", refs[i].name, pfm_strerror(ret));
+			errors++;
+		}
+	}
+	return errors;
+}
+
+static int
+encode_one(ref_t *r, int mode, char *scratch, size_t sz)
+{
+	pfm_perf_encode_arg_t parg;
+	pfm_pmu_encode_arg_t arg;
+	struct perf_event_attr attr;
+	uint64_t codes[MAX_CODES];
+	char *fstr = NULL;
+	int i, ret, errors = 0;
+
+	memset(&arg, 0, sizeof(arg));
+	arg.codes = codes;
+	arg.count = MAX_CODES;
+	arg.fstr = &fstr;
+
+	if (mode == MODE_LOCKED)
+		pthread_mutex_lock(&encode_lock);
+	if (mode == MODE_SCRATCH)
+		ret = pfm_get_os_event_encoding_r(r->name, PFM_PLM3, PFM_OS_NONE, &arg, scratch, sz);
+	else
+		ret = pfm_get_os_event_encoding(r->name, PFM_PLM3, PFM_OS_NONE, &arg);
+	if (mode == MODE_LOCKED)
+		pthread_mutex_unlock(&encode_lock);
+
+	if ((ret == PFM_SUCCESS) != r->ok_none)
+		errors++;
+	if (ret == PFM_SUCCESS) {
+		if (arg.count != r->count || !fstr || strcmp(fstr, r->fstr))
+			errors++;
+		for (i = 0; i < arg.count && i < r->count; i++)
+			if (codes[i] != r->codes[i])
+				errors++;
+	}
+	if (mode != MODE_SCRATCH)
+		free(fstr);
+
+	memset(&attr, 0, sizeof(attr));
+	memset(&parg, 0, sizeof(parg));
+	parg.attr = &attr;
+
+	if (mode == MODE_LOCKED)
+		pthread_mutex_lock(&encode_lock);
+	if (mode == MODE_SCRATCH)
+		ret = pfm_get_os_event_encoding_r(r->name, PFM_PLM3, PFM_OS_PERF_EVENT_EXT, &parg, scratch, sz);
+	else
+		ret = pfm_get_os_event_encoding(r->name, PFM_PLM3, PFM_OS_PERF_EVENT_EXT, &parg);
+	if (mode == MODE_LOCKED)
+		pthread_mutex_unlock(&encode_lock);
+
+	if ((ret == PFM_SUCCESS) != r->ok_perf)
+		errors++;
+	if (ret == PFM_SUCCESS && memcmp(&attr, &r->attr, sizeof(attr)))
+		errors++;
+
+	return errors;
+}
+
+static void *
+worker(void *arg)
+{
+	char scratch[PFM_ENCODE_SCRATCH_SIZE];
+	worker_t *w = arg;
+	int i, k, n;
+
+	pthread_barrier_wait(&start_barrier);
+
+	/* threads start at different events */
+	for (k = 0; k < count; k++)
+		for (i = 0; i < num_refs; i++) {
+			n = (i + w->id * 7919) % num_refs;
+			nallocs = 0;
+			w->errors += encode_one(refs + n, w->mode, scratch, sizeof(scratch));
+			/* first pass builds the name indexes */
+			if (w->mode == MODE_SCRATCH && k)
+				w->allocs += nallocs;
+			w->ops += 2;
+		}
+	return NULL;
+}
+
+static void
+usage(void)
+{
+	printf("mt_encode [-h] [-u] [-n count] [-t threads] [-r rounds] [pmu ...]\n"
+		"-h\t\tget help\n"
+		"-u\t\talso encode each event with each of its unit masks\n"
+		"-n count\tencode each event count times per thread (default 20)\n"
+		"-t threads\tnumber of threads (default 4)\n"
+		"-r rounds\tnumber of runs per mode, each with a new initialization (default 2)\n"
+		"pmu\t\tuse the events of these PMUs, active or not (default: active PMUs)\n");
+}
+
+int
+main(int argc, char **argv)
+{
+	worker_t *w;
+	double t, best[MODE_MAX];
+	uint64_t ops, errors, allocs, total_errors = 0;
+	int nthreads = 4, rounds = 2;
+	int c, i, m, r, ret;
+
+	while ((c = getopt(argc, argv, "hun:t:r:")) != -1) {
+		switch (c) {
+		case 'u':
+			with_umasks = 1;
+			break;
+		case 'n':
+			count = atoi(optarg);
+			break;
+		case 't':
+			nthreads = atoi(optarg);
+			break;
+		case 'r':
+			rounds = atoi(optarg);
+			break;
+		case 'h':
+			usage();
+			exit(0);
+		default:
+			usage();
+			exit(1);
+		}
+	}
+	if (count < 1)
+		count = 1;
+	if (nthreads < 1)
+		nthreads = 1;
+	if (rounds < 1)
+		rounds = 1;
+
+	/* allow named PMUs to be used even if not detected */
+	if (optind < argc)
+		setenv("LIBPFM_ENCODE_INACTIVE", "1", 1);
+
+	ret = pfm_initialize();
+	if (ret != PFM_SUCCESS)
+		errx(1, "cannot initialize libpfm: %s", pfm_strerror(ret));
+
+	collect_refs(argv + optind, argc - optind);
+	if (!num_refs)
+		errx(1, "no events found");
+
+	total_errors += build_refs();
+
+	w = calloc(nthreads, sizeof(*w));
+	if (!w)
+		errx(1, "cannot allocate threads");
+
+	printf("%d events, %d threads, %d iterations, %d rounds\n", num_refs, nthreads, count, rounds);
+	printf("%-8s %14s %10s %10s\n", "mode", "encodings/s", "errors", "allocs");
+
+	for (m = 0; m < MODE_MAX; m++) {
+		best[m] = 0;
+		errors = allocs = 0;
+		for (r = 0; r < rounds; r++) {
+			pfm_terminate();
+			ret = pfm_initialize();
+			if (ret != PFM_SUCCESS)
+				errx(1, "cannot initialize libpfm: %s", pfm_strerror(ret));
+
+			pthread_barrier_init(&start_barrier, NULL, nthreads + 1);
+			for (i = 0; i < nthreads; i++) {
+				memset(w + i, 0, sizeof(*w));
+				w[i].id = i;
+				w[i].mode = m;
+				if (pthread_create(&w[i].tid, NULL, worker, w + i))
+					errx(1, "cannot create thread");
+			}
+			t = bench_now();
+			pthread_barrier_wait(&start_barrier);
+
+			ops = 0;
+			for (i = 0; i < nthreads; i++) {
+				pthread_join(w[i].tid, NULL);
+				ops += w[i].ops;
+				errors += w[i].errors;
+				allocs += w[i].allocs;
+			}
+			t = bench_now() - t;
+			pthread_barrier_destroy(&start_barrier);
+
+			if (ops / t > best[m])
+				best[m] = ops / t;
+		}
+		printf("%-8s %14.0f %10"PRIu64" %10"PRIu64"\n", mode_names[m], best[m], errors, allocs);
+		total_errors += errors + allocs;
+	}
+	if (best[MODE_LOCKED] > 0)
+		printf("speedup  %14.2f (scratch vs. locked)\n", best[MODE_SCRATCH] / best[MODE_LOCKED]);
+
+	pfm_terminate();
+
+	for (i = 0; i < num_refs; i++)
+		free(refs[i].fstr);
+	free(refs);
+	bench_free_names();
+	free(w);
+
+	if (total_errors) {
+		printf("FAILED\n");
+		return 1;
+	}
+	printf("All tests passed\n");
+	return 0;
+}
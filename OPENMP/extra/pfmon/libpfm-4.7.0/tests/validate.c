@@ -218,6 +218,62 @@ static const struct_desc_t pfmlib_structs[]={
 		LAST_FIELD
 	 },
 	},
+	{
+	 .name = "pfm_encode_cache_info_t",
+	 .sz   = sizeof(pfm_encode_cache_info_t),
+	 .abi_sz = PFM_ENCODE_CACHE_INFO_ABI0,
+	 .fields= {
+		FIELD(size, pfm_encode_cache_info_t),
+		FIELD(max_entries, pfm_encode_cache_info_t),
+		FIELD(nentries, pfm_encode_cache_info_t),
+		FIELD(hits, pfm_encode_cache_info_t),
+		FIELD(misses, pfm_encode_cache_info_t),
+		FIELD(evictions, pfm_encode_cache_info_t),
+		LAST_FIELD
+	 },
+	},
+	{
+	 .name = "pfm_event_group_arg_t",
+	 .sz   = sizeof(pfm_event_group_arg_t),
+	 .abi_sz = PFM_EVENT_GROUP_ABI0,
+	 .fields= {
+		FIELD(str, pfm_event_group_arg_t),
+		FIELD(size, pfm_event_group_arg_t),
+		FIELD(cntmsk, pfm_event_group_arg_t),
+		FIELD(idx, pfm_event_group_arg_t),
+		FIELD(group, pfm_event_group_arg_t),
+		FIELD(counter, pfm_event_group_arg_t),
+		FIELD(reserved, pfm_event_group_arg_t),
+		LAST_FIELD
+	 },
+	},
+	{
+	 .name = "pfm_event_iter_arg_t",
+	 .sz   = sizeof(pfm_event_iter_arg_t),
+	 .abi_sz = PFM_EVENT_ITER_ARG_ABI0,
+	 .fields= {
+		FIELD(pattern, pfm_event_iter_arg_t),
+		FIELD(size, pfm_event_iter_arg_t),
+		FIELD(pmu, pfm_event_iter_arg_t),
+		FIELD(flags, pfm_event_iter_arg_t),
+		FIELD(max_umasks, pfm_event_iter_arg_t),
+		FIELD(reserved, pfm_event_iter_arg_t),
+		LAST_FIELD
+	 },
+	},
+	{
+	 .name = "pfm_event_iter_info_t",
+	 .sz   = sizeof(pfm_event_iter_info_t),
+	 .abi_sz = PFM_EVENT_ITER_INFO_ABI0,
+	 .fields= {
+		FIELD(str, pfm_event_iter_info_t),
+		FIELD(umasks, pfm_event_iter_info_t),
+		FIELD(size, pfm_event_iter_info_t),
+		FIELD(idx, pfm_event_iter_info_t),
+		FIELD(numasks, pfm_event_iter_info_t),
+		LAST_FIELD
+	 },
+	},
 #ifdef __linux__
 	{
 	 .name = "pfm_perf_encode_arg_t",
@@ -280,6 +336,373 @@ validate_structs(void)
 	return errors;
 }
 
+/*
+ * run the architecture tests twice with the encoding cache enabled,
+ * the second pass must be served from the cache with the same results
+ */
+static int
+validate_encode_cache(void)
+{
+	pfm_encode_cache_info_t info;
+	int ret, errors = 0;
+
+	ret = pfm_set_encode_cache(4096);
+	if (ret != PFM_SUCCESS) {
+		printf("	cannot enable encoding cache: %s\n", pfm_strerror(ret));
+		return 1;
+	}
+
+	errors += validate_arch(stderr);
+	errors += validate_arch(stderr);
+
+	memset(&info, 0, sizeof(info));
+	info.size = sizeof(info);
+
+	ret = pfm_get_encode_cache_info(&info);
+	if (ret != PFM_SUCCESS) {
+		printf("	cannot get encoding cache info: %s\n", pfm_strerror(ret));
+		errors++;
+	} else {
+		printf("	cache: %d entries, %"PRIu64" hits, %"PRIu64" misses, %"PRIu64" evictions\n",
+			info.nentries, info.hits, info.misses, info.evictions);
+		if (info.nentries && !info.hits) {
+			printf("	Failed (no hits)\n");
+			errors++;
+		}
+	}
+
+	ret = pfm_flush_encode_cache();
+	if (ret == PFM_SUCCESS)
+		ret = pfm_get_encode_cache_info(&info);
+	if (ret != PFM_SUCCESS || info.nentries) {
+		printf("	Failed (flush)\n");
+		errors++;
+	}
+
+	pfm_set_encode_cache(0);
+
+	return errors;
+}
+
+/*
+ * count the entries of an event iterator, checking that
+ * each string encodes and starts with prefix
+ */
+static int
+count_event_iter(pfm_event_iter_arg_t *arg, const char *prefix, int *errors)
+{
+	pfm_event_iter_info_t info;
+	pfm_event_iter_t *iter;
+	uint64_t *codes;
+	int ret, count, n = 0;
+
+	memset(&info, 0, sizeof(info));
+	info.size = sizeof(info);
+
+	ret = pfm_event_iter_create(arg, &iter);
+	if (ret != PFM_SUCCESS) {
+		printf("\tcannot create event iterator: %s\n", pfm_strerror(ret));
+		(*errors)++;
+		return 0;
+	}
+	while ((ret = pfm_event_iter_next(iter, &info)) == PFM_SUCCESS) {
+		n++;
+		if (prefix && strncmp(info.str, prefix, strlen(prefix))) {
+			printf("\tFailed (%s does not match %s)\n", info.str, prefix);
+			(*errors)++;
+		}
+		if (!(arg->flags & PFM_ITER_COMBOS))
+			continue;
+		if (arg->max_umasks && info.numasks > arg->max_umasks) {
+			printf("\tFailed (%s has more than %d unit masks)\n", info.str, arg->max_umasks);
+			(*errors)++;
+		}
+		codes = NULL;
+		count = 0;
+		ret = pfm_get_event_encoding(info.str, PFM_PLM0|PFM_PLM3, NULL, NULL, &codes, &count);
+		if (ret != PFM_SUCCESS) {
+			printf("\tFailed (%s does not encode: %s)\n", info.str, pfm_strerror(ret));
+			(*errors)++;
+		}
+		free(codes);
+	}
+	if (ret != PFM_ERR_NOTFOUND) {
+		printf("\tFailed (iteration stopped: %s)\n", pfm_strerror(ret));
+		(*errors)++;
+	}
+	pfm_event_iter_destroy(iter);
+
+	return n;
+}
+
+/*
+ * unit mask combinations of all PMUs must encode, one entry per unit mask
+ * must match the attribute tables, and the regex and PMU filters must agree
+ */
+static int
+validate_event_iter(void)
+{
+	pfm_event_iter_arg_t arg;
+	pfm_event_attr_info_t ainfo;
+	pfm_event_info_t info;
+	pfm_pmu_info_t pinfo;
+	pfm_event_iter_t *iter;
+	char prefix[64];
+	int i, j, k, n, um, expected = 0, errors = 0;
+
+	memset(&arg, 0, sizeof(arg));
+	memset(&pinfo, 0, sizeof(pinfo));
+	memset(&info, 0, sizeof(info));
+	memset(&ainfo, 0, sizeof(ainfo));
+
+	arg.size = sizeof(arg);
+	pinfo.size = sizeof(pinfo);
+	info.size = sizeof(info);
+	ainfo.size = sizeof(ainfo);
+
+	arg.flags = PFM_ITER_COMBOS|PFM_ITER_INACTIVE;
+	arg.max_umasks = 2;
+	n = count_event_iter(&arg, NULL, &errors);
+	printf("\t%d unit mask combinations\n", n);
+
+	pfm_for_all_pmus(i) {
+		if (pfm_get_pmu_info(i, &pinfo) != PFM_SUCCESS)
+			continue;
+		for (j = pinfo.first_event; j != -1; j = pfm_get_event_next(j)) {
+			if (pfm_get_event_info(j, PFM_OS_NONE, &info) != PFM_SUCCESS)
+				continue;
+			um = 0;
+			for (k = 0; k < info.nattrs; k++)
+				if (pfm_get_event_attr_info(j, k, PFM_OS_NONE, &ainfo) == PFM_SUCCESS
+				    && ainfo.type == PFM_ATTR_UMASK)
+					um++;
+			expected += um ? um : 1;
+		}
+		/* filters, on the first PMU with events */
+		if (arg.pmu == PFM_PMU_NONE && pinfo.nevents) {
+			arg.pmu = i;
+			snprintf(prefix, sizeof(prefix), "%s::", pinfo.name);
+		}
+	}
+
+	arg.flags = PFM_ITER_UMASKS|PFM_ITER_INACTIVE;
+	arg.max_umasks = 0;
+	n = count_event_iter(&arg, prefix, &errors);
+
+	arg.pmu = PFM_PMU_NONE;
+	arg.pattern = prefix;
+	if (count_event_iter(&arg, prefix, &errors) != n) {
+		printf("\tFailed (regex and PMU filters differ)\n");
+		errors++;
+	}
+
+	arg.pattern = NULL;
+	n = count_event_iter(&arg, NULL, &errors);
+	if (n != expected) {
+		printf("\tFailed (%d unit mask entries, expected %d)\n", n, expected);
+		errors++;
+	}
+
+	arg.pattern = "[";
+	if (pfm_event_iter_create(&arg, &iter) != PFM_ERR_INVAL) {
+		printf("\tFailed (invalid arguments accepted)\n");
+		errors++;
+	}
+
+	return errors;
+}
+
+#ifndef PFMLIB_WINDOWS
+/*
+ * print what pfm_get_event_info() and pfm_get_event_attr_info() return for
+ * all events of the PMUs, for each OS. names[] holds the name of the first
+ * event of each PMU, set on the first call, moved counts the PMUs for which
+ * it now comes from elsewhere, i.e., the event database
+ */
+static void
+dump_event_db(FILE *fp, const pfm_pmu_t *pmus, int npmus, const char **names, int *moved)
+{
+	pfm_event_attr_info_t ainfo;
+	pfm_event_info_t info;
+	pfm_pmu_info_t pinfo;
+	pfm_os_t os;
+	int i, j, idx, ret;
+
+	*moved = 0;
+
+	for (i = 0; i < npmus; i++) {
+		memset(&pinfo, 0, sizeof(pinfo));
+		pinfo.size = sizeof(pinfo);
+		if (pfm_get_pmu_info(pmus[i], &pinfo) != PFM_SUCCESS)
+			continue;
+
+		for (idx = pinfo.first_event; idx != -1; idx = pfm_get_event_next(idx)) {
+			for (os = PFM_OS_NONE; os < PFM_OS_MAX; os++) {
+				memset(&info, 0, sizeof(info));
+				info.size = sizeof(info);
+				ret = pfm_get_event_info(idx, os, &info);
+				fprintf(fp, "%d %d %d", idx, os, ret);
+				if (ret != PFM_SUCCESS) {
+					fputc('\n', fp);
+					continue;
+				}
+				if (idx == pinfo.first_event && os == PFM_OS_NONE) {
+					if (!names[i])
+						names[i] = info.name;
+					else if (names[i] != info.name)
+						(*moved)++;
+				}
+				fprintf(fp, " %s|%s|%s 0x%"PRIx64" %d %d %d %d %d\n",
+					info.name, info.desc ? info.desc : "",
+					info.equiv ? info.equiv : "", info.code,
+					info.pmu, info.dtype, info.idx, info.nattrs,
+					info.is_precise);
+
+				for (j = 0; j <= info.nattrs; j++) {
+					memset(&ainfo, 0, sizeof(ainfo));
+					ainfo.size = sizeof(ainfo);
+					ret = pfm_get_event_attr_info(idx, j, os, &ainfo);
+					fprintf(fp, "\t%d %d", j, ret);
+					if (ret == PFM_SUCCESS)
+						fprintf(fp, " %s|%s|%s 0x%"PRIx64" %d %d %d %d %d 0x%"PRIx64"",
+							ainfo.name, ainfo.desc ? ainfo.desc : "",
+							ainfo.equiv ? ainfo.equiv : "", ainfo.code,
+							ainfo.type, ainfo.idx, ainfo.ctrl, ainfo.is_dfl,
+							ainfo.is_precise, ainfo.dfl_val64);
+					fputc('\n', fp);
+				}
+			}
+		}
+	}
+	rewind(fp);
+}
+
+static int
+same_files(FILE *a, FILE *b)
+{
+	int c;
+
+	while ((c = fgetc(a)) == fgetc(b))
+		if (c == EOF)
+			return 1;
+	return 0;
+}
+
+static int
+reinit_event_db(const char *path)
+{
+	int ret;
+
+	pfm_terminate();
+
+	if (path)
+		set_env_var("LIBPFM_EVENT_DB", path, 1);
+	else
+		unsetenv("LIBPFM_EVENT_DB");
+
+	ret = pfm_initialize();
+	if (ret != PFM_SUCCESS)
+		printf("\tcannot initialize libpfm: %s\n", pfm_strerror(ret));
+	return ret;
+}
+
+/*
+ * export all supported PMUs, the library must return the same
+ * information from the mapped file, and from the tables when
+ * the file is corrupted
+ */
+static int
+validate_event_db(void)
+{
+	char path[] = "/tmp/validate_event_db.XXXXXX";
+	const char *names[PFM_PMU_MAX];
+	pfm_pmu_t pmus[PFM_PMU_MAX];
+	pfm_pmu_info_t pinfo;
+	FILE *ref = NULL, *out = NULL;
+	int i, fd, npmus = 0, moved, ret, errors = 0;
+
+	memset(&pinfo, 0, sizeof(pinfo));
+	pinfo.size = sizeof(pinfo);
+
+	pfm_for_all_pmus(i) {
+		if (pfm_get_pmu_info(i, &pinfo) == PFM_SUCCESS && pinfo.nevents)
+			pmus[npmus++] = i;
+	}
+	memset(names, 0, sizeof(names));
+
+	fd = mkstemp(path);
+	if (fd == -1) {
+		printf("\tcannot create %s\n", path);
+		return 1;
+	}
+	close(fd);
+
+	ret = pfm_export_event_db(path, pmus, npmus);
+	if (ret != PFM_SUCCESS) {
+		printf("\tcannot export event database: %s\n", pfm_strerror(ret));
+		errors++;
+		goto error;
+	}
+
+	ref = tmpfile();
+	out = tmpfile();
+	if (!(ref && out)) {
+		printf("\tcannot create temporary files\n");
+		errors++;
+		goto error;
+	}
+	dump_event_db(ref, pmus, npmus, names, &moved);
+
+	if (reinit_event_db(path) != PFM_SUCCESS) {
+		errors++;
+		goto error;
+	}
+	dump_event_db(out, pmus, npmus, names, &moved);
+
+	printf("\t%d of %d PMUs served from the event database\n", moved, npmus);
+	if (!moved) {
+		printf("\tFailed (database not used)\n");
+		errors++;
+	}
+	if (!same_files(ref, out)) {
+		printf("\tFailed (database differs from tables)\n");
+		errors++;
+	}
+
+	/* a corrupted file is ignored */
+	if (truncate(path, 4096)) {
+		printf("\tcannot truncate %s\n", path);
+		errors++;
+		goto error;
+	}
+	if (reinit_event_db(path) != PFM_SUCCESS) {
+		errors++;
+		goto error;
+	}
+	rewind(ref);
+	fclose(out);
+	out = tmpfile();
+	if (!out) {
+		errors++;
+		goto error;
+	}
+	dump_event_db(out, pmus, npmus, names, &moved);
+	if (moved || !same_files(ref, out)) {
+		printf("\tFailed (corrupted database used)\n");
+		errors++;
+	}
+error:
+	if (ref)
+		fclose(ref);
+	if (out)
+		fclose(out);
+	unlink(path);
+	if (reinit_event_db(NULL) != PFM_SUCCESS)
+		errors++;
+	return errors;
+}
+#endif
+
 int
 main(int argc, char **argv)
 {
@@ -326,11 +749,21 @@ main(int argc, char **argv)
 	if (options.valid_intern) {
 		printf("Libpfm internal table tests:\n");
 		errors += validate_event_tables();
+
+		printf("Event iterator tests:\n");
+		errors += validate_event_iter();
+#ifndef PFMLIB_WINDOWS
+		printf("Event database tests:\n");
+		errors += validate_event_db();
+#endif
 	}
 
 	if (options.valid_arch) {
 		printf("Architecture specific tests:\n");
 		errors += validate_arch(stderr);
+
+		printf("Encoding cache tests:\n");
+		errors += validate_encode_cache();
 	}
 
 	pfm_terminate();
@@ -4015,8 +4015,153 @@ static int check_test_events(FILE *fp)
 	return errors;
 }
 
+#define MAX_GROUP_EVENTS	12
+
+typedef struct {
+	const char *names[MAX_GROUP_EVENTS];	/* NULL terminated */
+	int groups[MAX_GROUP_EVENTS];		/* expected group of each event */
+	int ret, ngroups;
+	int line;
+} test_group_t;
+
+static const test_group_t x86_test_groups[]={
+	{ SRC_LINE,
+	  /* 3 fixed + 8 generic counters */
+	  .names = { "hsw::BR_INST_RETIRED", "hsw::UNHALTED_CORE_CYCLES",
+		     "hsw::INSTRUCTION_RETIRED", "hsw::UNHALTED_REFERENCE_CYCLES",
+		     "hsw::BR_MISP_RETIRED", "hsw::BACLEARS", "hsw::BR_INST_EXEC",
+		     "hsw::BR_MISP_EXEC", "hsw::CPL_CYCLES:RING0", "hsw::DTLB_LOAD_MISSES:MISS_CAUSES_A_WALK",
+		     "hsw::DTLB_STORE_MISSES:MISS_CAUSES_A_WALK" },
+	  .ret = PFM_SUCCESS,
+	  .ngroups = 1,
+	  .groups = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+	},
+	{ SRC_LINE,
+	  /* cmask: UNHALTED_CORE_CYCLES cannot use its fixed counter */
+	  .names = { "hsw::BR_INST_RETIRED", "hsw::UNHALTED_CORE_CYCLES:c=1",
+		     "hsw::INSTRUCTION_RETIRED", "hsw::UNHALTED_REFERENCE_CYCLES",
+		     "hsw::BR_MISP_RETIRED", "hsw::BACLEARS", "hsw::BR_INST_EXEC",
+		     "hsw::BR_MISP_EXEC", "hsw::CPL_CYCLES:RING0", "hsw::DTLB_LOAD_MISSES:MISS_CAUSES_A_WALK",
+		     "hsw::DTLB_STORE_MISSES:MISS_CAUSES_A_WALK" },
+	  .ret = PFM_SUCCESS,
+	  .ngroups = 2,
+	  .groups = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1 },
+	},
+	{ SRC_LINE,
+	  /* L1D_PEND_MISS:PENDING only counts on counter 2 */
+	  .names = { "hsw::L1D_PEND_MISS:PENDING", "hsw::BR_INST_RETIRED",
+		     "hsw::L1D_PEND_MISS:PENDING" },
+	  .ret = PFM_SUCCESS,
+	  .ngroups = 2,
+	  .groups = { 0, 0, 1 },
+	},
+	{ SRC_LINE,
+	  /* one group per PMU */
+	  .names = { "hsw::BR_INST_RETIRED", "snbep_unc_cbo0::UNC_C_CLOCKTICKS",
+		     "hsw::BACLEARS" },
+	  .ret = PFM_SUCCESS,
+	  .ngroups = 2,
+	  .groups = { 0, 1, 0 },
+	},
+	{ SRC_LINE,
+	  /* generic counters of the core PMU, if any, software events use none */
+	  .names = { "perf::PERF_COUNT_HW_CPU_CYCLES", "perf::PERF_COUNT_SW_CPU_CLOCK",
+		     "perf::PERF_COUNT_HW_CACHE_L1D:READ:ACCESS", "perf::PERF_COUNT_SW_PAGE_FAULTS" },
+	  .ret = PFM_SUCCESS,
+	  .ngroups = 1,
+	  .groups = { 0, 0, 0, 0 },
+	},
+	{ SRC_LINE,
+	  .names = { "hsw::BR_INST_RETIRED", "hsw::NOT_AN_EVENT" },
+	  .ret = PFM_ERR_NOTFOUND,
+	},
+};
+#define NUM_TEST_GROUPS (int)(sizeof(x86_test_groups)/sizeof(test_group_t))
+
+/*
+ * generic counters of the first active core PMU, used by the
+ * perf generic hardware events, 0 without a core PMU
+ */
+static uint64_t core_cntmsk(void)
+{
+	pfm_pmu_info_t info;
+	int i, ret;
+
+	memset(&info, 0, sizeof(info));
+	info.size = sizeof(info);
+
+	pfm_for_all_pmus(i) {
+		ret = pfm_get_pmu_info(i, &info);
+		if (ret != PFM_SUCCESS || !info.is_present || info.type != PFM_PMU_TYPE_CORE)
+			continue;
+		return info.num_cntrs >= 32 ? 0xffffffffULL : (1ULL << info.num_cntrs) - 1;
+	}
+	return 0;
+}
+
+static int check_test_groups(FILE *fp)
+{
+	pfm_event_group_arg_t arg[MAX_GROUP_EVENTS];
+	const test_group_t *t;
+	uint64_t core_msk = core_cntmsk();
+	int i, j, k, n, ret, ngroups, errors = 0;
+
+	for (i=0, t = x86_test_groups; i < NUM_TEST_GROUPS; i++, t++) {
+		memset(arg, 0, sizeof(arg));
+		for (n = 0; n < MAX_GROUP_EVENTS && t->names[n]; n++) {
+			arg[n].str = t->names[n];
+			arg[n].size = sizeof(arg[n]);
+		}
+		ngroups = -1;
+		ret = pfm_get_event_groups(arg, n, PFM_PLM0 | PFM_PLM3, PFM_OS_NONE, &ngroups);
+		if (ret != t->ret) {
+			if (ret == PFM_ERR_NOTFOUND && !check_pmu_supported(t->names[0])) {
+				fprintf(fp,"Line %d, Group%d, skipped because no PMU support\n", t->line, i);
+				continue;
+			}
+			fprintf(fp,"Line %d, Group%d, ret=%s(%d) expected %s(%d)\n", t->line, i, pfm_strerror(ret), ret, pfm_strerror(t->ret), t->ret);
+			errors++;
+			continue;
+		}
+		if (ret != PFM_SUCCESS)
+			continue;
+
+		if (ngroups != t->ngroups) {
+			fprintf(fp,"Line %d, Group%d, ngroups=%d expected %d\n", t->line, i, ngroups, t->ngroups);
+			errors++;
+		}
+		for (j = 0; j < n; j++) {
+			if (arg[j].group != t->groups[j]) {
+				fprintf(fp,"Line %d, Group%d %s, group=%d expected %d\n", t->line, i, t->names[j], arg[j].group, t->groups[j]);
+				errors++;
+			}
+			if (!arg[j].cntmsk) {
+				if (arg[j].counter != -1) {
+					fprintf(fp,"Line %d, Group%d %s, counter=%d expected -1\n", t->line, i, t->names[j], arg[j].counter);
+					errors++;
+				}
+			} else if (arg[j].counter < 0 || !(arg[j].cntmsk & (1ULL << arg[j].counter))) {
+				fprintf(fp,"Line %d, Group%d %s, counter=%d not in cntmsk=%#"PRIx64"\n", t->line, i, t->names[j], arg[j].counter, arg[j].cntmsk);
+				errors++;
+			}
+			if (!strncmp(t->names[j], "perf::PERF_COUNT_HW", 19) && arg[j].cntmsk != core_msk) {
+				fprintf(fp,"Line %d, Group%d %s, cntmsk=%#"PRIx64" expected %#"PRIx64"\n", t->line, i, t->names[j], arg[j].cntmsk, core_msk);
+				errors++;
+			}
+			for (k = 0; k < j; k++) {
+				if (arg[k].group == arg[j].group && arg[k].counter != -1 && arg[k].counter == arg[j].counter) {
+					fprintf(fp,"Line %d, Group%d %s, counter=%d already used by %s\n", t->line, i, t->names[j], arg[j].counter, t->names[k]);
+					errors++;
+				}
+			}
+		}
+	}
+	printf("\t %d x86 event groups: %d errors\n", i, errors);
+	return errors;
+}
+
 int
 validate_arch(FILE *fp)
 {
-	return check_test_events(fp);
+	return check_test_events(fp) + check_test_groups(fp);
 }
@@ -0,0 +1,362 @@
+/******************************************************************************
+* FILE: placement.c
+* DESCRIPTION:
+*   Rank and thread placement report, built on the getcpu() call of 1.c.
+*   Every OpenMP thread of every task samples, a number of times, the cpu
+*   and NUMA node it is running on and its affinity mask.  The report lists
+*   the placement of each thread and flags:
+*     - migrations: a thread seen on a different cpu than in its previous
+*       sample;
+*     - oversubscription: more than one thread (of this task or, with MPI,
+*       of any task on the same host) seen on the same cpu in the same
+*       sample, or bound to the same single cpu.
+*
+*   With -p compact|scatter the threads are pinned before sampling:
+*     compact - consecutive threads and tasks fill the cores of a NUMA node
+*               before moving to the next one;
+*     scatter - consecutive threads and tasks go round robin over the NUMA
+*               nodes, one hardware thread per core before the SMT siblings.
+*   With "-- command args" no sampling is done: the cpus that the policy
+*   gives to this task are set as its affinity and as OMP_PLACES (with
+*   OMP_PROC_BIND=close), and command is executed in its place, so the real
+*   workload starts already pinned.  In this mode MPI is not initialized;
+*   the task number on the host is taken from the launcher environment.
+*
+* USAGE:  placement [-s samples] [-i interval_ms] [-p compact|scatter]
+*                   [-- command args]
+* BUILD:  gcc -O2 -fopenmp -o placement placement.c
+*         mpicc -O2 -fopenmp -DUSE_MPI -o placement placement.c
+******************************************************************************/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <dirent.h>
+#include <time.h>
+#include <sys/syscall.h>
+#include <omp.h>
+#ifdef USE_MPI
+#include "mpi.h"
+#endif
+
+#define MAXCPU  1024
+#define NONE    0
+#define COMPACT 1
+#define SCATTER 2
+
+typedef struct {
+  int cpu, node, core, pkg;
+} cpu_info;
+
+typedef struct {                /* one sample of one thread */
+  int task, thread, sample;
+  int cpu, node;
+  int nmask, maskcpu;           /* cpus in affinity mask, first of them */
+} sample_t;
+
+static inline int getcpu_node(int *node) {
+    #ifdef SYS_getcpu
+    unsigned int cpu, nd;
+    int status;
+    status = syscall(SYS_getcpu, &cpu, &nd, NULL);
+    if (status == -1) return -1;
+    *node = nd;
+    return cpu;
+    #else
+    *node = -1;
+    return -1; // unavailable
+    #endif
+}
+
+static int read_int(const char *path, int dfl)
+{
+  FILE *fp = fopen(path, "r");
+  int v;
+  if (fp == NULL) return dfl;
+  if (fscanf(fp, "%d", &v) != 1) v = dfl;
+  fclose(fp);
+  return v;
+}
+
+/* NUMA node, core and package of a cpu, from sysfs */
+static void cpu_topology(int cpu, cpu_info *ci)
+{
+  char path[256];
+  DIR *d;
+  struct dirent *de;
+
+  ci->cpu = cpu;
+  snprintf(path, sizeof(path),
+           "/sys/devices/system/cpu/cpu%d/topology/core_id", cpu);
+  ci->core = read_int(path, cpu);
+  snprintf(path, sizeof(path),
+           "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu);
+  ci->pkg = read_int(path, 0);
+  ci->node = 0;
+  snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+  if ((d = opendir(path)) != NULL) {
+    while ((de = readdir(d)) != NULL)
+      if (strncmp(de->d_name, "node", 4) == 0) {
+        ci->node = atoi(de->d_name + 4);
+        break;
+      }
+    closedir(d);
+  }
+}
+
+static int cmp_compact(const void *a, const void *b)
+{
+  const cpu_info *x = a, *y = b;
+  if (x->node != y->node) return x->node - y->node;
+  if (x->pkg != y->pkg) return x->pkg - y->pkg;
+  if (x->core != y->core) return x->core - y->core;
+  return x->cpu - y->cpu;
+}
+
+/*
+ * Order the cpus allowed to this process according to the policy.
+ * Thread t of local task r gets list[(r*nthreads + t) % n].
+ */
+static int placement_list(int policy, int *list)
+{
+  cpu_set_t set;
+  cpu_info ci[MAXCPU], tmp[MAXCPU];
+  int n = 0, i, j, k, rank, done;
+  int seen_core[MAXCPU];
+
+  sched_getaffinity(0, sizeof(set), &set);
+  for (i = 0; i < MAXCPU && i < CPU_SETSIZE; i++)
+    if (CPU_ISSET(i, &set))
+      cpu_topology(i, &ci[n++]);
+  qsort(ci, n, sizeof(cpu_info), cmp_compact);
+
+  if (policy == SCATTER) {
+    /* rank of each cpu among the hardware threads of its core */
+    for (i = 0; i < n; i++) {
+      seen_core[i] = 0;
+      for (j = 0; j < i; j++)
+        if (ci[j].node == ci[i].node && ci[j].pkg == ci[i].pkg &&
+            ci[j].core == ci[i].core)
+          seen_core[i]++;
+    }
+    /* first hardware thread of every core, round robin over the nodes,
+     * then the second ones, and so on */
+    k = 0;
+    for (rank = 0; k < n; rank++) {
+      done = 0;
+      while (!done) {
+        int last_node = -1;
+        done = 1;
+        for (i = 0; i < n; i++) {
+          if (seen_core[i] != rank || ci[i].node == last_node) continue;
+          if (ci[i].cpu < 0) continue;
+          tmp[k++] = ci[i];
+          ci[i].cpu = -1;
+          last_node = ci[i].node;
+          done = 0;
+        }
+      }
+    }
+    memcpy(ci, tmp, n * sizeof(cpu_info));
+  }
+
+  for (i = 0; i < n; i++)
+    list[i] = ci[i].cpu;
+  return n;
+}
+
+static int env_int(const char **names, int dfl)
+{
+  const char *v;
+  for (; *names; names++)
+    if ((v = getenv(*names)) != NULL)
+      return atoi(v);
+  return dfl;
+}
+
+static const char *local_rank_env[] = { "OMPI_COMM_WORLD_LOCAL_RANK",
+  "MPI_LOCALRANKID", "MV2_COMM_WORLD_LOCAL_RANK", "SLURM_LOCALID", NULL };
+
+static void usage(void)
+{
+  fprintf(stderr, "usage: placement [-s samples] [-i interval_ms]"
+                  " [-p compact|scatter] [-- command args]\n");
+  exit(1);
+}
+
+/* pin this task to its cpus and replace it by the workload */
+static void run_pinned(int policy, char **cmd)
+{
+  int list[MAXCPU], n, nt, lrank, t, pos;
+  cpu_set_t set;
+  char places[8 * MAXCPU];
+
+  n = placement_list(policy, list);
+  nt = omp_get_max_threads();
+  lrank = env_int(local_rank_env, 0);
+
+  CPU_ZERO(&set);
+  pos = 0;
+  for (t = 0; t < nt; t++) {
+    int cpu = list[(lrank * nt + t) % n];
+    CPU_SET(cpu, &set);
+    pos += snprintf(places + pos, sizeof(places) - pos, "%s{%d}",
+                    t ? "," : "", cpu);
+  }
+  if (sched_setaffinity(0, sizeof(set), &set) != 0)
+    perror("sched_setaffinity");
+  setenv("OMP_PLACES", places, 1);
+  setenv("OMP_PROC_BIND", "close", 1);
+  fprintf(stderr, "local task %d: OMP_PLACES=%s\n", lrank, places);
+  execvp(cmd[0], cmd);
+  perror(cmd[0]);
+  exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+  int nsamples = 10, interval = 100, policy = NONE;
+  int task = 0, lrank = 0, nt, i, j, s, n;
+  int list[MAXCPU], nlist = 0;
+  int migrations = 0, shared = 0, bound_shared = 0;
+  sample_t *smp, *all;
+  int nall;
+  char host[64];
+#ifdef USE_MPI
+  MPI_Comm node_comm;
+  int lsize, *counts = NULL, *displs = NULL;
+#endif
+
+  for (i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-s") && i+1 < argc) nsamples = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-i") && i+1 < argc) interval = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-p") && i+1 < argc) {
+      i++;
+      if (!strcmp(argv[i], "compact")) policy = COMPACT;
+      else if (!strcmp(argv[i], "scatter")) policy = SCATTER;
+      else usage();
+    }
+    else if (!strcmp(argv[i], "--") && i+1 < argc) {
+      if (policy == NONE) usage();
+      run_pinned(policy, argv + i + 1);
+    }
+    else usage();
+  }
+  if (nsamples < 1) nsamples = 1;
+
+  gethostname(host, sizeof(host));
+#ifdef USE_MPI
+  MPI_Init(&argc, &argv);
+  MPI_Comm_rank(MPI_COMM_WORLD, &task);
+  MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, 0,
+                      MPI_INFO_NULL, &node_comm);
+  MPI_Comm_rank(node_comm, &lrank);
+  MPI_Comm_size(node_comm, &lsize);
+#endif
+
+  if (policy != NONE)
+    nlist = placement_list(policy, list);
+
+  nt = omp_get_max_threads();
+  smp = malloc(nt * nsamples * sizeof(sample_t));
+
+  /*** every thread pins itself, if asked, and samples its placement ***/
+  #pragma omp parallel private(s)
+  {
+  int tid = omp_get_thread_num();
+  cpu_set_t set;
+  struct timespec ts = { interval / 1000, (interval % 1000) * 1000000L };
+  volatile double x = 0.0;
+  int k;
+
+  if (policy != NONE) {
+    CPU_ZERO(&set);
+    CPU_SET(list[(lrank * nt + tid) % nlist], &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0)
+      perror("sched_setaffinity");
+  }
+
+  for (s = 0; s < nsamples; s++) {
+    sample_t *p = &smp[tid * nsamples + s];
+    /* keep the cpu busy for a while, so that threads sharing it show up */
+    for (k = 0; k < 200000; k++) x += k * 0.5;
+    p->task = task;
+    p->thread = tid;
+    p->sample = s;
+    p->cpu = getcpu_node(&p->node);
+    sched_getaffinity(0, sizeof(set), &set);
+    p->nmask = CPU_COUNT(&set);
+    for (p->maskcpu = 0; p->maskcpu < CPU_SETSIZE; p->maskcpu++)
+      if (CPU_ISSET(p->maskcpu, &set)) break;
+    #pragma omp barrier
+    if (s + 1 < nsamples) nanosleep(&ts, NULL);
+  }
+  }
+
+  /*** gather the samples of all tasks on this host ***/
+  n = nt * nsamples;
+  all = smp;
+  nall = n;
+#ifdef USE_MPI
+  if (lrank == 0) {
+    counts = malloc(lsize * sizeof(int));
+    displs = malloc(lsize * sizeof(int));
+  }
+  n *= sizeof(sample_t);
+  MPI_Gather(&n, 1, MPI_INT, counts, 1, MPI_INT, 0, node_comm);
+  if (lrank == 0) {
+    for (i = 0, nall = 0; i < lsize; i++) {
+      displs[i] = nall;
+      nall += counts[i];
+    }
+    all = malloc(nall);
+    nall /= sizeof(sample_t);
+  }
+  MPI_Gatherv(smp, n, MPI_BYTE, all, counts, displs, MPI_BYTE, 0, node_comm);
+#endif
+
+  if (lrank == 0) {
+    printf("host %s: %d task(s) x %d thread(s), %d samples every %d ms,"
+           " policy %s\n", host, nall / (nt * nsamples), nt, nsamples,
+           interval, policy == COMPACT ? "compact" :
+                     policy == SCATTER ? "scatter" : "none");
+    printf("%6s %6s %6s %6s %6s  %s\n",
+           "task", "thread", "cpu", "node", "mask", "cpus seen");
+    for (i = 0; i < nall; i += nsamples) {
+      printf("%6d %6d %6d %6d %6d  ", all[i].task, all[i].thread,
+             all[i].cpu, all[i].node, all[i].nmask);
+      for (s = 0; s < nsamples; s++) {
+        printf("%s%d", s ? "," : "", all[i+s].cpu);
+        if (s > 0 && all[i+s].cpu != all[i+s-1].cpu)
+          migrations++;
+      }
+      printf("\n");
+    }
+    /* same cpu, same sample, different threads */
+    for (i = 0; i < nall; i++)
+      for (j = i + 1; j < nall; j++)
+        if (all[i].sample == all[j].sample && all[i].cpu == all[j].cpu)
+          shared++;
+    /* bound to the same single cpu */
+    for (i = 0; i < nall; i += nsamples)
+      for (j = i + nsamples; j < nall; j += nsamples)
+        if (all[i].nmask == 1 && all[j].nmask == 1 &&
+            all[i].maskcpu == all[j].maskcpu)
+          bound_shared++;
+    printf("migrations: %d\n", migrations);
+    printf("oversubscription: %d times two threads seen on the same cpu,"
+           " %d thread pairs bound to the same cpu\n", shared, bound_shared);
+  }
+
+#ifdef USE_MPI
+  if (lrank == 0) {
+    free(all); free(counts); free(displs);
+  }
+  MPI_Comm_free(&node_comm);
+  MPI_Finalize();
+#endif
+  free(smp);
+  return 0;
+}
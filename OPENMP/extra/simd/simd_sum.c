@@ -0,0 +1,192 @@
+/******************************************************************************
+* FILE: simd_sum.c
+* DESCRIPTION:
+*   Sum kernels of simd_sum.h.  Each kernel keeps SIMD_LANES partial sums
+*   and updates them in an "omp simd" loop over the lanes; the partial
+*   sums are combined in a fixed order at the end.  The elements that do
+*   not fill a group of SIMD_LANES go to the lanes one by one.
+* BUILD:  gcc -O2 -fopenmp -c simd_sum.c
+*         (do not use -ffast-math: it would break the Kahan and
+*          double-double kernels)
+******************************************************************************/
+#include "simd_sum.h"
+
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(__clang__) && \
+    !defined(NO_CLONES)
+#define CLONES __attribute__((target_clones("default", "avx2", "avx512f")))
+#else
+#define CLONES
+#endif
+
+#define L SIMD_LANES
+
+/* the loop of teste02.c: one float accumulator, no vectorization */
+long double sum_f_loop(const float *x, long n)
+{
+  float s = 0;
+  long i;
+  for (i = 0; i < n; i++)
+    s += x[i];
+  return s;
+}
+
+CLONES long double sum_f(const float *x, long n)
+{
+  float s[L] = { 0 }, t = 0;
+  long i, j;
+  for (i = 0; i + L <= n; i += L) {
+    #pragma omp simd
+    for (j = 0; j < L; j++)
+      s[j] += x[i + j];
+  }
+  for (; i < n; i++)
+    s[i % L] += x[i];
+  for (j = 0; j < L; j++)
+    t += s[j];
+  return t;
+}
+
+CLONES long double sum_f_double(const float *x, long n)
+{
+  double s[L] = { 0 }, t = 0;
+  long i, j;
+  for (i = 0; i + L <= n; i += L) {
+    #pragma omp simd
+    for (j = 0; j < L; j++)
+      s[j] += x[i + j];
+  }
+  for (; i < n; i++)
+    s[i % L] += x[i];
+  for (j = 0; j < L; j++)
+    t += s[j];
+  return t;
+}
+
+CLONES long double sum_d(const double *x, long n)
+{
+  double s[L] = { 0 }, t = 0;
+  long i, j;
+  for (i = 0; i + L <= n; i += L) {
+    #pragma omp simd
+    for (j = 0; j < L; j++)
+      s[j] += x[i + j];
+  }
+  for (; i < n; i++)
+    s[i % L] += x[i];
+  for (j = 0; j < L; j++)
+    t += s[j];
+  return t;
+}
+
+/* Kahan: c holds the part of the last additions lost in s */
+CLONES long double sum_d_kahan(const double *x, long n)
+{
+  double s[L] = { 0 }, c[L] = { 0 }, t = 0, ct = 0, y, u;
+  long i, j;
+  for (i = 0; i + L <= n; i += L) {
+    #pragma omp simd private(y, u)
+    for (j = 0; j < L; j++) {
+      y = x[i + j] - c[j];
+      u = s[j] + y;
+      c[j] = (u - s[j]) - y;
+      s[j] = u;
+    }
+  }
+  for (; i < n; i++) {
+    j = i % L;
+    y = x[i] - c[j];
+    u = s[j] + y;
+    c[j] = (u - s[j]) - y;
+    s[j] = u;
+  }
+  for (j = 0; j < L; j++) {
+    y = s[j] - (c[j] + ct);
+    u = t + y;
+    ct = (u - t) - y;
+    t = u;
+  }
+  return t;
+}
+
+/* double-double: s + e is the exact sum of the lane up to the rounding
+ * of e; TwoSum gives the rounding error of every addition to s */
+static inline void two_sum(double a, double b, double *s, double *e)
+{
+  double t = a + b, z = t - a;
+  *s = t;
+  *e = (a - (t - z)) + (b - z);
+}
+
+CLONES long double sum_d_dd(const double *x, long n)
+{
+  double s[L] = { 0 }, e[L] = { 0 }, hi = 0, lo = 0, t, z, err;
+  long i, j;
+  for (i = 0; i + L <= n; i += L) {
+    #pragma omp simd private(t, z)
+    for (j = 0; j < L; j++) {
+      t = s[j] + x[i + j];
+      z = t - s[j];
+      e[j] += (s[j] - (t - z)) + (x[i + j] - z);
+      s[j] = t;
+    }
+  }
+  for (; i < n; i++) {
+    j = i % L;
+    two_sum(s[j], x[i], &t, &err);
+    s[j] = t;
+    e[j] += err;
+  }
+  for (j = 0; j < L; j++) {
+    two_sum(hi, s[j], &hi, &err);
+    lo += err + e[j];
+  }
+  two_sum(hi, lo, &hi, &lo);
+  return (long double)hi + lo;
+}
+
+long double sum_ld(const long double *x, long n)
+{
+  long double s = 0;
+  long i;
+  for (i = 0; i < n; i++)
+    s += x[i];
+  return s;
+}
+
+const char *simd_sum_isa(void)
+{
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(__clang__) && \
+    !defined(NO_CLONES)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) return "avx512f";
+  if (__builtin_cpu_supports("avx2")) return "avx2";
+  return "sse2";
+#else
+  return "default";
+#endif
+}
+
+/* the table calls the kernels through wrappers with a common type */
+#define WRAP(f, type) \
+  static long double w_##f(const void *x, long n) { return f((const type *)x, n); }
+WRAP(sum_f_loop, float)
+WRAP(sum_f, float)
+WRAP(sum_f_double, float)
+WRAP(sum_d, double)
+WRAP(sum_d_kahan, double)
+WRAP(sum_d_dd, double)
+WRAP(sum_ld, long double)
+
+#define KERNEL(f, e) { #f, e, w_##f }
+
+const simd_sum_kernel_t simd_sum_kernels[] = {
+  KERNEL(sum_f_loop, 'f'),
+  KERNEL(sum_f, 'f'),
+  KERNEL(sum_f_double, 'f'),
+  KERNEL(sum_d, 'd'),
+  KERNEL(sum_d_kahan, 'd'),
+  KERNEL(sum_d_dd, 'd'),
+  KERNEL(sum_ld, 'l'),
+};
+const int simd_sum_nkernels =
+  sizeof(simd_sum_kernels) / sizeof(simd_sum_kernels[0]);
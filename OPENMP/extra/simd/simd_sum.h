@@ -0,0 +1,46 @@
+/******************************************************************************
+* FILE: simd_sum.h
+* DESCRIPTION:
+*   Vectorized sum kernels for the simd examples (implementation in
+*   simd_sum.c).  teste01.c and teste03.c add long double values, which
+*   the x87 unit adds one at a time; teste02.c adds floats in a loop that
+*   the compiler may not reorder.  The kernels below keep SIMD_LANES
+*   independent partial sums, so they vectorize without -ffast-math:
+*     sum_f_loop    - the loop of teste02.c, one float accumulator;
+*     sum_f         - float data, float lanes;
+*     sum_f_double  - float data, double lanes;
+*     sum_d         - double data, double lanes;
+*     sum_d_kahan   - double lanes with Kahan compensation;
+*     sum_d_dd      - double-double lanes (error-free TwoSum), close to
+*                     the precision of long double;
+*     sum_ld        - long double, the reference of teste01.c.
+*   On x86-64 with gcc the kernels are compiled for SSE2, AVX2 and
+*   AVX-512 (function multiversioning) and the best version for the cpu
+*   is selected when the program is loaded; simd_sum_isa() names it.
+*   The double results are returned as long double so that the
+*   double-double sum keeps its low part.
+******************************************************************************/
+#ifndef SIMD_SUM_H
+#define SIMD_SUM_H
+
+#define SIMD_LANES  16
+
+typedef struct {
+  const char *name;
+  int         elem;                 /* 'f' float, 'd' double, 'l' long double */
+  long double (*fn)(const void *x, long n);
+} simd_sum_kernel_t;
+
+extern long double sum_f_loop(const float *x, long n);
+extern long double sum_f(const float *x, long n);
+extern long double sum_f_double(const float *x, long n);
+extern long double sum_d(const double *x, long n);
+extern long double sum_d_kahan(const double *x, long n);
+extern long double sum_d_dd(const double *x, long n);
+extern long double sum_ld(const long double *x, long n);
+
+extern const simd_sum_kernel_t simd_sum_kernels[];
+extern const int               simd_sum_nkernels;
+extern const char             *simd_sum_isa(void);
+
+#endif /* SIMD_SUM_H */
@@ -0,0 +1,101 @@
+/******************************************************************************
+* FILE: simd_sum_bench.c
+* OTHER FILES: simd_sum.c simd_sum.h
+* DESCRIPTION:
+*   Times the kernels of simd_sum.c on the data of teste01.c (x[i] = i*i)
+*   stored as float, double and long double, and prints the elements
+*   added per cycle and the relative error of each kernel.  All the
+*   values are integers, so the exact sum of the stored data is computed
+*   in 128-bit integers.
+*   Cycles are read with rdtsc, which counts at the nominal frequency of
+*   the cpu; with turbo the real cycles are more.
+* USAGE:  simd_sum_bench [elements] [repetitions]   (elements >= 2)
+* BUILD:  gcc -O2 -fopenmp -o simd_sum_bench simd_sum_bench.c simd_sum.c
+******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <omp.h>
+#include "simd_sum.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TICKS() ((double)__rdtsc())
+#define UNIT    "cycle"
+#else
+#define TICKS() (omp_get_wtime() * 1e9)
+#define UNIT    "ns"
+#endif
+
+#define SIZE 10000000
+
+int main(int argc, char *argv[])
+{
+	long n = SIZE, i;
+	int reps = 10, r, k;
+	float *xf;
+	double *xd, t, best, tick_rate;
+	long double *xl, s = 0, exact;
+	__int128 ef = 0, ed = 0, el = 0;
+	const void *data;
+
+	if (argc >= 2) n = atol(argv[1]);
+	if (argc >= 3) reps = atoi(argv[2]);
+	/* x[0] = 0, the relative error needs a nonzero sum */
+	if (n < 2 || reps < 1) {
+		fprintf(stderr, "usage: %s [elements >= 2] [repetitions >= 1]\n",
+		        argv[0]);
+		return 1;
+	}
+
+	xf = malloc(sizeof(float) * n);
+	xd = malloc(sizeof(double) * n);
+	xl = malloc(sizeof(long double) * n);
+	if (xf == NULL || xd == NULL || xl == NULL) {
+		fprintf(stderr, "%s: cannot allocate %ld elements\n", argv[0], n);
+		return 1;
+	}
+	for (i = 0; i < n; i++) {
+		xl[i] = (long double)i * i;
+		xd[i] = xl[i];
+		xf[i] = xl[i];
+		ef += (__int128)xf[i];
+		ed += (__int128)xd[i];
+		el += (__int128)xl[i];
+	}
+
+	/* rate of the tick counter */
+	t = omp_get_wtime();
+	best = TICKS();
+	while (omp_get_wtime() - t < 0.1)
+		;
+	tick_rate = (TICKS() - best) / (omp_get_wtime() - t);
+
+	printf("%ld elements, best of %d runs, kernels compiled for %s\n",
+	       n, reps, simd_sum_isa());
+	printf("tick rate %.2f GHz\n\n", tick_rate * 1e-9);
+	printf("%-14s %-12s %10s %12s\n", "kernel", "data",
+	       "elem/" UNIT, "rel. error");
+	for (k = 0; k < simd_sum_nkernels; k++) {
+		const simd_sum_kernel_t *K = &simd_sum_kernels[k];
+		switch (K->elem) {
+		case 'f': data = xf; exact = ef; break;
+		case 'd': data = xd; exact = ed; break;
+		default:  data = xl; exact = el; break;
+		}
+		best = 1e300;
+		for (r = 0; r < reps; r++) {
+			t = TICKS();
+			s = K->fn(data, n);
+			t = TICKS() - t;
+			if (t < best) best = t;
+		}
+		printf("%-14s %-12s %10.3f %12.3Le\n", K->name,
+		       K->elem == 'f' ? "float" :
+		       K->elem == 'd' ? "double" : "long double",
+		       n / best, fabsl(s - exact) / exact);
+	}
+
+	free(xf); free(xd); free(xl);
+	return 0;
+}
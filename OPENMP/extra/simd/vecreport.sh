@@ -0,0 +1,117 @@
+#!/bin/sh
+# -----------------------------------------------------------------------
+# vecreport.sh
+#   Lists the loops of the simd examples that run many times but were
+#   not vectorized, with the reason given by the compiler.
+#
+#   Every example is built twice:
+#     - with $CFLAGS and the vectorizer remarks (-fopt-info-vec-all for
+#       gcc, -Rpass*=loop-vectorize for clang), to learn which loops
+#       were vectorized;
+#     - with -O0 --coverage and without -fopenmp, and run once, to count
+#       how many times each line runs (gcov).  Coverage is not added to
+#       the first build because its counters keep the loops from
+#       vectorizing, and the OpenMP pragmas are left out because gcov
+#       does not report the counts of the outlined parallel regions; the
+#       counts are the total over all the threads anyway.
+#   A loop is identified by the source line of the remark; its count is
+#   the gcov count of that line (or of the next one, for the line of an
+#   "omp" pragma).  The examples must be whole programs (with a main).
+#
+#   Usage: ./vecreport.sh [-a] [-n min_count] [example.c ...]
+#     -a        - list the vectorized loops too
+#     -n count  - only loops that ran at least count times (default 1)
+#     examples  - default: teste*.c
+#
+#   CC (default gcc), CFLAGS (default "-O2 -fopenmp") and LIBS may be set,
+#   e.g.  CFLAGS="-O3 -march=native -fopenmp" ./vecreport.sh teste02.c
+#   With CC=clang, GCOV should be "llvm-cov gcov".
+# -----------------------------------------------------------------------
+cd `dirname $0`
+
+CC=${CC:-gcc}
+CFLAGS=${CFLAGS:-"-O2 -fopenmp"}
+GCOV=${GCOV:-gcov}
+ALL=0
+MIN=1
+
+while [ $# -gt 0 ]; do
+  case "$1" in
+    -a) ALL=1; shift ;;
+    -n) MIN=$2; shift 2 ;;
+    *)  break ;;
+  esac
+done
+if [ $# -eq 0 ]; then set -- teste*.c; fi
+
+case `$CC --version 2>/dev/null | head -1` in
+  *clang*) REMARKS="-Rpass=loop-vectorize -Rpass-missed=loop-vectorize \
+                    -Rpass-analysis=loop-vectorize" ;;
+  *)       REMARKS="-fopt-info-vec-all" ;;
+esac
+
+TMP=`mktemp -d /tmp/vecreport.XXXXXX` || exit 1
+trap 'rm -rf $TMP' 0
+
+printf "%-12s %5s %12s %7s  %s\n" "file" "line" "count" "status" "reason"
+for SRC in "$@"; do
+  NAME=`basename $SRC .c`
+  case "$SRC" in
+    /*) ABS=$SRC ;;
+    *)  ABS=`pwd`/$SRC ;;
+  esac
+
+  $CC $CFLAGS $REMARKS -c $SRC -o $TMP/$NAME.o 2> $TMP/$NAME.remarks ||
+    { echo "$SRC: build failed" >&2; continue; }
+
+  (cd $TMP &&
+   $CC -O0 --coverage -c $ABS -o $NAME.cov.o &&
+   $CC -fopenmp --coverage -o $NAME.cov $NAME.cov.o $LIBS &&
+   ./$NAME.cov > /dev/null &&
+   $GCOV -t -o $NAME.cov.o $ABS > $NAME.gcov 2> /dev/null) ||
+    { echo "$SRC: coverage run failed" >&2; continue; }
+
+  # first file: gcov counts by line; second file: remarks of this source
+  awk -v file=`basename $SRC` -v all=$ALL -v min=$MIN '
+    FNR == NR {
+      split($0, f, ":")
+      c = f[1]; gsub(/[ *]/, "", c); l = f[2] + 0
+      if (c == "#####" || c == "=====") c = 0
+      if (c != "-") count[l] = c
+      next
+    }
+    # gcc: "file:line:col: optimized: loop vectorized ..."
+    #      "file:line:col: missed: couldn'"'"'t vectorize loop"
+    #      "file:line:col: missed: not vectorized: reason"
+    # clang: "file:line:col: remark: vectorized loop ..."
+    #        "file:line:col: remark: loop not vectorized: reason [-Rpass..]"
+    /^ / {                            # gcc: " scalar_type: long double"
+      if (last) { r = $0; sub(/^ +/, "", r); reason[last] = reason[last] " (" r ")" }
+      last = 0; next
+    }
+    {
+      split($0, f, ":"); last = 0
+      if (f[1] !~ file "$") { pending = 0; next }
+      l = f[2] + 0
+      if ($0 ~ /optimized: loop vectorized|remark: vectorized loop/) {
+        vec[l] = 1; seen[l] = 1; pending = 0
+      } else if ($0 ~ /couldn.t vectorize loop/) {
+        seen[l] = 1; pending = l
+      } else if ($0 ~ /not vectorized: /) {
+        r = $0; sub(/.*not vectorized: /, "", r); sub(/ *\[-Rpass.*/, "", r)
+        loop = pending ? pending : l
+        if ($0 ~ /remark: loop not vectorized/) seen[loop] = 1
+        if (!(loop in reason) && r != "") { reason[loop] = r; last = loop }
+        pending = 0
+      }
+    }
+    END {
+      for (l in seen) {
+        c = (l in count) ? count[l] : count[l + 1]
+        if (c + 0 < min || (vec[l] && !all)) continue
+        printf "%-12s %5d %12d %7s  %s\n", file, l, c,
+               vec[l] ? "vector" : "scalar",
+               vec[l] ? "" : (l in reason ? reason[l] : "?")
+      }
+    }' $TMP/$NAME.gcov $TMP/$NAME.remarks | sort -k3,3nr
+done
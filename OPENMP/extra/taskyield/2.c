@@ -0,0 +1,189 @@
+/******************************************************************************
+* FILE: 2.c
+* DESCRIPTION:
+*   Task-based version of 1.c.  In 1.c every iteration holds one lock while
+*   it sleeps, so all the threads wait for the sleeper.  Here every item
+*   first does some work of its own (free phase) and then needs the lock
+*   of its key for the sleep of 1.c (locked phase).  The items are run as:
+*     blocking - "parallel for" and omp_set_lock(), as in 1.c;
+*     yield    - one task per item; while the lock is taken the task calls
+*                omp_test_lock() and "#pragma omp taskyield", so that the
+*                thread may run other ready tasks;
+*     requeue  - one task per item; if the lock is taken the task creates
+*                a new task for the rest of the item and ends, so that the
+*                thread always goes back to the pool.
+*   Each mode runs with one lock for all items (as 1.c) and with a table
+*   of lock shards, one per key (item i has key i % keys), so that items
+*   with different keys do not wait for each other.
+*   The report gives the wall time, the time the items spent working
+*   (free and locked phases, not waiting), the achieved concurrency
+*   (work time / wall time) and the most items seen in their locked phase
+*   at the same time.
+*   Note: libgomp (gcc) implements taskyield as a no-op, so with gcc the
+*   yield mode only spins; requeue gives the cooperative behaviour with
+*   any runtime.
+* USAGE:  2 [-n items] [-k keys] [-u unit_us] [-f free_units]
+*         item i holds its lock for (i % 5) units, as the sleep of 1.c
+* BUILD:  gcc -O2 -fopenmp -o 2 2.c
+******************************************************************************/
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+
+#define CACHELINE 64
+
+typedef struct {
+	omp_lock_t lock;
+	char pad[CACHELINE - sizeof(omp_lock_t) % CACHELINE];
+} shard_t;
+
+static shard_t *shards;
+static int nshards;
+static long items = 200, unit = 1000, free_units = 2;
+static double busy;              /* work time of all items, seconds */
+static int active, max_active;   /* items in the locked phase */
+static long p;                   /* the sum of 1.c */
+
+static void free_phase(long i)
+{
+	double t = omp_get_wtime();
+	(void)i;
+	usleep(free_units * unit);
+	t = omp_get_wtime() - t;
+	#pragma omp atomic
+	busy += t;
+}
+
+/* called with the lock of the item held */
+static void locked_phase(long i)
+{
+	double t = omp_get_wtime();
+	int a;
+	#pragma omp atomic capture
+	a = ++active;
+	#pragma omp critical (max_active)
+	if (a > max_active) max_active = a;
+	#pragma omp atomic
+	p += i;
+	usleep((i % 5) * unit);
+	#pragma omp atomic
+	active--;
+	t = omp_get_wtime() - t;
+	#pragma omp atomic
+	busy += t;
+}
+
+static omp_lock_t *lock_of(long i)
+{
+	return &shards[i % nshards].lock;
+}
+
+static void run_blocking(void)
+{
+	long i;
+	#pragma omp parallel for schedule(dynamic)
+	for (i = 0; i < items; i++) {
+		free_phase(i);
+		omp_set_lock(lock_of(i));
+		locked_phase(i);
+		omp_unset_lock(lock_of(i));
+	}
+}
+
+static void run_yield(void)
+{
+	long i;
+	#pragma omp parallel
+	#pragma omp single
+	for (i = 0; i < items; i++) {
+		#pragma omp task firstprivate(i)
+		{
+		free_phase(i);
+		while (!omp_test_lock(lock_of(i))) {
+			#pragma omp taskyield
+		}
+		locked_phase(i);
+		omp_unset_lock(lock_of(i));
+		}
+	}
+}
+
+/* the rest of item i, after its free phase */
+static void requeue_item(long i)
+{
+	if (!omp_test_lock(lock_of(i))) {
+		#pragma omp task firstprivate(i)
+		requeue_item(i);
+		return;
+	}
+	locked_phase(i);
+	omp_unset_lock(lock_of(i));
+}
+
+static void run_requeue(void)
+{
+	long i;
+	#pragma omp parallel
+	#pragma omp single
+	for (i = 0; i < items; i++) {
+		#pragma omp task firstprivate(i)
+		{
+		free_phase(i);
+		requeue_item(i);
+		}
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	int c, k, m, s, keys = 16;
+	double t;
+	struct { const char *name; void (*fn)(void); } mode[] = {
+		{ "blocking", run_blocking }, { "yield", run_yield },
+		{ "requeue", run_requeue } };
+
+	while ((c = getopt(argc, argv, "n:k:u:f:")) != -1)
+		switch (c) {
+		case 'n': items = atol(optarg); break;
+		case 'k': keys = atoi(optarg); break;
+		case 'u': unit = atol(optarg); break;
+		case 'f': free_units = atol(optarg); break;
+		default:
+			fprintf(stderr, "usage: %s [-n items] [-k keys] [-u unit_us]"
+			        " [-f free_units]\n", argv[0]);
+			return 1;
+		}
+	if (keys < 1) keys = 1;
+
+	shards = aligned_alloc(CACHELINE, keys * sizeof(shard_t));
+	if (shards == NULL) {
+		fprintf(stderr, "%s: cannot allocate %d locks\n", argv[0], keys);
+		return 1;
+	}
+	for (k = 0; k < keys; k++)
+		omp_init_lock(&shards[k].lock);
+
+	printf("%ld items, %d threads, unit %ld us, free phase %ld units\n",
+	       items, omp_get_max_threads(), unit, free_units);
+	printf("%-9s %6s %9s %9s %11s %10s %10s\n", "mode", "locks", "wall s",
+	       "work s", "concurrency", "max locked", "sum");
+	for (s = 0; s < 2; s++) {
+		nshards = s ? keys : 1;
+		for (m = 0; m < 3; m++) {
+			busy = 0;
+			active = max_active = 0;
+			p = 0;
+			t = omp_get_wtime();
+			mode[m].fn();
+			t = omp_get_wtime() - t;
+			printf("%-9s %6d %9.3f %9.3f %11.2f %10d %10ld\n", mode[m].name,
+			       nshards, t, busy, busy / t, max_active, p);
+		}
+	}
+
+	for (k = 0; k < keys; k++)
+		omp_destroy_lock(&shards[k].lock);
+	free(shards);
+	return 0;
+}
@@ -0,0 +1,121 @@
+/******************************************************************************
+* OpenMP Example - Cost of deterministic reductions - C/C++ Version
+* FILE: omp_reduce_bench.c
+* OTHER FILES: reductions.c reductions.h
+* DESCRIPTION:
+*   solucao.c fixes the orphaned reduction of omp_erro.c; reductions.c
+*   packs the same idea in functions that the labs can call.  This program
+*   times the fast and the deterministic sum and mean/variance of a float
+*   and a double vector as the number of threads grows, and checks that
+*   the deterministic results are bitwise equal to the 1-thread result
+*   while the fast ones may change in the last bits.
+*   The "cost" columns are the deterministic time over the fast time.
+* USAGE:  omp_reduce_bench [elements] [repetitions]
+* BUILD:  gcc -O2 -fopenmp -o omp_reduce_bench omp_reduce_bench.c reductions.c
+******************************************************************************/
+
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "reductions.h"
+
+#define N    (1 << 24)
+
+static double *xd;
+static float  *xf;
+static long    n = N;
+static int     reps = 5;
+
+/* best time of reps calls; the result of the last call goes to *out */
+static double time_sum(int single, int mode, double *out)
+{
+  double t, best = 1e30;
+  int r;
+  for (r=0; r < reps; r++) {
+    t = omp_get_wtime();
+    *out = single ? reduce_sum_f(xf, n, mode) : reduce_sum_d(xd, n, mode);
+    t = omp_get_wtime() - t;
+    if (t < best) best = t;
+    }
+  return best;
+}
+
+static double time_stats(int single, int mode, reduce_stats_t *out)
+{
+  double t, best = 1e30;
+  int r;
+  for (r=0; r < reps; r++) {
+    t = omp_get_wtime();
+    *out = single ? reduce_stats_f(xf, n, mode) : reduce_stats_d(xd, n, mode);
+    t = omp_get_wtime() - t;
+    if (t < best) best = t;
+    }
+  return best;
+}
+
+static int same(double a, double b)
+{
+  return memcmp(&a, &b, sizeof(double)) == 0;
+}
+
+int main (int argc, char *argv[])
+{
+long i;
+int nt, maxt, single, bad = 0;
+double tf, td, sf, sd, ref_sum[2];
+reduce_stats_t stf, std, ref_stats[2];
+
+if (argc >= 2) n = atol(argv[1]);
+if (argc >= 3) reps = atoi(argv[2]);
+
+xd = malloc(n * sizeof(double));
+xf = malloc(n * sizeof(float));
+
+/* values of very different magnitudes, so that the order of the
+ * additions shows in the result; first touch in parallel */
+#pragma omp parallel for schedule(static)
+for (i=0; i < n; i++) {
+  xd[i] = (i % 7 == 0 ? 1.0e8 : 1.0) / (1 + i % 1000) + (i % 3) * 1.0e-3;
+  xf[i] = xd[i];
+  }
+
+printf("%ld elements, best of %d runs, times in ms\n", n, reps);
+printf("max %.6g at %ld, min %.6g\n", reduce_max_d(xd, n),
+       reduce_argmax_d(xd, n), reduce_min_d(xd, n));
+
+maxt = omp_get_max_threads();
+for (single = 0; single <= 1; single++) {
+  printf("\n%s data\n", single ? "float" : "double");
+  printf("%8s %10s %10s %6s %5s %10s %10s %6s %5s %8s\n", "threads",
+         "sum fast", "sum det", "cost", "same", "stat fast", "stat det",
+         "cost", "same", "fast sum");
+  for (nt = 1; nt <= maxt; nt = (nt * 2 <= maxt || nt == maxt) ? nt * 2 : maxt) {
+    omp_set_num_threads(nt);
+    tf = time_sum(single, REDUCE_FAST, &sf);
+    td = time_sum(single, REDUCE_DETERMINISTIC, &sd);
+    if (nt == 1) ref_sum[single] = sd;
+    printf("%8d %10.3f %10.3f %6.2f %5s", nt, tf * 1e3, td * 1e3, td / tf,
+           same(sd, ref_sum[single]) ? "yes" : "NO");
+    bad += !same(sd, ref_sum[single]);
+
+    tf = time_stats(single, REDUCE_FAST, &stf);
+    td = time_stats(single, REDUCE_DETERMINISTIC, &std);
+    if (nt == 1) ref_stats[single] = std;
+    printf(" %10.3f %10.3f %6.2f %5s", tf * 1e3, td * 1e3, td / tf,
+           same(std.mean, ref_stats[single].mean) &&
+           same(std.m2, ref_stats[single].m2) ? "yes" : "NO");
+    bad += !same(std.mean, ref_stats[single].mean) ||
+           !same(std.m2, ref_stats[single].m2);
+    /* the fast sum against the deterministic one */
+    printf(" %8s\n", same(sf, sd) ? "=" : "differs");
+    }
+  printf("sum = %.17g  mean = %.17g  variance = %.17g\n", ref_sum[single],
+         ref_stats[single].mean, reduce_variance(ref_stats[single]));
+  }
+
+if (bad)
+  printf("\n%d deterministic results differ from the 1-thread result\n", bad);
+free(xd); free(xf);
+return bad != 0;
+}
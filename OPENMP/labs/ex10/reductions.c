@@ -0,0 +1,197 @@
+/******************************************************************************
+* FILE: reductions.c
+* DESCRIPTION:
+*   Sum, minimum, maximum, argmax and mean/variance reductions over float
+*   and double vectors, see reductions.h.  The float and double versions
+*   are generated from the same macros.
+*   Deterministic mode: block k always covers elements
+*   [k*REDUCE_BLOCK, (k+1)*REDUCE_BLOCK), its result does not depend on the
+*   thread that computes it, and the block results are combined in a
+*   pairwise tree whose shape depends only on the number of blocks.
+*   Statistics of a block are computed in two passes (mean, then squared
+*   deviations) and merged with the pairwise form of Welford's update
+*   (Chan et al.).
+* BUILD:  gcc -O2 -fopenmp -c reductions.c
+*         (do not use -ffast-math: it allows the compiler to reorder sums)
+******************************************************************************/
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "reductions.h"
+
+static void *alloc_blocks(long nb, size_t size)
+{
+  void *p = malloc((nb ? nb : 1) * size);
+  if (p == NULL) {
+    fprintf(stderr, "reductions: out of memory\n");
+    exit(1);
+  }
+  return p;
+}
+
+/* merge the statistics of two disjoint sets */
+static reduce_stats_t merge_stats(reduce_stats_t a, reduce_stats_t b)
+{
+  reduce_stats_t r;
+  double delta;
+
+  if (a.n == 0) return b;
+  if (b.n == 0) return a;
+  r.n = a.n + b.n;
+  delta = b.mean - a.mean;
+  r.mean = a.mean + delta * ((double)b.n / r.n);
+  r.m2 = a.m2 + b.m2 + delta * delta * ((double)a.n * b.n / r.n);
+  return r;
+}
+
+double reduce_variance(reduce_stats_t s)
+{
+  return s.n > 1 ? s.m2 / (s.n - 1) : 0.0;
+}
+
+/* combine part[0..nb) pairwise into part[0], in a fixed order */
+static void tree_sum(double *part, long nb)
+{
+  long w, k;
+  for (w = 1; w < nb; w *= 2)
+    for (k = 0; k + w < nb; k += 2 * w)
+      part[k] += part[k + w];
+}
+
+static void tree_stats(reduce_stats_t *part, long nb)
+{
+  long w, k;
+  for (w = 1; w < nb; w *= 2)
+    for (k = 0; k + w < nb; k += 2 * w)
+      part[k] = merge_stats(part[k], part[k + w]);
+}
+
+#define DEFINE_REDUCTIONS(SUF, TYPE)                                        \
+                                                                            \
+static double block_sum_##SUF(const TYPE *x, long lo, long hi)              \
+{                                                                           \
+  double s = 0.0;                                                           \
+  long i;                                                                   \
+  _Pragma("omp simd reduction(+:s)")                                        \
+  for (i = lo; i < hi; i++)                                                 \
+    s += x[i];                                                              \
+  return s;                                                                 \
+}                                                                           \
+                                                                            \
+static reduce_stats_t block_stats_##SUF(const TYPE *x, long lo, long hi)    \
+{                                                                           \
+  reduce_stats_t r;                                                         \
+  double m2 = 0.0, d;                                                       \
+  long i;                                                                   \
+  r.n = hi - lo;                                                            \
+  r.mean = r.n > 0 ? block_sum_##SUF(x, lo, hi) / r.n : 0.0;                \
+  _Pragma("omp simd reduction(+:m2) private(d)")                            \
+  for (i = lo; i < hi; i++) {                                               \
+    d = x[i] - r.mean;                                                      \
+    m2 += d * d;                                                            \
+  }                                                                         \
+  r.m2 = m2;                                                                \
+  return r;                                                                 \
+}                                                                           \
+                                                                            \
+double reduce_sum_##SUF(const TYPE *x, long n, int mode)                    \
+{                                                                           \
+  double s = 0.0, *part;                                                    \
+  long i, k, nb;                                                            \
+                                                                            \
+  if (mode == REDUCE_FAST) {                                                \
+    _Pragma("omp parallel for simd schedule(static) reduction(+:s)")        \
+    for (i = 0; i < n; i++)                                                 \
+      s += x[i];                                                            \
+    return s;                                                               \
+  }                                                                         \
+  nb = (n + REDUCE_BLOCK - 1) / REDUCE_BLOCK;                               \
+  part = alloc_blocks(nb, sizeof(double));                                  \
+  _Pragma("omp parallel for schedule(static)")                              \
+  for (k = 0; k < nb; k++)                                                  \
+    part[k] = block_sum_##SUF(x, k * REDUCE_BLOCK,                          \
+                        (k + 1) * REDUCE_BLOCK < n ? (k + 1) * REDUCE_BLOCK \
+                                                   : n);                    \
+  tree_sum(part, nb);                                                       \
+  s = nb ? part[0] : 0.0;                                                   \
+  free(part);                                                               \
+  return s;                                                                 \
+}                                                                           \
+                                                                            \
+double reduce_min_##SUF(const TYPE *x, long n)                              \
+{                                                                           \
+  TYPE m = n > 0 ? x[0] : 0;                                                \
+  long i;                                                                   \
+  _Pragma("omp parallel for simd schedule(static) reduction(min:m)")        \
+  for (i = 0; i < n; i++)                                                   \
+    m = x[i] < m ? x[i] : m;                                                \
+  return m;                                                                 \
+}                                                                           \
+                                                                            \
+double reduce_max_##SUF(const TYPE *x, long n)                              \
+{                                                                           \
+  TYPE m = n > 0 ? x[0] : 0;                                                \
+  long i;                                                                   \
+  _Pragma("omp parallel for simd schedule(static) reduction(max:m)")        \
+  for (i = 0; i < n; i++)                                                   \
+    m = x[i] > m ? x[i] : m;                                                \
+  return m;                                                                 \
+}                                                                           \
+                                                                            \
+long reduce_argmax_##SUF(const TYPE *x, long n)                             \
+{                                                                           \
+  TYPE best = n > 0 ? x[0] : 0;                                             \
+  long where = n > 0 ? 0 : -1;                                              \
+                                                                            \
+  _Pragma("omp parallel")                                                   \
+  {                                                                         \
+  TYPE b = best;                                                            \
+  long w = where, i;                                                        \
+  _Pragma("omp for schedule(static) nowait")                                \
+  for (i = 0; i < n; i++)                                                   \
+    if (x[i] > b) {                                                         \
+      b = x[i];                                                             \
+      w = i;                                                                \
+    }                                                                       \
+  _Pragma("omp critical")                                                   \
+  if (b > best || (b == best && w < where)) {                               \
+    best = b;                                                               \
+    where = w;                                                              \
+  }                                                                         \
+  }                                                                         \
+  return where;                                                             \
+}                                                                           \
+                                                                            \
+reduce_stats_t reduce_stats_##SUF(const TYPE *x, long n, int mode)          \
+{                                                                           \
+  reduce_stats_t r = { 0, 0.0, 0.0 }, *part;                                \
+  long k, nb;                                                               \
+                                                                            \
+  if (mode == REDUCE_FAST) {                                                \
+    _Pragma("omp parallel")                                                 \
+    {                                                                       \
+    int nt = omp_get_num_threads(), tid = omp_get_thread_num();             \
+    long chunk = (n + nt - 1) / nt;                                         \
+    long lo = tid * chunk < n ? tid * chunk : n;                            \
+    long hi = lo + chunk < n ? lo + chunk : n;                              \
+    reduce_stats_t mine = block_stats_##SUF(x, lo, hi);                     \
+    _Pragma("omp critical")                                                 \
+    r = merge_stats(r, mine);                                               \
+    }                                                                       \
+    return r;                                                               \
+  }                                                                         \
+  nb = (n + REDUCE_BLOCK - 1) / REDUCE_BLOCK;                               \
+  part = alloc_blocks(nb, sizeof(reduce_stats_t));                          \
+  _Pragma("omp parallel for schedule(static)")                              \
+  for (k = 0; k < nb; k++)                                                  \
+    part[k] = block_stats_##SUF(x, k * REDUCE_BLOCK,                        \
+                        (k + 1) * REDUCE_BLOCK < n ? (k + 1) * REDUCE_BLOCK \
+                                                   : n);                    \
+  tree_stats(part, nb);                                                     \
+  if (nb) r = part[0];                                                      \
+  free(part);                                                               \
+  return r;                                                                 \
+}
+
+DEFINE_REDUCTIONS(d, double)
+DEFINE_REDUCTIONS(f, float)
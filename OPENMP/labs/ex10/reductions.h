@@ -0,0 +1,47 @@
+/******************************************************************************
+* FILE: reductions.h
+* DESCRIPTION:
+*   Parallel reductions for the OpenMP labs (implementation in
+*   reductions.c).  omp_erro.c shows how easy it is to lose a reduction in
+*   an orphaned "omp for"; these functions open their own parallel region
+*   and return the result, so they must be called outside of one.
+*
+*   Sums and statistics take a mode:
+*     REDUCE_FAST          - "reduction" clause of the runtime; the order
+*                            of the additions, and so the last bits of the
+*                            result, depend on the number of threads;
+*     REDUCE_DETERMINISTIC - the data is cut in fixed blocks of
+*                            REDUCE_BLOCK elements and the block results
+*                            are combined in a fixed pairwise tree, so the
+*                            result is bitwise the same for any number of
+*                            threads (for the same binary).
+*   Minimum, maximum and argmax are exact and do not need a mode; argmax
+*   returns the smallest index of the largest element.
+*   Float data is accumulated in double.
+******************************************************************************/
+#ifndef REDUCTIONS_H
+#define REDUCTIONS_H
+
+#define REDUCE_FAST           0
+#define REDUCE_DETERMINISTIC  1
+#define REDUCE_BLOCK          4096
+
+typedef struct {
+  long   n;                   /* number of elements */
+  double mean;
+  double m2;                  /* sum of squared deviations from the mean */
+} reduce_stats_t;
+
+extern double reduce_sum_d(const double *x, long n, int mode);
+extern double reduce_sum_f(const float *x, long n, int mode);
+extern double reduce_min_d(const double *x, long n);
+extern double reduce_min_f(const float *x, long n);
+extern double reduce_max_d(const double *x, long n);
+extern double reduce_max_f(const float *x, long n);
+extern long   reduce_argmax_d(const double *x, long n);
+extern long   reduce_argmax_f(const float *x, long n);
+extern reduce_stats_t reduce_stats_d(const double *x, long n, int mode);
+extern reduce_stats_t reduce_stats_f(const float *x, long n, int mode);
+extern double reduce_variance(reduce_stats_t s);   /* sample variance */
+
+#endif /* REDUCTIONS_H */
@@ -0,0 +1,315 @@
+/*
+ * "loop_driver.c" - Fork-join overhead of the lab loops
+ *
+ * loop.c runs one loop of n iterations on nt threads and prints every
+ * iteration.  This driver times the loop bodies of the labs for a range
+ * of n and of thread counts, under:
+ *     serial   - no OpenMP, the reference;
+ *     for      - "parallel for schedule(static)" (ex4, ex5, ex11);
+ *     taskloop - "single" + "taskloop" (ex6);
+ *     nested   - an outer team of -o threads, each splitting its half
+ *                (third, ...) of the range with an inner "parallel for"
+ *                of nt/o threads, rounded down; the threads column then
+ *                shows the o * (nt/o) threads actually used.
+ * The bodies are:
+ *     empty  - only the loop index is added, so the time is the overhead;
+ *     vadd   - c[i] = a[i] + b[i] (ex4, ex5, ex7);
+ *     dot    - a[i] * b[i] (ex2, ex10);
+ *     matvec - a row of COLS elements times a vector (ex8);
+ *     mm     - one element of the NRA x NCB product of ex3.
+ * Every body is summed with a reduction, which is also the check value.
+ *
+ * Output is CSV, one line per body, strategy, n and thread count:
+ *     body,strategy,n,threads,bind,places,reps,best_s,median_s,ns_per_iter
+ * With -b and/or -p the driver runs itself again for every combination
+ * of OMP_PROC_BIND and OMP_PLACES in the lists, e.g.
+ *     loop_driver -b close,spread -p threads,cores > timings.csv
+ *
+ * Usage: loop_driver [-n n1,n2,...] [-t t1,t2,...] [-k body,...]
+ *                    [-s strategy,...] [-o outer] [-r reps]
+ *                    [-b bind,...] [-p places,...]
+ * Build: gcc -O2 -fopenmp -o loop_driver loop_driver.c
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "omp.h"
+
+#define MAXLIST  32
+#define COLS     16             /* matvec row length */
+#define MROWS    4096           /* matvec rows, reused for large n */
+#define NRA      62             /* ex3 */
+#define NCA      15
+#define NCB      7
+#define WORK     20000000L      /* iterations timed per point, about */
+
+static double *a, *b, *c, *mat;
+static volatile double sink;    /* keeps the compiler from removing loops */
+static double ma[NRA][NCA], mb[NCA][NCB];
+
+/*
+ * Loop bodies: a statement that adds the value of iteration i to s
+ */
+#define BODY_empty   s += i;
+#define BODY_vadd    { c[i] = a[i] + b[i]; s += c[i]; }
+#define BODY_dot     s += a[i] * b[i];
+#define BODY_matvec  { const double *r = mat + (i % MROWS) * COLS; double t = 0; \
+                       int j; for (j = 0; j < COLS; j++) t += r[j] * b[j];        \
+                       s += t; }
+#define BODY_mm      { int r = (i / NCB) % NRA, q = i % NCB, k; double t = 0;    \
+                       for (k = 0; k < NCA; k++) t += ma[r][k] * mb[k][q];        \
+                       s += t; }
+
+static int outer = 2;
+
+/* threads used by the nested strategy: outer teams of nt/outer threads */
+static int nested_threads(int nt)
+{
+    int no = outer < nt ? outer : nt;
+    return no * (nt / no);
+}
+
+#define DEFINE_BODY(name)                                                     \
+static double serial_##name(long n, int nt)                                   \
+{                                                                             \
+    double s = 0;                                                             \
+    long i;                                                                   \
+    (void)nt;                                                                 \
+    for (i = 0; i < n; i++)                                                   \
+        BODY_##name                                                           \
+    return s;                                                                 \
+}                                                                             \
+static double for_##name(long n, int nt)                                      \
+{                                                                             \
+    double s = 0;                                                             \
+    long i;                                                                   \
+    _Pragma("omp parallel for schedule(static) num_threads(nt) reduction(+:s)") \
+    for (i = 0; i < n; i++)                                                   \
+        BODY_##name                                                           \
+    return s;                                                                 \
+}                                                                             \
+static double taskloop_##name(long n, int nt)                                 \
+{                                                                             \
+    double s = 0;                                                             \
+    long i;                                                                   \
+    _Pragma("omp parallel num_threads(nt)")                                   \
+    _Pragma("omp single")                                                     \
+    _Pragma("omp taskloop reduction(+:s)")                                    \
+    for (i = 0; i < n; i++)                                                   \
+        BODY_##name                                                           \
+    return s;                                                                 \
+}                                                                             \
+static double nested_##name(long n, int nt)                                   \
+{                                                                             \
+    double s = 0;                                                             \
+    int no = outer < nt ? outer : nt, ni = nt / no;                           \
+    _Pragma("omp parallel num_threads(no) reduction(+:s)")                    \
+    {                                                                         \
+        int o = omp_get_thread_num();                                         \
+        long lo = n * o / no, hi = n * (o + 1) / no, i;                       \
+        _Pragma("omp parallel for schedule(static) num_threads(ni) reduction(+:s)") \
+        for (i = lo; i < hi; i++)                                             \
+            BODY_##name                                                       \
+    }                                                                         \
+    return s;                                                                 \
+}
+
+DEFINE_BODY(empty)
+DEFINE_BODY(vadd)
+DEFINE_BODY(dot)
+DEFINE_BODY(matvec)
+DEFINE_BODY(mm)
+
+typedef double (*loop_fn)(long n, int nt);
+
+static const char *strategies[] = { "serial", "for", "taskloop", "nested" };
+#define NSTRAT 4
+
+static struct {
+    const char *name;
+    loop_fn fn[NSTRAT];
+} bodies[] = {
+#define ENTRY(x) { #x, { serial_##x, for_##x, taskloop_##x, nested_##x } }
+    ENTRY(empty), ENTRY(vadd), ENTRY(dot), ENTRY(matvec), ENTRY(mm)
+};
+#define NBODY (int)(sizeof(bodies) / sizeof(bodies[0]))
+
+/*
+ * Comma-separated list of positive numbers; -1 if it is not one
+ */
+static int parse_list(const char *arg, long *v)
+{
+    int k = 0;
+    char *end;
+    while (k < MAXLIST) {
+        v[k] = strtol(arg, &end, 10);
+        if (end == arg || v[k] <= 0) return -1;
+        k++;
+        if (*end == '\0') return k;
+        if (*end != ',') return -1;
+        arg = end + 1;
+    }
+    return -1;                  /* more than MAXLIST numbers */
+}
+
+/*
+ * Whether name is in a comma-separated list (or the list is empty)
+ */
+static int in_list(const char *list, const char *name)
+{
+    size_t len = strlen(name);
+    const char *p = list;
+    if (list == NULL) return 1;
+    while ((p = strstr(p, name)) != NULL) {
+        if ((p == list || p[-1] == ',') && (p[len] == ',' || p[len] == '\0'))
+            return 1;
+        p += len;
+    }
+    return 0;
+}
+
+static int cmp_double(const void *x, const void *y)
+{
+    double d = *(const double *)x - *(const double *)y;
+    return (d > 0) - (d < 0);
+}
+
+/*
+ * Run this program again for every OMP_PROC_BIND x OMP_PLACES
+ */
+static int run_variations(char *argv[], char *binds, char *places)
+{
+    char *bl[MAXLIST], *pl[MAXLIST], *tok;
+    int nb = 0, np = 0, i, j, status;
+    pid_t pid;
+
+    for (tok = strtok(binds, ","); tok && nb < MAXLIST; tok = strtok(NULL, ","))
+        bl[nb++] = tok;
+    for (tok = strtok(places, ","); tok && np < MAXLIST; tok = strtok(NULL, ","))
+        pl[np++] = tok;
+    if (nb == 0) bl[nb++] = NULL;
+    if (np == 0) pl[np++] = NULL;
+
+    for (i = 0; i < nb; i++)
+        for (j = 0; j < np; j++) {
+            fflush(stdout);
+            if ((pid = fork()) == 0) {
+                if (bl[i]) setenv("OMP_PROC_BIND", bl[i], 1);
+                if (pl[j]) setenv("OMP_PLACES", pl[j], 1);
+                setenv("LOOP_DRIVER_CHILD", "1", 1);
+                execv("/proc/self/exe", argv);
+                perror("execv");
+                _exit(1);
+            }
+            if (pid < 0 || waitpid(pid, &status, 0) < 0 || status != 0)
+                return 1;
+        }
+    return 0;
+}
+
+int main( int argc, char *argv[] )
+{
+    long nlist[MAXLIST], tlist[MAXLIST], n, nmax = 0, i, reps, r;
+    int nn = 0, nt = 0, opt, k, st, ti, fixed_reps = 0, bad = 0;
+    char *bodies_sel = NULL, *strat_sel = NULL, *binds = NULL, *places = NULL;
+    const char *bind, *place;
+    double t, *times;
+    int child = getenv("LOOP_DRIVER_CHILD") != NULL;
+
+    while ((opt = getopt(argc, argv, "n:t:k:s:o:r:b:p:")) != -1)
+        switch (opt) {
+        case 'n': if ((nn = parse_list(optarg, nlist)) < 0) bad = 1; break;
+        case 't': if ((nt = parse_list(optarg, tlist)) < 0) bad = 1; break;
+        case 'k': bodies_sel = optarg; break;
+        case 's': strat_sel = optarg; break;
+        case 'o': outer = atoi(optarg); break;
+        case 'r': if ((fixed_reps = atoi(optarg)) < 1) bad = 1; break;
+        case 'b': binds = optarg; break;
+        case 'p': places = optarg; break;
+        default: bad = 1; break;
+        }
+    if (bad) {
+        fprintf(stderr, "usage: %s [-n n1,n2,...] [-t t1,t2,...] "
+                "[-k body,...] [-s strategy,...] [-o outer] [-r reps] "
+                "[-b bind,...] [-p places,...]\n"
+                "  n, threads and reps must be positive\n", argv[0]);
+        return 1;
+    }
+
+    if (!child)
+        printf("body,strategy,n,threads,bind,places,reps,best_s,median_s,"
+               "ns_per_iter\n");
+    if (!child && (binds || places))
+        return run_variations(argv, binds ? binds : "", places ? places : "");
+
+    if (nn == 0)
+        for (n = 10; n <= 10000000; n *= 10)
+            nlist[nn++] = n;
+    if (nt == 0)
+        tlist[nt++] = omp_get_max_threads();
+    for (k = 0; k < nn; k++)
+        if (nlist[k] > nmax) nmax = nlist[k];
+    if (outer < 1) outer = 1;
+    omp_set_max_active_levels(2);
+    bind = getenv("OMP_PROC_BIND") ? getenv("OMP_PROC_BIND") : "";
+    place = getenv("OMP_PLACES") ? getenv("OMP_PLACES") : "";
+
+    /*
+     * Data, first touched by the threads of a static loop
+     */
+    a = malloc(nmax * sizeof(double));
+    b = malloc((nmax > COLS ? nmax : COLS) * sizeof(double));
+    c = malloc(nmax * sizeof(double));
+    mat = malloc(MROWS * COLS * sizeof(double));
+    #pragma omp parallel for schedule(static)
+    for (i = 0; i < nmax; i++) {
+        a[i] = i * 0.5;
+        b[i] = 2.0;
+        c[i] = 0.0;
+    }
+    for (i = nmax; i < COLS; i++)
+        b[i] = 2.0;
+    for (i = 0; i < MROWS * COLS; i++)
+        mat[i] = (i % COLS) + 1.0;
+    for (i = 0; i < NRA * NCA; i++)
+        ma[i / NCA][i % NCA] = i / NCA + i % NCA;
+    for (i = 0; i < NCA * NCB; i++)
+        mb[i / NCB][i % NCB] = (i / NCB) * (i % NCB);
+
+    for (k = 0; k < NBODY; k++) {
+        if (!in_list(bodies_sel, bodies[k].name)) continue;
+        for (st = 0; st < NSTRAT; st++) {
+            if (!in_list(strat_sel, strategies[st])) continue;
+            for (i = 0; i < nn; i++) {
+                n = nlist[i];
+                reps = fixed_reps ? fixed_reps : WORK / n;
+                if (reps < 5) reps = 5;
+                if (reps > 100000) reps = 100000;
+                times = malloc(reps * sizeof(double));
+                for (ti = 0; ti < nt; ti++) {
+                    /* the serial loop does not depend on the threads */
+                    if (st == 0 && ti > 0) break;
+                    bodies[k].fn[st](n, tlist[ti]);   /* warm up */
+                    for (r = 0; r < reps; r++) {
+                        t = omp_get_wtime();
+                        sink = bodies[k].fn[st](n, tlist[ti]);
+                        times[r] = omp_get_wtime() - t;
+                    }
+                    qsort(times, reps, sizeof(double), cmp_double);
+                    printf("%s,%s,%ld,%ld,%s,%s,%ld,%.9f,%.9f,%.3f\n",
+                           bodies[k].name, strategies[st], n,
+                           st == 0 ? 1 : st == 3 ? nested_threads(tlist[ti])
+                                                 : tlist[ti],
+                           bind, place, reps,
+                           times[0], times[reps / 2], times[0] / n * 1e9);
+                }
+                free(times);
+            }
+        }
+    }
+    free(a); free(b); free(c); free(mat);
+    return 0;
+}
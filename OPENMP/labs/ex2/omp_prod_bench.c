@@ -0,0 +1,201 @@
+/******************************************************************************
+* FILE: omp_prod_bench.c
+* DESCRIPTION:
+*   OpenMP Example - Dot product at scale - C Version
+*   omp_prod_vet.c reduces two float[100] arrays; this version takes the
+*   vector length at run time so that the compilers and runtimes of the
+*   prebuilt omp_prod_* binaries can be compared where it matters, when the
+*   vectors do not fit in the caches.
+*   - the vectors are allocated on the heap, aligned to 64 bytes, and
+*     initialized by the threads with the same static schedule as the
+*     product, so each page is first touched (and placed) on the NUMA node
+*     of the thread that will read it;
+*   - the products use "parallel for simd" with a reduction, with three
+*     accumulations: float (as omp_prod_vet.c), double, and compensated
+*     (Kahan) float sums; the compensated sum keeps SIMDLEN independent
+*     lanes per thread so that it still vectorizes;
+*   - a STREAM-style triad on the same arrays gives the reference memory
+*     bandwidth; each product is reported in GB/s and as a fraction of it.
+*   The error of each result is given against a long double sum.
+* USAGE:  omp_prod_bench [n] [repetitions]   (n >= 2)
+* BUILD:  gcc -O3 -march=native -fopenmp -o omp_prod_bench omp_prod_bench.c
+*         (do not use -ffast-math: it removes the Kahan compensation)
+******************************************************************************/
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#define ALIGN   64
+#define SIMDLEN 16             /* independent lanes of the compensated sum */
+
+static void *alloc_vector(long n, size_t size)
+{
+  size_t bytes = ((n * size + ALIGN - 1) / ALIGN) * ALIGN;
+  void *p = aligned_alloc(ALIGN, bytes);
+  if (p == NULL) {
+    printf("Not enough memory for %ld elements. Quitting.\n", n);
+    exit(1);
+  }
+  return p;
+}
+
+/*** float accumulation, as in omp_prod_vet.c ***/
+float dot_float(long n, const float *a, const float *b)
+{
+  float result = 0.0f;
+  long i;
+  #pragma omp parallel for simd schedule(static) reduction(+:result) \
+                               aligned(a,b:ALIGN)
+  for (i = 0; i < n; i++)
+    result += a[i] * b[i];
+  return result;
+}
+
+/*** float vectors, double accumulation ***/
+double dot_float_double(long n, const float *a, const float *b)
+{
+  double result = 0.0;
+  long i;
+  #pragma omp parallel for simd schedule(static) reduction(+:result) \
+                               aligned(a,b:ALIGN)
+  for (i = 0; i < n; i++)
+    result += (double)a[i] * b[i];
+  return result;
+}
+
+/*** float vectors, compensated (Kahan) float accumulation ***/
+double dot_float_kahan(long n, const float *a, const float *b)
+{
+  double result = 0.0;
+
+  #pragma omp parallel reduction(+:result)
+  {
+  float s[SIMDLEN] __attribute__((aligned(ALIGN)));
+  float c[SIMDLEN] __attribute__((aligned(ALIGN)));
+  int nt = omp_get_num_threads(), tid = omp_get_thread_num(), l;
+  /* same blocks as schedule(static), rounded to whole lane groups */
+  long chunk = ((n + nt - 1) / nt + SIMDLEN - 1) / SIMDLEN * SIMDLEN;
+  long lo = tid * chunk, hi = lo + chunk < n ? lo + chunk : n, i;
+
+  for (l = 0; l < SIMDLEN; l++) s[l] = c[l] = 0.0f;
+  for (i = lo; i + SIMDLEN <= hi; i += SIMDLEN) {
+    #pragma omp simd aligned(s,c:ALIGN)
+    for (l = 0; l < SIMDLEN; l++) {
+      float y = a[i+l] * b[i+l] - c[l];
+      float t = s[l] + y;
+      c[l] = (t - s[l]) - y;
+      s[l] = t;
+    }
+  }
+  for (; i < hi; i++) {
+    float y = a[i] * b[i] - c[0];
+    float t = s[0] + y;
+    c[0] = (t - s[0]) - y;
+    s[0] = t;
+  }
+  for (l = 0; l < SIMDLEN; l++)
+    result += (double)s[l] - c[l];
+  }
+  return result;
+}
+
+/*** double vectors, double accumulation ***/
+double dot_double(long n, const double *a, const double *b)
+{
+  double result = 0.0;
+  long i;
+  #pragma omp parallel for simd schedule(static) reduction(+:result) \
+                               aligned(a,b:ALIGN)
+  for (i = 0; i < n; i++)
+    result += a[i] * b[i];
+  return result;
+}
+
+/*** STREAM triad: c = a + q*b ***/
+static void triad(long n, float *c, const float *a, const float *b, float q)
+{
+  long i;
+  #pragma omp parallel for simd schedule(static) aligned(a,b,c:ALIGN)
+  for (i = 0; i < n; i++)
+    c[i] = a[i] + q * b[i];
+}
+
+int main (int argc, char *argv[])
+{
+long  i, n = 1L << 25;
+int   r, reps = 10;
+float *a, *b, *c;
+double *ad, *bd;
+long double exact = 0.0L;
+double t, best[5], res[5], bw[5], bytes[5];
+volatile double sink = 0.0;
+const char *name[5] = { "triad (reference)", "float sum",
+                        "double sum", "kahan float sum", "double vectors" };
+
+if (argc >= 2) n = atol(argv[1]);
+if (argc >= 3) reps = atoi(argv[2]);
+/* a[0] = 0, the relative errors need a nonzero product */
+if (n < 2 || reps < 1) {
+  printf("Usage: %s [n >= 2] [repetitions >= 1]. Quitting.\n", argv[0]);
+  exit(1);
+  }
+
+a = alloc_vector(n, sizeof(float));
+b = alloc_vector(n, sizeof(float));
+c = alloc_vector(n, sizeof(float));
+ad = alloc_vector(n, sizeof(double));
+bd = alloc_vector(n, sizeof(double));
+
+/* Some initializations - first touch with the schedule of the products */
+#pragma omp parallel for simd schedule(static)
+for (i=0; i < n; i++)
+  {
+  a[i] = (i % 1000) * 1.0f;
+  b[i] = (i % 1000) * 2.0f;
+  c[i] = 0.0f;
+  ad[i] = a[i];
+  bd[i] = b[i];
+  }
+for (i=0; i < n; i++)
+  exact += (long double)a[i] * b[i];
+
+bytes[0] = 3.0 * n * sizeof(float);
+bytes[1] = bytes[2] = bytes[3] = 2.0 * n * sizeof(float);
+bytes[4] = 2.0 * n * sizeof(double);
+for (i = 0; i < 5; i++) best[i] = 1e30;
+
+for (r = 0; r < reps; r++) {
+  t = omp_get_wtime(); triad(n, c, a, b, 3.0f);
+  t = omp_get_wtime() - t; if (t < best[0]) best[0] = t;
+  sink += c[n/2];
+
+  t = omp_get_wtime(); res[1] = dot_float(n, a, b);
+  t = omp_get_wtime() - t; if (t < best[1]) best[1] = t;
+
+  t = omp_get_wtime(); res[2] = dot_float_double(n, a, b);
+  t = omp_get_wtime() - t; if (t < best[2]) best[2] = t;
+
+  t = omp_get_wtime(); res[3] = dot_float_kahan(n, a, b);
+  t = omp_get_wtime() - t; if (t < best[3]) best[3] = t;
+
+  t = omp_get_wtime(); res[4] = dot_double(n, ad, bd);
+  t = omp_get_wtime() - t; if (t < best[4]) best[4] = t;
+  }
+
+printf("Dot product of %ld elements, %d threads, best of %d runs\n",
+       n, omp_get_max_threads(), reps);
+printf("%-18s %10s %10s %8s %14s\n", "kernel", "time (s)", "GB/s",
+       "% triad", "relative error");
+for (i = 0; i < 5; i++) {
+  bw[i] = bytes[i] / best[i] * 1e-9;
+  printf("%-18s %10.6f %10.2f %8.1f", name[i], best[i], bw[i],
+         100.0 * bw[i] / bw[0]);
+  if (i > 0)
+    printf(" %14.2e", (double)fabsl((res[i] - exact) / exact));
+  printf("\n");
+  }
+
+free(a); free(b); free(c); free(ad); free(bd);
+return 0;
+}
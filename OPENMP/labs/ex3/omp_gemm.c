@@ -0,0 +1,217 @@
+/******************************************************************************
+* FILE: omp_gemm.c
+* DESCRIPTION:
+*   OpenMP Example - Blocked Matrix Multiply - C Version
+*   Grown from omp_mm.c: C = C + A*B with sizes chosen at run time,
+*   row-major matrices allocated on the heap and aligned to 64 bytes.
+*   The multiply is blocked for the caches and the registers:
+*     - B is cut in KC x NC blocks (L3) and A in MC x KC blocks (L2); both
+*       are packed into contiguous buffers (B in NR-column slivers, A in
+*       MR-row slivers, zero padded), so the inner loops read memory
+*       linearly;
+*     - the MR x NR tiles of C are computed by a micro-kernel that keeps
+*       the tile in registers; its inner loop is an "omp simd" loop over
+*       NR columns;
+*     - the threads pack each block together and then share the MR x NR
+*       tiles of C that use the block of A with a collapse(2) loop.
+*   The benchmark runs the blocked and the naive i-j-k multiply (the loop
+*   of omp_mm.c with the rows shared by the threads) for each size, and
+*   prints GFLOP/s and the largest difference between the two results.
+* USAGE:  omp_gemm [size ...]       (square sizes, default 128 .. 2048)
+*         omp_gemm -r M N K         (one rectangular run)
+* BUILD:  gcc -O3 -march=native -fopenmp -o omp_gemm omp_gemm.c
+* AUTHOR: based on omp_mm.c by Blaise Barney
+******************************************************************************/
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define MR  4                  /* rows of the register tile of C           */
+#define NR  8                  /* columns of the register tile of C        */
+#define KC  256                /* depth of the packed panels (L1/L2)       */
+#define MC  96                 /* rows of the packed block of A (L2)       */
+#define NC  2048               /* columns of the packed block of B (L3)    */
+#define ALIGN 64               /* alignment of all buffers, in bytes       */
+
+static double *alloc_matrix(long rows, long cols)
+{
+  size_t bytes = ((rows * cols * sizeof(double) + ALIGN - 1) / ALIGN) * ALIGN;
+  double *p = aligned_alloc(ALIGN, bytes ? bytes : ALIGN);
+  if (p == NULL) {
+    printf("Not enough memory for a %ld x %ld matrix. Quitting.\n", rows, cols);
+    exit(1);
+  }
+  return p;
+}
+
+/*** Pack a kc x nc block of B into NR-column slivers, zero padded ***/
+static void pack_b(int kc, int nc, const double *b, int ldb, double *bp)
+{
+  int jr, p, j;
+  #pragma omp for schedule(static)
+  for (jr = 0; jr < nc; jr += NR) {
+    double *dst = bp + (long)jr * kc;
+    int nr = nc - jr < NR ? nc - jr : NR;
+    for (p = 0; p < kc; p++) {
+      for (j = 0; j < nr; j++)
+        dst[p*NR + j] = b[(long)p*ldb + jr + j];
+      for (; j < NR; j++)
+        dst[p*NR + j] = 0.0;
+    }
+  }
+}
+
+/*** Pack an m x kc block of A into MR-row slivers, zero padded ***/
+static void pack_a(int m, int kc, const double *a, int lda, double *ap)
+{
+  int ir, p, i;
+  #pragma omp for schedule(static)
+  for (ir = 0; ir < m; ir += MR) {
+    double *dst = ap + (long)ir * kc;
+    int mr = m - ir < MR ? m - ir : MR;
+    for (p = 0; p < kc; p++) {
+      for (i = 0; i < mr; i++)
+        dst[p*MR + i] = a[(long)(ir + i)*lda + p];
+      for (; i < MR; i++)
+        dst[p*MR + i] = 0.0;
+    }
+  }
+}
+
+/*** C[mr x nr] += Ap[MR x kc] * Bp[kc x NR], tile kept in registers ***/
+static void micro_kernel(int kc, const double *restrict ap,
+                         const double *restrict bp, double *c, int ldc,
+                         int mr, int nr)
+{
+  double t[MR][NR] __attribute__((aligned(ALIGN)));
+  int p, i, j;
+
+  memset(t, 0, sizeof(t));
+  for (p = 0; p < kc; p++) {
+    const double *bb = bp + p*NR;
+    for (i = 0; i < MR; i++) {
+      double av = ap[p*MR + i];
+      #pragma omp simd aligned(bb:ALIGN)
+      for (j = 0; j < NR; j++)
+        t[i][j] += av * bb[j];
+    }
+  }
+  for (i = 0; i < mr; i++)
+    for (j = 0; j < nr; j++)
+      c[(long)i*ldc + j] += t[i][j];
+}
+
+/*
+ * C[m x n] += A[m x k] * B[k x n], all row-major.
+ * Must be called from outside a parallel region.
+ */
+void gemm_blocked(int m, int n, int k, const double *a, int lda,
+                  const double *b, int ldb, double *c, int ldc)
+{
+  double *ap = alloc_matrix(MC, KC);
+  double *bp = alloc_matrix(NC + NR, KC);
+  int jc, pc;
+
+  for (jc = 0; jc < n; jc += NC) {
+    int nc = n - jc < NC ? n - jc : NC;
+    for (pc = 0; pc < k; pc += KC) {
+      int kc = k - pc < KC ? k - pc : KC;
+      int ic, ir, jr;
+
+      #pragma omp parallel private(ic,ir,jr)
+      {
+      pack_b(kc, nc, b + (long)pc*ldb + jc, ldb, bp);
+      for (ic = 0; ic < m; ic += MC) {
+        int mc = m - ic < MC ? m - ic : MC;
+        int mpad = (mc + MR - 1) / MR * MR;
+        pack_a(mc, kc, a + (long)ic*lda + pc, lda, ap);
+        /* implicit barrier of the pack loops: blocks ready */
+
+        #pragma omp for collapse(2) schedule(static)
+        for (ir = 0; ir < mpad; ir += MR)
+          for (jr = 0; jr < nc; jr += NR) {
+            int mr = mc - ir < MR ? mc - ir : MR;
+            int nr = nc - jr < NR ? nc - jr : NR;
+            micro_kernel(kc, ap + (long)ir*kc, bp + (long)jr*kc,
+                         c + (long)(ic + ir)*ldc + jc + jr, ldc, mr, nr);
+          }
+        /* implicit barrier: the block of A is free for the next ic */
+        }
+      }
+    }
+  }
+  free(ap);
+  free(bp);
+}
+
+/*** Naive i-j-k multiply of omp_mm.c, rows shared by the threads ***/
+void gemm_naive(int m, int n, int k, const double *a, int lda,
+                const double *b, int ldb, double *c, int ldc)
+{
+  int i, j, l;
+  #pragma omp parallel for private(j,l) schedule(static)
+  for (i = 0; i < m; i++)
+    for (j = 0; j < n; j++)
+      for (l = 0; l < k; l++)
+        c[(long)i*ldc + j] += a[(long)i*lda + l] * b[(long)l*ldb + j];
+}
+
+static void bench(int m, int n, int k)
+{
+  double *a = alloc_matrix(m, k), *b = alloc_matrix(k, n);
+  double *c1 = alloc_matrix(m, n), *c2 = alloc_matrix(m, n);
+  double t, t_naive, t_blocked, err = 0.0, flops = 2.0 * m * n * k;
+  long i;
+
+  /*** Initialize matrices as in omp_mm.c, first touch by the threads ***/
+  #pragma omp parallel for
+  for (i = 0; i < (long)m*k; i++) a[i] = (i / k + i % k) % 17;
+  #pragma omp parallel for
+  for (i = 0; i < (long)k*n; i++) b[i] = ((i / n) * (i % n)) % 13;
+  #pragma omp parallel for
+  for (i = 0; i < (long)m*n; i++) c1[i] = c2[i] = 0.0;
+
+  t = omp_get_wtime();
+  gemm_naive(m, n, k, a, k, b, n, c1, n);
+  t_naive = omp_get_wtime() - t;
+
+  t = omp_get_wtime();
+  gemm_blocked(m, n, k, a, k, b, n, c2, n);
+  t_blocked = omp_get_wtime() - t;
+
+  for (i = 0; i < (long)m*n; i++)
+    if (fabs(c1[i] - c2[i]) > err) err = fabs(c1[i] - c2[i]);
+
+  printf("%6d %6d %6d   %9.2f %9.2f   %7.2fx   %.1e\n", m, n, k,
+         flops / t_naive * 1e-9, flops / t_blocked * 1e-9,
+         t_naive / t_blocked, err);
+  free(a); free(b); free(c1); free(c2);
+}
+
+int main (int argc, char *argv[])
+{
+int i, size;
+
+printf("Blocked matrix multiply with %d threads "
+       "(MR=%d NR=%d MC=%d KC=%d NC=%d)\n",
+       omp_get_max_threads(), MR, NR, MC, KC, NC);
+printf("%6s %6s %6s   %9s %9s   %8s   %s\n", "M", "N", "K",
+       "naive", "blocked", "speedup", "max diff");
+printf("%20s   %9s %9s\n", "", "GFLOP/s", "GFLOP/s");
+
+if (argc == 5 && strcmp(argv[1], "-r") == 0)
+  bench(atoi(argv[2]), atoi(argv[3]), atoi(argv[4]));
+else if (argc > 1)
+  for (i = 1; i < argc; i++) {
+    size = atoi(argv[i]);
+    bench(size, size, size);
+    }
+else
+  for (size = 128; size <= 2048; size *= 2)
+    bench(size, size, size);
+
+printf ("Done.\n");
+return 0;
+}
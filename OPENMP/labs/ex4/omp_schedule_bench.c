@@ -0,0 +1,169 @@
+/******************************************************************************
+* FILE: omp_schedule_bench.c
+* DESCRIPTION:
+*   OpenMP Example - Loop scheduling benchmark - C/C++ Version
+*   omp_do_for.c runs N=100 iterations with a fixed CHUNKSIZE and prints
+*   from inside the loop, so it cannot be timed.  This harness runs the
+*   same work-shared loop with synthetic iteration costs under every
+*   schedule kind (static, dynamic, guided, auto) and a sweep of chunk
+*   sizes, selected at run time with omp_set_schedule() and
+*   schedule(runtime).  Workloads:
+*     uniform  - every iteration costs WORK units;
+*     linear   - iteration i costs WORK * 2i/N units (same total);
+*     skewed   - random costs, most iterations cheap and a few 50x more
+*                expensive (same mean).
+*   For each run it prints the wall time, the imbalance (busiest thread
+*   time over the mean thread time, 1.00 is perfect) and the iterations
+*   done by each thread.  -c prints CSV instead of the table.
+* USAGE:  omp_schedule_bench [-c] [-n iterations] [-w work] [-r reps]
+*                            [uniform|linear|skewed ...]
+* BUILD:  gcc -O2 -fopenmp -o omp_schedule_bench omp_schedule_bench.c
+* AUTHOR: based on omp_workshare1.c by Blaise Barney
+******************************************************************************/
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define N        10000         /* default number of iterations */
+#define WORK     2000          /* default mean cost of an iteration */
+#define MAXTHR   1024
+
+static volatile double sink;
+
+/*** Burn "units" of work, the body of the loop ***/
+static double work(int units)
+{
+  double x = 0.0;
+  int k;
+  for (k = 0; k < units; k++)
+    x += k * 0.5;
+  return x;
+}
+
+static void make_costs(const char *kind, int n, int w, int *cost)
+{
+  int i;
+  unsigned int seed = 12345;
+
+  for (i = 0; i < n; i++) {
+    if (strcmp(kind, "linear") == 0)
+      cost[i] = (int)((2.0 * w * i) / n);
+    else if (strcmp(kind, "skewed") == 0)
+      /* 2% of the iterations cost 50x more; the rest keep the mean */
+      cost[i] = (rand_r(&seed) % 100 < 2) ? 50 * w : w / 49 + 1;
+    else
+      cost[i] = w;
+  }
+}
+
+/*
+ * Run the loop once on nthreads threads under the current runtime schedule.
+ * busy[t] gets the time spent in the loop body by thread t,
+ * iters[t] the number of iterations it did.
+ */
+static double run(int n, int nthreads, const int *cost, double *busy,
+                  long *iters)
+{
+  double t0 = omp_get_wtime();
+
+  #pragma omp parallel num_threads(nthreads)
+  {
+  int tid = omp_get_thread_num(), i;
+  double b = 0.0, x = 0.0, t;
+  long it = 0;
+
+  #pragma omp for schedule(runtime)
+  for (i = 0; i < n; i++) {
+    t = omp_get_wtime();
+    x += work(cost[i]);
+    b += omp_get_wtime() - t;
+    it++;
+  }
+  busy[tid] = b;
+  iters[tid] = it;
+  #pragma omp atomic
+  sink += x;
+  }
+
+  return omp_get_wtime() - t0;
+}
+
+int main (int argc, char *argv[])
+{
+int n = N, w = WORK, reps = 3, csv = 0, nthreads, i, k, r, t, chunk;
+int *cost, nworkloads = 0;
+const char *workloads[8];
+double busy[MAXTHR], best_busy[MAXTHR], time, best, max, mean;
+long iters[MAXTHR], best_iters[MAXTHR];
+struct { omp_sched_t kind; const char *name; } sched[] = {
+  { omp_sched_static, "static" }, { omp_sched_dynamic, "dynamic" },
+  { omp_sched_guided, "guided" }, { omp_sched_auto, "auto" } };
+
+for (i = 1; i < argc; i++) {
+  if (!strcmp(argv[i], "-c")) csv = 1;
+  else if (!strcmp(argv[i], "-n") && i+1 < argc) n = atoi(argv[++i]);
+  else if (!strcmp(argv[i], "-w") && i+1 < argc) w = atoi(argv[++i]);
+  else if (!strcmp(argv[i], "-r") && i+1 < argc) reps = atoi(argv[++i]);
+  else if (strcmp(argv[i], "uniform") && strcmp(argv[i], "linear")
+           && strcmp(argv[i], "skewed")) {
+    fprintf(stderr, "unknown workload %s (uniform, linear or skewed)\n",
+            argv[i]);
+    return 1;
+    }
+  else if (nworkloads < 8) workloads[nworkloads++] = argv[i];
+  }
+if (nworkloads == 0) {
+  workloads[0] = "uniform"; workloads[1] = "linear"; workloads[2] = "skewed";
+  nworkloads = 3;
+  }
+
+nthreads = omp_get_max_threads();
+if (nthreads > MAXTHR) nthreads = MAXTHR;
+cost = malloc(n * sizeof(int));
+
+if (csv)
+  printf("workload,schedule,chunk,time,imbalance,iterations per thread\n");
+else
+  printf("%d iterations, mean cost %d, %d threads, best of %d runs\n",
+         n, w, nthreads, reps);
+
+for (k = 0; k < nworkloads; k++) {
+  make_costs(workloads[k], n, w, cost);
+  if (!csv)
+    printf("\n%-8s %-8s %6s %10s %9s  %s\n", "workload", "schedule",
+           "chunk", "time (s)", "imbalance", "iterations per thread");
+
+  for (i = 0; i < 4; i++)
+    /* chunk 0 is the default of the kind; then powers of 4 up to n/threads */
+    for (chunk = 0; chunk <= n / nthreads; chunk = chunk ? chunk * 4 : 1) {
+      if (sched[i].kind == omp_sched_auto && chunk > 0) break;
+      omp_set_schedule(sched[i].kind, chunk);
+      best = 1e30;
+      for (r = 0; r < reps; r++) {
+        time = run(n, nthreads, cost, busy, iters);
+        if (time < best) {
+          best = time;
+          memcpy(best_busy, busy, nthreads * sizeof(double));
+          memcpy(best_iters, iters, nthreads * sizeof(long));
+          }
+        }
+      for (t = 0, max = 0.0, mean = 0.0; t < nthreads; t++) {
+        mean += best_busy[t] / nthreads;
+        if (best_busy[t] > max) max = best_busy[t];
+        }
+      if (csv)
+        printf("%s,%s,%d,%.6f,%.3f,", workloads[k], sched[i].name, chunk,
+               best, mean > 0.0 ? max / mean : 1.0);
+      else
+        printf("%-8s %-8s %6d %10.6f %9.3f  ", workloads[k], sched[i].name,
+               chunk, best, mean > 0.0 ? max / mean : 1.0);
+      for (t = 0; t < nthreads; t++)
+        printf("%s%ld", t ? (csv ? ";" : " ") : "", best_iters[t]);
+      printf("\n");
+      }
+  }
+
+free(cost);
+return 0;
+}
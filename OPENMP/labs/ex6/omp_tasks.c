@@ -0,0 +1,184 @@
+/******************************************************************************
+* FILE: omp_tasks.c
+* DESCRIPTION:
+*   OpenMP Example - Task Work-sharing - C Version
+*   Task version of omp_sections.c.  The sections version gives the two
+*   array operations c=a+b and d=a*b to two threads, so at most two threads
+*   work and the others wait at the end of the sections.  Here each
+*   operation is cut into grains of GRAIN elements and the grains are run
+*   as tasks, so every thread of the team takes part:
+*     taskloop - each operation is a taskloop with grainsize(GRAIN); both
+*                taskloops are created at once (nogroup) by one thread;
+*     depend   - one task per grain of each operation, plus a task per
+*                grain that adds c and d into e once both grains are done,
+*                ordered with depend clauses instead of a barrier.
+*   All three versions then compute e=c+d, the sections and taskloop
+*   versions after a barrier, so the timings cover the same three passes.
+*   The benchmark times the sections, taskloop and depend versions for
+*   1, 2, 4, ... threads up to omp_get_max_threads(), and checks every
+*   element of c, d and e after each version.
+* USAGE:  omp_tasks [n] [grain] [repetitions]
+* BUILD:  gcc -O2 -fopenmp -o omp_tasks omp_tasks.c
+* AUTHOR: based on omp_workshare2.c by Blaise Barney
+******************************************************************************/
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#define N      (1 << 24)
+#define GRAIN  (1 << 14)
+
+static float *a, *b, *c, *d, *e;
+
+/*** omp_sections.c: one section per array operation, then e=c+d ***/
+static void run_sections(long n)
+{
+long i;
+#pragma omp parallel private(i)
+  {
+  #pragma omp sections
+    {
+    #pragma omp section
+      for (i=0; i<n; i++)
+        c[i] = a[i] + b[i];
+    #pragma omp section
+      for (i=0; i<n; i++)
+        d[i] = a[i] * b[i];
+    }
+  #pragma omp for
+  for (i=0; i<n; i++)
+    e[i] = c[i] + d[i];
+  }
+}
+
+/*** both operations as taskloops of grain elements, then e=c+d ***/
+static void run_taskloop(long n, long grain)
+{
+long i;
+#pragma omp parallel
+#pragma omp single
+  {
+  #pragma omp taskgroup
+    {
+    #pragma omp taskloop grainsize(grain) nogroup
+    for (i=0; i<n; i++)
+      c[i] = a[i] + b[i];
+    #pragma omp taskloop grainsize(grain) nogroup
+    for (i=0; i<n; i++)
+      d[i] = a[i] * b[i];
+    }
+  #pragma omp taskloop grainsize(grain)
+  for (i=0; i<n; i++)
+    e[i] = c[i] + d[i];
+  }
+}
+
+/*** one task per grain, and e=c+d per grain after both are done ***/
+static void run_depend(long n, long grain)
+{
+long lo;
+#pragma omp parallel
+#pragma omp single
+  {
+  for (lo=0; lo<n; lo+=grain) {
+    long hi = lo + grain < n ? lo + grain : n;
+
+    #pragma omp task firstprivate(lo,hi) depend(out: c[lo])
+      {
+      long i;
+      for (i=lo; i<hi; i++)
+        c[i] = a[i] + b[i];
+      }
+    #pragma omp task firstprivate(lo,hi) depend(out: d[lo])
+      {
+      long i;
+      for (i=lo; i<hi; i++)
+        d[i] = a[i] * b[i];
+      }
+    #pragma omp task firstprivate(lo,hi) depend(in: c[lo], d[lo])
+      {
+      long i;
+      for (i=lo; i<hi; i++)
+        e[i] = c[i] + d[i];
+      }
+    }
+  }   /* tasks are complete at the implicit barrier */
+}
+
+/*** largest error of c, d and e against their definition ***/
+static double check(long n)
+{
+long i;
+double err = 0.0, x;
+
+for (i=0; i<n; i++) {
+  x = fabs(c[i] - (a[i] + b[i])); if (x > err) err = x;
+  x = fabs(d[i] - (a[i] * b[i])); if (x > err) err = x;
+  x = fabs(e[i] - (c[i] + d[i])); if (x > err) err = x;
+  }
+return err;
+}
+
+static void clear(long n)
+{
+long i;
+
+for (i=0; i<n; i++)
+  c[i] = d[i] = e[i] = 0.0;
+}
+
+int main (int argc, char *argv[])
+{
+long i, n = N, grain = GRAIN;
+int reps = 5, r, nt, maxt;
+double t, best[3], x[3], ref[3] = { 0.0, 0.0, 0.0 };
+
+if (argc >= 2) n = atol(argv[1]);
+if (argc >= 3) grain = atol(argv[2]);
+if (argc >= 4) reps = atoi(argv[3]);
+if (n < 1 || grain < 1 || reps < 1) {
+  printf("n, grain and repetitions must be at least 1\n");
+  return 1;
+  }
+
+a = malloc(n * sizeof(float)); b = malloc(n * sizeof(float));
+c = malloc(n * sizeof(float)); d = malloc(n * sizeof(float));
+e = malloc(n * sizeof(float));
+
+/* Some initializations */
+for (i=0; i<n; i++) {
+  a[i] = i * 1.5;
+  b[i] = i + 22.35;
+  c[i] = d[i] = e[i] = 0.0;
+  }
+
+maxt = omp_get_max_threads();
+printf("n = %ld, grain = %ld, best of %d runs (seconds)\n", n, grain, reps);
+printf("%8s %10s %10s %10s\n", "threads", "sections", "taskloop", "depend");
+for (nt = 1; nt <= maxt; nt = (nt * 2 <= maxt || nt == maxt) ? nt * 2 : maxt) {
+  omp_set_num_threads(nt);
+  best[0] = best[1] = best[2] = 1e30;
+  for (r = 0; r < reps; r++) {
+    t = omp_get_wtime(); run_sections(n);
+    t = omp_get_wtime() - t; if (t < best[0]) best[0] = t;
+    t = omp_get_wtime(); run_taskloop(n, grain);
+    t = omp_get_wtime() - t; if (t < best[1]) best[1] = t;
+    t = omp_get_wtime(); run_depend(n, grain);
+    t = omp_get_wtime() - t; if (t < best[2]) best[2] = t;
+    }
+  printf("%8d %10.6f %10.6f %10.6f\n", nt, best[0], best[1], best[2]);
+
+  /* check each version on its own, not the results of the last one */
+  clear(n); run_sections(n);        x[0] = check(n);
+  clear(n); run_taskloop(n, grain); x[1] = check(n);
+  clear(n); run_depend(n, grain);   x[2] = check(n);
+  for (r = 0; r < 3; r++)
+    if (x[r] > ref[r]) ref[r] = x[r];
+  }
+
+printf("largest error (should be 0): sections %g, taskloop %g, depend %g\n",
+       ref[0], ref[1], ref[2]);
+
+free(a); free(b); free(c); free(d); free(e);
+return ref[0] > 0.0 || ref[1] > 0.0 || ref[2] > 0.0;
+}
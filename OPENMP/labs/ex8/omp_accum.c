@@ -0,0 +1,206 @@
+/******************************************************************************
+* OpenMP Example - Running total without a critical section - C/C++ Version
+* FILE: omp_accum.c
+* DESCRIPTION:
+*   omp_critical.c keeps the running total of the matrix-vector product
+*   with "total = total + c[i]" inside a critical section, so every row
+*   serializes all the threads on one lock.  This example computes the
+*   same total five ways and measures the updates per second as the
+*   number of threads grows:
+*     critical - the update of omp_critical.c;
+*     atomic   - "#pragma omp atomic" on the shared total;
+*     reduction- reduction(+:total) on the loop;
+*     partials - one partial sum per thread in a shared array, combined
+*                at the end (neighbouring sums share a cache line);
+*     padded   - as partials, but each sum in its own cache line.
+*   The partial sums are volatile so that every row updates memory, as
+*   the shared total does; otherwise the compiler keeps them in registers
+*   and the cache line sharing does not show.
+*   The matrix rows are short (COLS elements) so that the update of the
+*   total is a large part of the work of an iteration.
+*   Every total is checked against a serial sum; a mismatch is reported
+*   and the program exits with status 1.
+* USAGE:  omp_accum [rows] [repetitions]
+* BUILD:  gcc -O2 -fopenmp -o omp_accum omp_accum.c
+* SOURCE: based on omp_matvec.c by Blaise Barney
+******************************************************************************/
+
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#define ROWS      (1 << 20)
+#define COLS      4
+#define CACHELINE 64
+#define MAXTHR    1024
+#define TOL       1e-9         /* relative difference allowed in a total */
+
+typedef struct {
+  double value;
+  char   pad[CACHELINE - sizeof(double)];
+} padded_sum;
+
+static float (*A)[COLS], *b;
+
+static inline float row(long i)
+{
+  float s = 0.0;
+  int j;
+  for (j=0; j < COLS; j++)
+    s += A[i][j] * b[i];
+  return s;
+}
+
+static double sum_serial(long n)
+{
+  double total = 0.0;
+  long i;
+  for (i=0; i < n; i++)
+    total += row(i);
+  return total;
+}
+
+static double sum_critical(long n)
+{
+  double total = 0.0;
+  long i;
+  #pragma omp parallel for
+  for (i=0; i < n; i++) {
+    float ci = row(i);
+    #pragma omp critical
+    total = total + ci;
+  }
+  return total;
+}
+
+static double sum_atomic(long n)
+{
+  double total = 0.0;
+  long i;
+  #pragma omp parallel for
+  for (i=0; i < n; i++) {
+    float ci = row(i);
+    #pragma omp atomic
+    total += ci;
+  }
+  return total;
+}
+
+static double sum_reduction(long n)
+{
+  double total = 0.0;
+  long i;
+  #pragma omp parallel for reduction(+:total)
+  for (i=0; i < n; i++)
+    total += row(i);
+  return total;
+}
+
+static double sum_partials(long n)
+{
+  static volatile double partial[MAXTHR];
+  double total = 0.0;
+  int t, nt = 1;
+  #pragma omp parallel
+  {
+  int tid = omp_get_thread_num();
+  long i;
+  #pragma omp single
+  nt = omp_get_num_threads();
+  partial[tid] = 0.0;
+  #pragma omp for
+  for (i=0; i < n; i++)
+    partial[tid] += row(i);
+  }
+  for (t=0; t < nt; t++)
+    total += partial[t];
+  return total;
+}
+
+static double sum_padded(long n)
+{
+  static volatile padded_sum partial[MAXTHR] __attribute__((aligned(CACHELINE)));
+  double total = 0.0;
+  int t, nt = 1;
+  #pragma omp parallel
+  {
+  int tid = omp_get_thread_num();
+  long i;
+  #pragma omp single
+  nt = omp_get_num_threads();
+  partial[tid].value = 0.0;
+  #pragma omp for
+  for (i=0; i < n; i++)
+    partial[tid].value += row(i);
+  }
+  for (t=0; t < nt; t++)
+    total += partial[t].value;
+  return total;
+}
+
+int main (int argc, char *argv[])
+{
+long i, n = ROWS;
+int j, k, r, reps = 3, nt, maxt, errors = 0;
+double t, best, ref, total[5];
+struct { const char *name; double (*fn)(long); } mode[] = {
+  { "critical", sum_critical }, { "atomic", sum_atomic },
+  { "reduction", sum_reduction }, { "partials", sum_partials },
+  { "padded", sum_padded } };
+
+if (argc >= 2) n = atol(argv[1]);
+if (argc >= 3) reps = atoi(argv[2]);
+if (n < 1 || reps < 1) {
+  printf("usage: omp_accum [rows] [repetitions], both at least 1\n");
+  return 1;
+  }
+
+A = malloc(n * sizeof(*A));
+b = malloc(n * sizeof(float));
+
+/* Initializations, as in omp_critical.c */
+for (i=0; i < n; i++)
+  {
+  for (j=0; j < COLS; j++)
+    A[i][j] = (j+1) * 1.0;
+  b[i] = 1.0 * (i % 100 + 1);
+  }
+ref = sum_serial(n);
+
+maxt = omp_get_max_threads();
+if (maxt > MAXTHR) maxt = MAXTHR;
+printf("%ld rows, million updates per second (best of %d runs)\n", n, reps);
+printf("%8s", "threads");
+for (k=0; k < 5; k++)
+  printf(" %10s", mode[k].name);
+printf("\n");
+
+for (nt = 1; nt <= maxt; nt = (nt * 2 <= maxt || nt == maxt) ? nt * 2 : maxt) {
+  omp_set_num_threads(nt);
+  printf("%8d", nt);
+  for (k=0; k < 5; k++) {
+    best = 1e30;
+    for (r=0; r < reps; r++) {
+      t = omp_get_wtime();
+      total[k] = mode[k].fn(n);
+      t = omp_get_wtime() - t;
+      if (t < best) best = t;
+      }
+    printf(" %10.1f", n / best * 1e-6);
+    }
+  printf("\n");
+  for (k=0; k < 5; k++)
+    if (fabs(total[k] - ref) > TOL * fabs(ref)) {
+      printf("  MISMATCH: %s with %d threads gave %.2f\n",
+             mode[k].name, nt, total[k]);
+      errors++;
+      }
+  }
+
+printf("\nMatrix-vector total - sum of all c[] = %.2f (serial)\n", ref);
+printf("%s\n\n", errors ? "Some modes gave a wrong total." :
+                           "All modes agree with the serial total.");
+free(A); free(b);
+return errors ? 1 : 0;
+}
@@ -0,0 +1,245 @@
+/******************************************************************************
+* FILE: barriers.c
+* DESCRIPTION:
+*   Centralized, combining-tree and dissemination barriers for OpenMP
+*   teams, see barriers.h.  The waiting threads spin on a flag in their
+*   own cache line and yield the cpu after SPINS tries, so that an
+*   oversubscribed team still makes progress.
+* BUILD:  gcc -O2 -fopenmp -c barriers.c
+******************************************************************************/
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include "barriers.h"
+
+#define SPINS       4096
+#define CALIBRATE   2000       /* barriers timed per kind by BARRIER_FASTEST */
+
+typedef struct {
+  atomic_int v;
+  char pad[BARRIER_CACHELINE - sizeof(atomic_int)];
+} __attribute__((aligned(BARRIER_CACHELINE))) line_t;
+
+typedef struct {
+  int sense;
+  int parity;
+  char pad[BARRIER_CACHELINE - 2 * sizeof(int)];
+} __attribute__((aligned(BARRIER_CACHELINE))) local_t;
+
+typedef struct {                /* central and tree */
+  line_t sense;                 /* flipped by the last arrival */
+  line_t count[];               /* central: 1 counter, tree: one per node */
+} counters_t;
+
+static const char *names[BARRIER_NKINDS] = {
+  "omp", "central", "tree", "dissemination" };
+
+static inline void cpu_relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#endif
+}
+
+static inline void spin_until(atomic_int *f, int v)
+{
+  int k = 0;
+  while (atomic_load_explicit(f, memory_order_acquire) != v) {
+    if (++k < SPINS)
+      cpu_relax();
+    else {
+      sched_yield();
+      k = 0;
+    }
+  }
+}
+
+static void *alloc_lines(size_t n)
+{
+  void *p = aligned_alloc(BARRIER_CACHELINE, n * BARRIER_CACHELINE);
+  if (p == NULL) {
+    fprintf(stderr, "barrier_init: out of memory\n");
+    exit(1);
+  }
+  memset(p, 0, n * BARRIER_CACHELINE);
+  return p;
+}
+
+/* expected arrivals at tree node i; nodes are numbered level by level */
+static int tree_children(int nthreads, int node, int *parent)
+{
+  int first = 0, width = (nthreads + BARRIER_ARITY - 1) / BARRIER_ARITY;
+  int below = nthreads;
+
+  while (node >= first + width) {
+    first += width;
+    below = width;
+    width = (width + BARRIER_ARITY - 1) / BARRIER_ARITY;
+  }
+  /* parent is on the next level, if there is one */
+  *parent = width > 1 ? first + width + (node - first) / BARRIER_ARITY : -1;
+  if ((node - first + 1) * BARRIER_ARITY <= below)
+    return BARRIER_ARITY;
+  return below - (node - first) * BARRIER_ARITY;
+}
+
+static void setup(barrier_t *b, int kind, int nthreads)
+{
+  counters_t *c;
+  int i, width, parent;
+
+  b->kind = kind;
+  b->nthreads = nthreads;
+  b->rounds = 0;
+  b->nnodes = 0;
+  b->shared = NULL;
+  b->local = alloc_lines(nthreads);
+
+  switch (kind) {
+  case BARRIER_CENTRAL:
+    c = b->shared = alloc_lines(2);
+    atomic_store(&c->count[0].v, nthreads);
+    break;
+  case BARRIER_TREE:
+    width = nthreads;
+    do {
+      width = (width + BARRIER_ARITY - 1) / BARRIER_ARITY;
+      b->nnodes += width;
+    } while (width > 1);
+    c = b->shared = alloc_lines(1 + b->nnodes);
+    for (i = 0; i < b->nnodes; i++)
+      atomic_store(&c->count[i].v, tree_children(nthreads, i, &parent));
+    break;
+  case BARRIER_DISSEMINATION:
+    while ((1 << b->rounds) < nthreads) b->rounds++;
+    /* flags[thread][parity][round] */
+    b->shared = alloc_lines((size_t)nthreads * 2 * (b->rounds ? b->rounds : 1));
+    break;
+  default:
+    b->kind = BARRIER_OMP;
+    break;
+  }
+}
+
+void barrier_destroy(barrier_t *b)
+{
+  free(b->shared);
+  free(b->local);
+  b->shared = b->local = NULL;
+}
+
+const char *barrier_name(int kind)
+{
+  return kind >= 0 && kind < BARRIER_NKINDS ? names[kind] : "fastest";
+}
+
+void barrier_init(barrier_t *b, int kind, int nthreads)
+{
+  const char *env = getenv("BARRIER_KIND");
+  double t, best = 1e30;
+  int k, i, best_kind = BARRIER_OMP;
+
+  /* the environment only chooses for BARRIER_FASTEST; explicit kinds win */
+  if (kind == BARRIER_FASTEST && env != NULL)
+    for (k = 0; k < BARRIER_NKINDS; k++)
+      if (strcmp(env, names[k]) == 0)
+        kind = k;
+
+  if (kind != BARRIER_FASTEST) {
+    setup(b, kind, nthreads);
+    return;
+  }
+
+  for (k = 0; k < BARRIER_NKINDS; k++) {
+    setup(b, k, nthreads);
+    #pragma omp parallel num_threads(nthreads) private(i)
+    for (i = 0; i < CALIBRATE; i++)
+      barrier_wait(b);
+    t = omp_get_wtime();
+    #pragma omp parallel num_threads(nthreads) private(i)
+    for (i = 0; i < CALIBRATE; i++)
+      barrier_wait(b);
+    t = omp_get_wtime() - t;
+    barrier_destroy(b);
+    if (t < best) {
+      best = t;
+      best_kind = k;
+    }
+  }
+  setup(b, best_kind, nthreads);
+}
+
+/* arrival at tree node; the last one to arrive goes up */
+static void tree_arrive(barrier_t *b, counters_t *c, int node, int sense)
+{
+  int parent;
+  while (atomic_fetch_sub_explicit(&c->count[node].v, 1,
+                                   memory_order_acq_rel) == 1) {
+    atomic_store_explicit(&c->count[node].v,
+                          tree_children(b->nthreads, node, &parent),
+                          memory_order_relaxed);
+    if (parent < 0) {
+      atomic_store_explicit(&c->sense.v, sense, memory_order_release);
+      return;
+    }
+    node = parent;
+  }
+}
+
+void barrier_wait(barrier_t *b)
+{
+  int tid, sense, r, n = b->nthreads;
+  local_t *me;
+  counters_t *c;
+  line_t *flags;
+
+  if (b->kind == BARRIER_OMP || n == 1) {
+    #pragma omp barrier
+    return;
+  }
+
+  tid = omp_get_thread_num();
+  me = (local_t *)b->local + tid;
+
+  switch (b->kind) {
+  case BARRIER_CENTRAL:
+    c = b->shared;
+    sense = me->sense = !me->sense;
+    if (atomic_fetch_sub_explicit(&c->count[0].v, 1,
+                                  memory_order_acq_rel) == 1) {
+      atomic_store_explicit(&c->count[0].v, n, memory_order_relaxed);
+      atomic_store_explicit(&c->sense.v, sense, memory_order_release);
+    } else
+      spin_until(&c->sense.v, sense);
+    break;
+
+  case BARRIER_TREE:
+    c = b->shared;
+    sense = me->sense = !me->sense;
+    tree_arrive(b, c, tid / BARRIER_ARITY, sense);
+    spin_until(&c->sense.v, sense);
+    break;
+
+  case BARRIER_DISSEMINATION:
+    /* flags are toggled to the current sense; the parity alternates the
+     * set of flags so that a fast thread cannot overwrite a flag that its
+     * partner has not yet seen */
+    flags = b->shared;
+    sense = !me->sense;
+    for (r = 0; r < b->rounds; r++) {
+      int partner = (tid + (1 << r)) % n;
+      atomic_store_explicit(
+        &flags[((size_t)partner * 2 + me->parity) * b->rounds + r].v,
+        sense, memory_order_release);
+      spin_until(&flags[((size_t)tid * 2 + me->parity) * b->rounds + r].v,
+                 sense);
+    }
+    if (me->parity == 1)
+      me->sense = sense;
+    me->parity = 1 - me->parity;
+    break;
+  }
+}
@@ -0,0 +1,54 @@
+/******************************************************************************
+* FILE: barriers.h
+* DESCRIPTION:
+*   Drop-in barriers for the OpenMP labs (implementation in barriers.c).
+*   A barrier_t is set up once, outside the parallel region, for a team of
+*   nthreads threads; inside the region every thread of the team calls
+*   barrier_wait() where it would use "#pragma omp barrier".
+*
+*     barrier_t bar;
+*     barrier_init(&bar, BARRIER_FASTEST, nthreads);
+*     #pragma omp parallel num_threads(nthreads)
+*       { ...; barrier_wait(&bar); ... }
+*     barrier_destroy(&bar);
+*
+*   Kinds:
+*     BARRIER_OMP           - "#pragma omp barrier" of the runtime;
+*     BARRIER_CENTRAL       - centralized sense-reversing counter;
+*     BARRIER_TREE          - combining tree of BARRIER_ARITY-way counters;
+*     BARRIER_DISSEMINATION - log2(nthreads) rounds of pairwise flags;
+*     BARRIER_FASTEST       - times the kinds above for nthreads threads
+*                             and keeps the fastest.
+*   The environment variable BARRIER_KIND (omp, central, tree,
+*   dissemination) replaces the timing of BARRIER_FASTEST; an explicit
+*   kind given to barrier_init() is always used as is.
+*   All flags and counters live in their own cache line.
+******************************************************************************/
+#ifndef BARRIERS_H
+#define BARRIERS_H
+
+#define BARRIER_OMP           0
+#define BARRIER_CENTRAL       1
+#define BARRIER_TREE          2
+#define BARRIER_DISSEMINATION 3
+#define BARRIER_NKINDS        4
+#define BARRIER_FASTEST       (-1)
+
+#define BARRIER_ARITY         4
+#define BARRIER_CACHELINE     64
+
+typedef struct barrier_s {
+  int    kind;
+  int    nthreads;
+  int    rounds;              /* dissemination rounds */
+  int    nnodes;              /* tree nodes */
+  void  *shared;              /* counters and flags of the kind */
+  void  *local;               /* per-thread sense and parity */
+} barrier_t;
+
+extern void        barrier_init(barrier_t *b, int kind, int nthreads);
+extern void        barrier_wait(barrier_t *b);
+extern void        barrier_destroy(barrier_t *b);
+extern const char *barrier_name(int kind);
+
+#endif /* BARRIERS_H */
@@ -0,0 +1,96 @@
+/******************************************************************************
+* FILE: omp_barrier_bench.c
+* OTHER FILES: barriers.c barriers.h
+* DESCRIPTION:
+*   OpenMP Example - Barrier cost - C Version
+*   omp_barrier.c puts three barriers around very little work; when the
+*   phases are that short the barrier latency is the run time.  This
+*   benchmark measures, for 1, 2, 4, ... threads up to
+*   omp_get_max_threads(), the time of one barrier episode of the runtime
+*   ("#pragma omp barrier") and of the centralized, combining-tree and
+*   dissemination barriers of barriers.c, and the kind BARRIER_FASTEST
+*   would pick (not given for 1 thread, where no barrier waits).  Every episode is also checked: after a barrier, all the
+*   threads must see the phase counters of the others up to date.
+* USAGE:  omp_barrier_bench [episodes]
+* BUILD:  gcc -O2 -fopenmp -o omp_barrier_bench omp_barrier_bench.c barriers.c
+******************************************************************************/
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "barriers.h"
+
+#define EPISODES 20000
+#define MAXTHR   1024
+
+static volatile int phase[MAXTHR * 16];  /* one per cache line */
+
+/* time one barrier kind; returns nanoseconds per episode, -1 on error */
+static double run(int kind, int nthreads, int episodes)
+{
+  barrier_t bar;
+  double t;
+  int errors = 0;
+
+  barrier_init(&bar, kind, nthreads);
+  t = omp_get_wtime();
+  #pragma omp parallel num_threads(nthreads) reduction(+:errors)
+  {
+  int tid = omp_get_thread_num(), e, j;
+  for (e = 1; e <= episodes; e++) {
+    phase[tid * 16] = e;
+    barrier_wait(&bar);
+    /* check a neighbour instead of all, to keep the work small */
+    j = (tid + 1) % nthreads;
+    if (phase[j * 16] < e) errors++;
+    barrier_wait(&bar);
+  }
+  }
+  t = omp_get_wtime() - t;
+  barrier_destroy(&bar);
+  return errors ? -1.0 : t * 1e9 / (2.0 * episodes);
+}
+
+int main (int argc, char *argv[])
+{
+int episodes = EPISODES, nt, maxt, k;
+barrier_t bar;
+double ns;
+
+if (argc >= 2) episodes = atoi(argv[1]);
+if (episodes < 1) {
+  printf("Usage: %s [episodes >= 1]. Quitting.\n", argv[0]);
+  exit(1);
+  }
+maxt = omp_get_max_threads();
+if (maxt > MAXTHR) maxt = MAXTHR;
+
+printf("ns per barrier, %d episodes\n", episodes);
+printf("%8s", "threads");
+for (k = 0; k < BARRIER_NKINDS; k++)
+  printf(" %14s", barrier_name(k));
+printf(" %14s\n", "fastest");
+
+for (nt = 1; nt <= maxt; nt = (nt * 2 <= maxt || nt == maxt) ? nt * 2 : maxt) {
+  printf("%8d", nt);
+  for (k = 0; k < BARRIER_NKINDS; k++) {
+    ns = run(k, nt, episodes);
+    if (ns < 0)
+      printf(" %14s", "FAILED");
+    else
+      printf(" %14.1f", ns);
+    fflush(stdout);
+    }
+  /* a single thread never waits, any pick would be noise */
+  if (nt < 2) {
+    printf(" %14s\n", "-");
+    continue;
+    }
+  barrier_init(&bar, BARRIER_FASTEST, nt);
+  printf(" %14s\n", barrier_name(bar.kind));
+  barrier_destroy(&bar);
+  }
+if (maxt < 2)
+  printf("\nwith 1 thread no barrier waits, the times only measure the call"
+         " overhead\n");
+return 0;
+}